@@ -0,0 +1,129 @@
+#pragma once
+
+#include "microcv2_core.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Namespace for the headless batch pipeline.
+ *
+ * A dataset can be split across any number of processes or machines that share a filesystem. Each
+ * process is given a shard index and shard count, deterministically picks its files by a stable hash of
+ * the file name, and writes its results to its own shard file. The merge step then combines every shard
+ * file into one result set ordered by file name. It appends the frames the columnar results store does
+ * not have yet to the store.
+ *
+ * Usage:
+ *   ESPViewer --batch --shard I --shards N --out DIR [--hex-dir DIR] [--bin-dir DIR]
+ *             [--stop-morph OP] [--white-morph OP] [--morph-shape cross|square] [--coarse N]
+ *   ESPViewer --merge --shards N --out DIR [--store FILE]
+ */
+namespace Batch {
+
+    /**
+     * @brief The detection output of a single frame
+     *
+     */
+    struct FrameResult {
+        std::string file;
+        bool stop = false;          ///< processRedImg result
+        bool white = false;         ///< processWhiteImg result
+        int8_t dist = 0;            ///< Distance reported by processWhiteImg, 0 if no line was found
+        uint16_t redPercent = 0;    ///< Percentage of the stop box that was red, times 100
+        float blobArea = 0;         ///< Area of the largest white blob, 0 if there was none
+        uint64_t loadNs = 0;        ///< Time spent loading the frame
+        uint64_t processNs = 0;     ///< Time spent in the detectors
+    };
+
+    /**
+     * @brief Summary line written at the top of every shard file
+     *
+     */
+    struct ShardSummary {
+        uint32_t shard = 0;
+        uint32_t shards = 1;
+        uint64_t frames = 0;
+        uint64_t wallNs = 0;        ///< Wall clock time of the whole shard
+    };
+
+    /**
+     * @brief Options for the batch and merge modes
+     *
+     */
+    struct Options {
+        uint32_t shard = 0;
+        uint32_t shards = 1;
+        std::string outDir = "batch_results";
+        std::string hexDir = "../hex_images/";
+        std::string binDir = "../binary_images/";
+        std::string store;          ///< Results store the merge appends to. Defaults to results.cols in outDir.
+        MicroCV2::Core::Config config = MicroCV2::Core::DEFAULT_CONFIG;    ///< Thresholds and mask morphology of the shard
+    };
+
+    /**
+     * @brief 64-bit FNV-1a hash. Stable across platforms, compilers, and runs.
+     *
+     * @param data - The bytes to hash
+     * @return uint64_t - The hash
+     */
+    constexpr uint64_t stableHash(std::string_view data)
+    {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (char c : data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Check whether a file belongs to a shard. Only the file name is hashed, so the partition does
+     * not depend on where the dataset is mounted.
+     *
+     * @param filename - The filepath
+     * @param shard - The shard index
+     * @param shards - The total number of shards
+     * @return true - If the file is processed by this shard
+     */
+    bool inShard(const std::string& filename, const uint32_t shard, const uint32_t shards);
+
+    /**
+     * @brief Get the path of the result file written by a shard
+     *
+     * @param outDir - The output directory
+     * @param shard - The shard index
+     * @param shards - The total number of shards
+     * @return std::string - The filepath
+     */
+    std::string shardResultPath(const std::string& outDir, const uint32_t shard, const uint32_t shards);
+
+    /**
+     * @brief Process every file of one shard and write its result file
+     *
+     * @param options - The batch options
+     * @return int - Process exit code
+     */
+    int runShard(const Options& options);
+
+    /**
+     * @brief Merge every shard result file into a single ordered results.csv, append it to the results
+     * store, and print aggregate throughput
+     *
+     * @param options - The batch options
+     * @return int - Process exit code
+     */
+    int mergeShards(const Options& options);
+
+    /**
+     * @brief Parse the command line and run the batch or merge mode
+     *
+     * @param argc - Taken from main function arguments
+     * @param argv - Taken from main function arguments
+     * @return int - Process exit code
+     */
+    int run(int argc, char* argv[]);
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <charconv>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Namespace for reading the numeric command line options of the tools.
+ *
+ * Every value must be entirely a number that fits the option's type, otherwise an error naming the option
+ * is printed and false is returned, so a typo ends the tool with its usage instead of an uncaught exception.
+ */
+namespace Cli {
+
+    /**
+     * @brief Parse the value of a numeric option
+     *
+     * @param name - The option, for the error message
+     * @param text - The value
+     * @param value - Output number. Left unchanged on failure.
+     * @return true - If the whole value is a number that fits the type
+     */
+    template <typename T>
+    bool parseValue(const std::string& name, const std::string_view text, T& value)
+    {
+        T parsed{};
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, parsed);
+        if (ec != std::errc() || ptr != end) {
+            std::cerr << "Error: " << name << (ec == std::errc::result_out_of_range ? " is out of range" : " must be a number")
+                      << ", not " << text << std::endl;
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+    /**
+     * @brief Parse the value of a numeric option that must lie in an inclusive range
+     *
+     */
+    template <typename T>
+    bool parseValue(const std::string& name, const std::string_view text, T& value, const T minValue, const T maxValue)
+    {
+        T parsed{};
+        if (!parseValue(name, text, parsed)) return false;
+        if (parsed < minValue || parsed > maxValue) {
+            std::cerr << "Error: " << name << " must be between " << +minValue << " and " << +maxValue << ", not " << text << std::endl;
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+    /**
+     * @brief Read a numeric option, keeping the default if it is not given
+     *
+     * @param options - The options by name
+     * @param name - The option
+     * @param value - Default in, number out
+     * @return true - If the option is missing or a valid number
+     */
+    template <typename T>
+    bool parseOption(const std::map<std::string, std::string>& options, const std::string& name, T& value)
+    {
+        auto it = options.find(name);
+        return it == options.end() || parseValue(name, it->second, value);
+    }
+
+    /**
+     * @brief Read a numeric option that must lie in an inclusive range, keeping the default if it is not given
+     *
+     */
+    template <typename T>
+    bool parseOption(const std::map<std::string, std::string>& options, const std::string& name, T& value,
+                     const T minValue, const T maxValue)
+    {
+        auto it = options.find(name);
+        return it == options.end() || parseValue(name, it->second, value, minValue, maxValue);
+    }
+
+}
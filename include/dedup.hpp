@@ -0,0 +1,107 @@
+#pragma once
+
+#include "opencv2.hpp"
+
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Namespace for detecting duplicate and near-duplicate frames so their results can be reused.
+ *
+ * Every frame gets two signatures. The exact one is a hash of the pixels. Frames with the same hash are
+ * compared pixel by pixel before one counts as a copy of the other, so a hash collision never reuses the
+ * wrong results. The perceptual one is a 64-bit difference hash of a 9x8
+ * luma thumbnail, which barely changes between the frames of a static burst capture. How close two
+ * perceptual hashes have to be before a frame counts as a duplicate is set with ESPVIEWER_DEDUP:
+ *   off   - Process every frame
+ *   exact - Only skip frames with identical pixels (default)
+ *   N     - Also skip frames whose perceptual hash differs from an earlier frame in at most N bits
+ */
+namespace Dedup {
+
+    constexpr const char* ENV_VAR = "ESPVIEWER_DEDUP";
+
+    /**
+     * @brief The signatures of a single frame
+     *
+     */
+    struct Signature {
+        uint64_t exact = 0;         ///< FNV-1a hash of the pixels
+        uint64_t perceptual = 0;    ///< Difference hash of the downsampled luma
+    };
+
+    /**
+     * @brief How duplicates are matched
+     *
+     */
+    struct Options {
+        bool enabled = true;
+        int maxDistance = -1;       ///< Largest perceptual hash distance that is a duplicate. Negative for exact matches only.
+
+        /**
+         * @brief Read the options from ESPVIEWER_DEDUP
+         *
+         */
+        static Options fromEnvironment();
+    };
+
+    /**
+     * @brief Compute the signatures of a canonical RGB565 frame
+     *
+     * @param frame - The native-endian RGB565 pixels
+     * @param width - The frame width
+     * @param height - The frame height
+     * @return Signature - The signatures
+     */
+    Signature computeSignature(std::span<const uint16_t> frame, const int width, const int height);
+
+    /**
+     * @brief Compute the signatures of a canonical CV_16UC1 frame
+     *
+     */
+    Signature computeSignature(const cv::Mat& image);
+
+    /**
+     * @brief Check whether two canonical CV_16UC1 frames have the same size and pixels
+     *
+     */
+    bool samePixels(const cv::Mat& a, const cv::Mat& b);
+
+    /**
+     * @brief Remembers the signature of every unique frame and matches new frames against them
+     *
+     */
+    class Deduplicator {
+    public:
+        explicit Deduplicator(const Options& options = Options::fromEnvironment());
+
+        /**
+         * @brief Look for an earlier frame that a new frame duplicates, and remember the new frame if there is none
+         *
+         * @param signature - The signature of the new frame
+         * @param frame - The index of the new frame
+         * @param samePixels - Whether the new frame has the same pixels as the earlier frame with this index.
+         * Only called for earlier frames with the same exact hash.
+         * @return std::optional<size_t> - The index of the earlier frame, or nothing if the frame is unique
+         */
+        std::optional<size_t> findOrAdd(const Signature& signature, const size_t frame,
+                                        const std::function<bool(size_t)>& samePixels);
+
+        const Options& options() const { return m_options; }
+        uint64_t duplicates() const { return m_duplicates; }
+        uint64_t frames() const { return m_frames; }
+
+    private:
+        Options m_options;
+        std::unordered_map<uint64_t, size_t> m_exact;
+        std::vector<std::pair<uint64_t, size_t>> m_perceptual;
+        uint64_t m_duplicates = 0;
+        uint64_t m_frames = 0;
+    };
+
+}
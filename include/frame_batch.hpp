@@ -0,0 +1,254 @@
+#pragma once
+
+#include "microcv2_core.hpp"
+
+#include <array>
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+namespace MicroCV2::Core {
+
+    /**
+     * @brief N frames of the same size interleaved pixel-major, so the N values of one pixel are adjacent.
+     *
+     * The batch kernels below walk a region once and classify the same pixel of every frame together.
+     * The inner loop always runs over exactly N lanes, so it vectorizes to the full vector width no
+     * matter how narrow the region is. Unused lanes hold zeros, which some thresholds do match, so their
+     * counts and masks are meaningless. The process functions only report results for the lanes in use.
+     *
+     * @tparam N - Number of frames in the batch. A multiple of 16 fills an AVX-512 register of 16-bit lanes.
+     */
+    template <size_t N>
+    class FrameBatch {
+    public:
+        static constexpr size_t LANES = N;
+
+        FrameBatch(const int width = IMG_COLS, const int height = IMG_ROWS)
+            : m_width(width), m_height(height), m_pixels(static_cast<size_t>(width) * height * N, 0) {}
+
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+
+        /**
+         * @brief Number of lanes holding a frame
+         *
+         */
+        size_t size() const { return m_size; }
+        bool full() const { return m_size == N; }
+
+        /**
+         * @brief Copy a canonical frame into the next free lane
+         *
+         * @param frame - Canonical RGB565 frame of the batch's size
+         * @return true - If the frame was added, false if the batch is full or the frame is the wrong size
+         */
+        bool push(std::span<const uint16_t> frame)
+        {
+            if (full() || frame.size() != static_cast<size_t>(m_width) * m_height) return false;
+
+            uint16_t* dst = m_pixels.data() + m_size;
+            for (size_t i = 0; i < frame.size(); ++i) {
+                dst[i * N] = frame[i];
+            }
+            m_size++;
+            return true;
+        }
+
+        /**
+         * @brief Empty the batch. Stale lanes are zeroed.
+         *
+         */
+        void clear()
+        {
+            std::fill(m_pixels.begin(), m_pixels.end(), 0);
+            m_size = 0;
+        }
+
+        /**
+         * @brief The N lane values of a single pixel
+         *
+         */
+        const uint16_t* pixel(const int x, const int y) const
+        {
+            return m_pixels.data() + (static_cast<size_t>(y) * m_width + x) * N;
+        }
+
+    private:
+        int m_width;
+        int m_height;
+        size_t m_size = 0;
+        std::vector<uint16_t> m_pixels;
+    };
+
+    /**
+     * @brief Count the matching pixels of every frame inside an inclusive box in one sweep
+     *
+     * @param batch - The frames
+     * @param tl - Top left corner of the box
+     * @param br - Bottom right corner of the box
+     * @param predicate - Pixel classifier taking the RGB565 value
+     * @return std::array<uint16_t, N> - The count of every lane
+     */
+    template <size_t N, typename Predicate>
+    std::array<uint16_t, N> countBox(const FrameBatch<N>& batch, const Point tl, const Point br, Predicate&& predicate)
+    {
+        const int x0 = std::max(tl.x, 0), x1 = std::min(br.x, batch.width() - 1);
+        const int y0 = std::max(tl.y, 0), y1 = std::min(br.y, batch.height() - 1);
+
+        std::array<uint16_t, N> counts{};
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                const uint16_t* lanes = batch.pixel(x, y);
+                for (size_t lane = 0; lane < N; ++lane) {
+                    counts[lane] += predicate(lanes[lane]) ? 1 : 0;
+                }
+            }
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Batch version of processRed. Only counts, no masks are written. With STOP_MORPHOLOGY set, the
+     * stop box of each frame is classified into a scratch mask and cleaned on its own, like processRed does.
+     *
+     * @param batch - The frames
+     * @param cfg - Thresholds to use
+     * @return std::array<BoxResult, N> - The stop result of every lane. Unused lanes are left at the default.
+     */
+    template <size_t N>
+    std::array<BoxResult, N> processRed(const FrameBatch<N>& batch, const Config& cfg = DEFAULT_CONFIG)
+    {
+        const Point tl = {cfg.STOPBOX_TL_X, cfg.STOPBOX_TL_Y}, br = {cfg.STOPBOX_BR_X, cfg.STOPBOX_BR_Y};
+        auto isStop = [&](uint16_t pixel) { return isStopPixel(pixel, cfg); };
+
+        std::array<uint16_t, N> counts{};
+        if (cfg.STOP_MORPHOLOGY == 0) {
+            counts = countBox(batch, tl, br, isStop);
+        } else {
+            const int width = batch.width(), height = batch.height();
+            const int x0 = std::max(tl.x, 0), x1 = std::min(br.x, width - 1);
+            const int y0 = std::max(tl.y, 0), y1 = std::min(br.y, height - 1);
+
+            std::vector<uint8_t> mask(static_cast<size_t>(width) * height);
+            for (size_t lane = 0; lane < batch.size(); ++lane) {
+                std::fill(mask.begin(), mask.end(), 0);
+                for (int y = y0; y <= y1; ++y) {
+                    for (int x = x0; x <= x1; ++x) {
+                        mask[y * width + x] = isStop(batch.pixel(x, y)[lane]) ? 255 : 0;
+                    }
+                }
+                counts[lane] = cleanStopMask(mask, width, height, cfg);
+            }
+        }
+
+        std::array<BoxResult, N> results;
+        for (size_t lane = 0; lane < batch.size(); ++lane) {
+            results[lane] = boxResult(counts[lane], cfg.stopBoxArea(), cfg.PERCENT_TO_STOP);
+        }
+        return results;
+    }
+
+    /**
+     * @brief Batch version of processCar. Only counts, no masks are written.
+     *
+     * @param batch - The frames
+     * @param cfg - Thresholds to use
+     * @return std::array<BoxResult, N> - The car result of every lane. Unused lanes are left at the default.
+     */
+    template <size_t N>
+    std::array<BoxResult, N> processCar(const FrameBatch<N>& batch, const Config& cfg = DEFAULT_CONFIG)
+    {
+        auto counts = countBox(batch, {cfg.CARBOX_TL_X, cfg.CARBOX_TL_Y}, {cfg.CARBOX_BR_X, cfg.CARBOX_BR_Y},
+                               [&](uint16_t pixel) { return isCarPixel(pixel, cfg); });
+
+        std::array<BoxResult, N> results;
+        for (size_t lane = 0; lane < batch.size(); ++lane) {
+            results[lane] = boxResult(counts[lane], cfg.carBoxArea(), cfg.PERCENT_TO_CAR);
+        }
+        return results;
+    }
+
+    /**
+     * @brief Count the white pixels in the crop of every frame in one sweep
+     *
+     * @param batch - The frames
+     * @param cfg - Thresholds to use
+     * @return std::array<uint16_t, N> - The white pixel count of every lane
+     */
+    template <size_t N>
+    std::array<uint16_t, N> countWhite(const FrameBatch<N>& batch, const Config& cfg = DEFAULT_CONFIG)
+    {
+        return countBox(batch, {0, cfg.WHITE_VERTICAL_CROP}, {cfg.WHITE_HORIZONTAL_CROP - 1, batch.height() - 1},
+                        [&](uint16_t pixel) { return isWhitePixel(pixel, cfg); });
+    }
+
+    /**
+     * @brief Classify the white line crop of every frame in one sweep
+     *
+     * @param batch - The frames
+     * @param masks - N masks the size of a frame, one after another. Everything outside the crop is cleared.
+     * @param cfg - Thresholds to use
+     * @return std::array<uint16_t, N> - The white pixel count of every lane
+     */
+    template <size_t N>
+    std::array<uint16_t, N> classifyWhite(const FrameBatch<N>& batch, std::span<uint8_t> masks, const Config& cfg = DEFAULT_CONFIG)
+    {
+        const int width = batch.width(), height = batch.height();
+        const size_t frameSize = static_cast<size_t>(width) * height;
+        std::fill(masks.begin(), masks.end(), 0);
+
+        const int x1 = std::min<int>(cfg.WHITE_HORIZONTAL_CROP, width) - 1;
+        std::array<uint16_t, N> counts{};
+        for (int y = cfg.WHITE_VERTICAL_CROP; y < height; ++y) {
+            for (int x = 0; x <= x1; ++x) {
+                const uint16_t* lanes = batch.pixel(x, y);
+                uint8_t* maskPixel = masks.data() + y * width + x;
+
+                for (size_t lane = 0; lane < N; ++lane) {
+                    const uint8_t hit = isWhitePixel(lanes[lane], cfg) ? 1 : 0;
+                    maskPixel[lane * frameSize] = static_cast<uint8_t>(-hit);
+                    counts[lane] += hit;
+                }
+            }
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Batch version of processWhite. Classification runs across the whole batch, then blob analysis
+     * and the line fit run per frame, skipping frames without a single white pixel.
+     *
+     * @param batch - The frames
+     * @param masks - N masks the size of a frame, one after another
+     * @param ws - Scratch buffers for blob analysis
+     * @param cfg - Thresholds to use
+     * @return std::array<WhiteResult, N> - The white line result of every lane. Unused lanes are left at the default.
+     */
+    template <size_t N>
+    std::array<WhiteResult, N> processWhite(const FrameBatch<N>& batch, std::span<uint8_t> masks, Workspace& ws,
+                                            const Config& cfg = DEFAULT_CONFIG)
+    {
+        const int width = batch.width(), height = batch.height();
+        const size_t frameSize = static_cast<size_t>(width) * height;
+
+        auto counts = classifyWhite(batch, masks, cfg);
+
+        std::array<WhiteResult, N> results;
+        for (size_t lane = 0; lane < batch.size(); ++lane) {
+            if (counts[lane] == 0) continue;
+
+            std::span<uint8_t> mask = masks.subspan(lane * frameSize, frameSize);
+            if (cfg.WHITE_MORPHOLOGY != 0 && cleanWhiteMask(mask, width, height, cfg) == 0) continue;
+
+            WhiteResult& result = results[lane];
+            result.blob = findLargestBlob(mask, width, height, ws);
+            if (!result.blob.found || result.blob.area2 < 2 * cfg.WHITE_MIN_SIZE) continue;
+
+            result.line = fitLine(result.blob, width, cfg);
+            result.detected = true;
+        }
+        return results;
+    }
+
+}
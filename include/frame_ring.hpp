@@ -0,0 +1,262 @@
+#pragma once
+
+#include "params.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Namespace for the shared memory ring that hands frames from one process to others without copies.
+ *
+ * One producer, such as IngestServer, writes each frame once into the next slot of a ring in named shared
+ * memory (POSIX shm_open, or a named file mapping on Windows). Any number of consumers, such as RingDetect
+ * and the viewer, map the ring read-only and read frames in place. Every frame gets a sequence number.
+ *
+ * The producer never waits for consumers. A consumer that falls more than a ring's length behind loses
+ * the oldest frames, which it sees as a gap in the sequence numbers and counts as drops, so a slow viewer
+ * can never stall detection. Each slot is guarded by a seqlock: a consumer that reads a slot while the
+ * producer is overwriting it finds out from valid() and discards what it read.
+ *
+ * The ring layout uses the byte order and alignment of the machine, so producer and consumers must be
+ * builds of this project for the same platform. Restart the consumers if the producer is restarted.
+ */
+namespace FrameRing {
+
+    constexpr char RING_MAGIC[8] = {'E', 'S', 'P', 'R', 'I', 'N', 'G', '1'};
+    constexpr uint32_t DEFAULT_SLOTS = 64;
+    constexpr size_t PIXELS = IMG_ROWS * IMG_COLS;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring needs address-free 64 bit atomics");
+
+    /**
+     * @brief The detection results stored alongside a frame, if the producer has them
+     *
+     */
+    struct Detection {
+        uint8_t stop = 0;
+        uint8_t white = 0;
+        int8_t dist = 0;            ///< 0 if no line was found
+        uint8_t reserved = 0;
+        uint16_t redPercent = 0;    ///< Percentage of the stop box that was red, times 100
+        uint16_t reserved2 = 0;
+        float blobArea = 0;         ///< Area of the largest white blob, 0 if there was none
+    };
+
+    /**
+     * @brief One frame and its metadata. Slots are cache line aligned so neighbours never share a line.
+     *
+     */
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> version;  ///< 2 * seq + 1 while the producer writes the slot, 2 * seq + 2 once published
+
+        uint64_t seq;               ///< Sequence number of the frame across the whole ring
+        uint64_t source;            ///< Producer defined id of the stream the frame came from
+        uint64_t frame;             ///< Index of the frame within its source
+        int64_t publishNs;          ///< Steady clock time of publishing, shared by processes on the same machine
+        uint32_t hasDetection;      ///< 1 if detection holds the frame's results
+        Detection detection;
+
+        alignas(64) uint16_t pixels[PIXELS];    ///< Canonical native-endian RGB565 frame
+    };
+
+    /**
+     * @brief The start of the shared memory, followed by the slots
+     *
+     */
+    struct Header {
+        char magic[8];
+        uint32_t slotCount;
+        uint32_t slotSize;          ///< sizeof(Slot) of the producer, checked by consumers
+        alignas(64) std::atomic<uint64_t> head;     ///< Sequence number of the next frame to publish
+    };
+
+    /**
+     * @brief Current steady clock time in nanoseconds, the clock of Slot::publishNs
+     *
+     */
+    inline int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief A named shared memory mapping
+     *
+     */
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+        ~SharedMemory();
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        /**
+         * @brief Create the named memory, replacing any earlier memory of the same name, and map it for writing.
+         * On POSIX systems only the creating user may open it.
+         *
+         * @param name - The name, without the leading slash POSIX needs
+         * @param size - The size in bytes
+         * @return true - If the memory was created and mapped
+         */
+        bool create(const std::string& name, size_t size);
+
+        /**
+         * @brief Map existing named memory read-only
+         *
+         * @param name - The name, without the leading slash POSIX needs
+         * @return true - If the memory was found and mapped
+         */
+        bool open(const std::string& name);
+
+        /**
+         * @brief Unmap the memory, and remove the name if this mapping created it
+         *
+         */
+        void close();
+
+        uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        std::string m_createdName;      ///< Name to unlink on close, empty for read-only mappings
+        void* m_mapping = nullptr;      ///< File mapping handle on Windows, unused elsewhere
+    };
+
+    /**
+     * @brief Writes frames into a ring. Only one producer may write to a ring at a time.
+     *
+     */
+    class Producer {
+    public:
+        /**
+         * @brief Create the ring
+         *
+         * @param name - The ring name
+         * @param slotCount - Number of frames a consumer may fall behind before it drops frames
+         * @return true - If the ring was created
+         */
+        bool create(const std::string& name, uint32_t slotCount = DEFAULT_SLOTS);
+
+        /**
+         * @brief Start writing the next frame. Fill in the slot's pixels and metadata, then call publish.
+         *
+         * @return Slot& - The slot, with seq set and no detection
+         */
+        Slot& claim();
+
+        /**
+         * @brief Make the claimed slot visible to consumers
+         *
+         */
+        void publish();
+
+        /**
+         * @brief Copy a frame into the ring and publish it
+         *
+         * @param pixels - The canonical RGB565 frame
+         * @param source - Id of the stream the frame came from
+         * @param frame - Index of the frame within its source
+         * @param detection - The frame's detection results, if known
+         * @return uint64_t - The frame's sequence number
+         */
+        uint64_t publish(std::span<const uint16_t> pixels, uint64_t source, uint64_t frame,
+                         const Detection* detection = nullptr);
+
+        /**
+         * @brief Number of frames published
+         *
+         */
+        uint64_t published() const { return m_next; }
+
+    private:
+        SharedMemory m_memory;
+        Header* m_header = nullptr;
+        Slot* m_slots = nullptr;
+        uint32_t m_slotCount = 0;
+        uint64_t m_next = 0;
+        Slot* m_claimed = nullptr;
+    };
+
+    /**
+     * @brief A frame a consumer is reading in place. Check Consumer::valid once done with it.
+     *
+     */
+    struct FrameView {
+        uint64_t seq = 0;
+        const Slot* slot = nullptr;
+
+        std::span<const uint16_t> pixels() const { return {slot->pixels, PIXELS}; }
+    };
+
+    /**
+     * @brief Reads frames from a ring. Every consumer keeps its own position, and any number may read at once.
+     *
+     */
+    class Consumer {
+    public:
+        /**
+         * @brief Map the ring and start at the next frame the producer publishes
+         *
+         * @param name - The ring name
+         * @return true - If the ring exists and was created by a compatible build
+         */
+        bool open(const std::string& name);
+
+        /**
+         * @brief Get the next frame in sequence, skipping frames that were overwritten before they were read
+         *
+         * @return std::optional<FrameView> - The frame, or nothing if the consumer has caught up
+         */
+        std::optional<FrameView> next();
+
+        /**
+         * @brief Get the newest frame, skipping every frame before it
+         *
+         * @return std::optional<FrameView> - The frame, or nothing if no frame newer than the last one read was published
+         */
+        std::optional<FrameView> latest();
+
+        /**
+         * @brief Check that a frame was not overwritten while it was being read. Call after reading it.
+         *
+         * @return true - If everything read from the frame is consistent. Otherwise it counts as a drop.
+         */
+        bool valid(const FrameView& view);
+
+        /**
+         * @brief Wait until a frame newer than the last one read is published
+         *
+         * @param timeout - How long to wait at most
+         * @return true - If there is a frame to read
+         */
+        bool wait(std::chrono::microseconds timeout) const;
+
+        /**
+         * @brief Number of frames this consumer missed because the producer overwrote them first
+         *
+         */
+        uint64_t dropped() const { return m_dropped; }
+
+        /**
+         * @brief Number of frames the producer has published
+         *
+         */
+        uint64_t published() const { return m_header->head.load(std::memory_order_acquire); }
+
+    private:
+        SharedMemory m_memory;
+        const Header* m_header = nullptr;
+        const Slot* m_slots = nullptr;
+        uint32_t m_slotCount = 0;
+        uint64_t m_next = 0;            ///< Sequence number of the next frame to read
+        uint64_t m_dropped = 0;
+    };
+
+}
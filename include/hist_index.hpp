@@ -0,0 +1,203 @@
+#pragma once
+
+#include "microcv2.hpp"
+#include "opencv2.hpp"
+#include "params.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Namespace for the per-frame RGB565 histogram index.
+ *
+ * The colour classifiers only depend on the value of each pixel and whether it is inside a region of
+ * interest, so a histogram of the pixel values inside each region is enough to answer "what would this
+ * threshold have done" for every frame without touching the pixels again. A query builds a 64K entry
+ * lookup table from the threshold predicate once and then sums the matching histogram bins of every frame.
+ */
+namespace HistIndex {
+
+    /**
+     * @brief The regions of interest that are indexed for every frame
+     *
+     */
+    enum Roi : uint8_t {
+        ROI_STOP,       ///< The stop detection box used by processRedImg
+        ROI_CAR,        ///< The car detection box used by processCarImg
+        ROI_WHITE,      ///< The cropped region classified by processWhiteImg
+        ROI_COUNT
+    };
+
+    /**
+     * @brief Inclusive pixel bounds of a region of interest
+     *
+     */
+    struct RoiRect {
+        uint8_t tlX, tlY, brX, brY;
+
+        constexpr uint16_t area() const { return Params::BOX_AREA(tlX, tlY, brX, brY); }
+        constexpr bool operator==(const RoiRect&) const = default;
+    };
+
+    constexpr std::array<RoiRect, ROI_COUNT> ROI_RECTS = {{
+        {Params::STOPBOX_TL_X, Params::STOPBOX_TL_Y, Params::STOPBOX_BR_X, Params::STOPBOX_BR_Y},
+        {Params::CARBOX_TL_X, Params::CARBOX_TL_Y, Params::CARBOX_BR_X, Params::CARBOX_BR_Y},
+        {0, Params::WHITE_VERTICAL_CROP, Params::WHITE_HORIZONTAL_CROP - 1, IMG_ROWS - 1},
+    }};
+
+    /**
+     * @brief A single non-empty histogram bin
+     *
+     */
+    struct Bin {
+        uint16_t value;     ///< The RGB565 pixel value
+        uint16_t count;     ///< The number of pixels in the region with this value
+    };
+
+    /**
+     * @brief Sparse histograms of one frame, sorted by pixel value
+     *
+     */
+    struct FrameHistogram {
+        std::string source;
+        std::array<std::vector<Bin>, ROI_COUNT> rois;
+    };
+
+    /**
+     * @brief A lookup table with one entry per RGB565 value. Non-zero entries match the predicate.
+     *
+     */
+    using PixelLut = std::vector<uint8_t>;
+
+    /**
+     * @brief Colour thresholds used by the stop line query. Defaults to the current Params.
+     *
+     */
+    struct StopThresholds {
+        uint8_t greenTolerance = Params::STOP_GREEN_TOLERANCE;
+        uint8_t blueTolerance = Params::STOP_BLUE_TOLERANCE;
+        uint8_t percentToStop = Params::PERCENT_TO_STOP;
+        uint8_t whiteRed = Params::WHITE_RED_THRESH;
+        uint8_t whiteGreen = Params::WHITE_GREEN_THRESH;
+        uint8_t whiteBlue = Params::WHITE_BLUE_THRESH;
+    };
+
+    /**
+     * @brief Colour thresholds used by the car query. Defaults to the current Params.
+     *
+     */
+    struct CarThresholds {
+        uint8_t redTolerance = Params::CAR_RED_TOLERANCE;
+        uint8_t blueTolerance = Params::CAR_BLUE_TOLERANCE;
+        uint8_t percentToCar = Params::PERCENT_TO_CAR;
+    };
+
+    /**
+     * @brief Colour thresholds used by the white pixel query. Defaults to the current Params.
+     *
+     */
+    struct WhiteThresholds {
+        uint8_t red = Params::WHITE_RED_THRESH;
+        uint8_t green = Params::WHITE_GREEN_THRESH;
+        uint8_t blue = Params::WHITE_BLUE_THRESH;
+    };
+
+    /**
+     * @brief Build a lookup table by evaluating a predicate on the RGB888 value of every RGB565 pixel
+     *
+     * @param predicate - Callable taking (red, green, blue) as uint16_t and returning bool
+     * @return PixelLut - The lookup table
+     */
+    template <typename Predicate>
+    PixelLut makeLut(Predicate&& predicate)
+    {
+        PixelLut lut(0x10000);
+        for (uint32_t value = 0; value <= 0xFFFF; ++value) {
+            uint16_t red, green, blue;
+            MicroCV2::RGB565toRGB888(value, red, green, blue);
+            lut[value] = predicate(red, green, blue) ? 1 : 0;
+        }
+        return lut;
+    }
+
+    /**
+     * @brief Histograms of the indexed regions of every frame in a dataset
+     *
+     */
+    class Index {
+    public:
+        /**
+         * @brief Compute the histograms of a frame and append them to the index
+         *
+         * @param source - The file the frame was loaded from
+         * @param image - The canonical CV_16UC1 RGB565 frame
+         */
+        void add(const std::string& source, const cv::Mat& image);
+
+        /**
+         * @brief Get the number of indexed frames
+         *
+         */
+        size_t size() const { return m_frames.size(); }
+
+        /**
+         * @brief Get the histograms of an indexed frame
+         *
+         */
+        const FrameHistogram& frame(size_t i) const { return m_frames[i]; }
+
+        /**
+         * @brief Count the pixels matching a lookup table inside a region of every frame
+         *
+         * @param roi - The region to count in
+         * @param lut - The lookup table from makeLut
+         * @return std::vector<uint16_t> - The matching pixel count of each frame
+         */
+        std::vector<uint16_t> count(const Roi roi, const PixelLut& lut) const;
+
+        /**
+         * @brief Evaluate the stop line decision of every frame with different thresholds
+         *
+         * @param thresholds - The thresholds to evaluate
+         * @return std::vector<uint8_t> - 1 for every frame that would register a stop
+         */
+        std::vector<uint8_t> stopFlags(const StopThresholds& thresholds) const;
+
+        /**
+         * @brief Evaluate the car decision of every frame with different thresholds
+         *
+         * @param thresholds - The thresholds to evaluate
+         * @return std::vector<uint8_t> - 1 for every frame that would register a car
+         */
+        std::vector<uint8_t> carFlags(const CarThresholds& thresholds) const;
+
+        /**
+         * @brief Count the white pixels inside the white line crop of every frame with different thresholds
+         *
+         * @param thresholds - The thresholds to evaluate
+         * @return std::vector<uint16_t> - The white pixel count of each frame
+         */
+        std::vector<uint16_t> whiteCounts(const WhiteThresholds& thresholds) const;
+
+        /**
+         * @brief Write the index to a binary file
+         *
+         * @param filename - The path of the index file
+         * @return true - If the file was written
+         */
+        bool save(const std::string& filename) const;
+
+        /**
+         * @brief Replace the contents of this index with an index file
+         *
+         * @param filename - The path of the index file
+         * @return true - If the file was read and was built with the current region geometry
+         */
+        bool load(const std::string& filename);
+
+    private:
+        std::vector<FrameHistogram> m_frames;
+    };
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "opencv2.hpp"
+#include "params.hpp"
+
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief OpenCV type of the canonical frame every stage of the pipeline consumes.
+ * 
+ * A canonical frame is an IMG_ROWS x IMG_COLS continuous matrix of native-endian uint16_t RGB565 pixels.
+ * The loaders normalize the byte order of every file format exactly once, so the detectors and
+ * conversions can read pixels straight out of the row pointers with ptr<uint16_t>().
+ */
+constexpr int FRAME_TYPE = CV_16UC1;
+
+/**
+ * @brief Convert an RGB888 color to a 16-bit RGB565 color.
+ * 
+ * @param r - The red value
+ * @param g - The green value
+ * @param b - the blue value
+ * @return constexpr uint16_t - The RGB565 color 
+ */
+constexpr uint16_t RGB888toRGB565(const uint8_t r, const uint8_t g, const uint8_t b) {
+    uint16_t red = (r * 31) / 255;
+    uint16_t green = (g * 63) / 255;
+    uint16_t blue = (b * 31) / 255;
+
+    return (red << 11) | (green << 5) | blue;
+}
+
+/**
+ * @brief Convert an RGB565 color to an RGB888 color.
+ * 
+ * @param pixel - The encoded RGB565 color
+ * @return std::array<uint8_t, 3> - Red, green, and blue values
+ */
+constexpr std::array<uint8_t, 3> RGB565toRGB888(const uint16_t pixel) {
+    // Extract individual color components (5-bit Red, 6-bit Green, 5-bit Blue)
+    uint8_t r = (pixel >> 11) & 0x1F;  // Extract red (5 bits)
+    uint8_t g = (pixel >> 5) & 0x3F;   // Extract green (6 bits)
+    uint8_t b = pixel & 0x1F;          // Extract blue (5 bits)
+
+    // Scale the components to 0-255 range
+    uint8_t red = (r * 255) / 31;  // Scale red from 5 bits to 8 bits
+    uint8_t green = (g * 255) / 63;  // Scale green from 6 bits to 8 bits
+    uint8_t blue = (b * 255) / 31;  // Scale blue from 5 bits to 8 bits
+
+    return {red, green, blue};
+}
+
+/**
+ * @brief Convert a canonical RGB565 frame to a CV_8UC3 opencv matrix of RGB888
+ * 
+ * @param rgb565_image - The canonical RGB565 frame
+ * @return cv::Mat - The CV_8UC3 opencv matrix of RGB888
+ */
+cv::Mat convert_rgb565_to_rgb888(const cv::Mat rgb565_image);
+
+/**
+ * @brief Vectorized version of convert_rgb565_to_rgb888. Converts an entire span of RGB565 images to RGB888.
+ * 
+ * @overload
+ * @param rgb565_images - A span of canonical RGB565 frames
+ * @return std::vector<cv::Mat> - A vector of CV_8UC3 opencv matrices of RGB888
+ */
+std::vector<cv::Mat> convert_rgb565_to_rgb888(std::span<const cv::Mat> rgb565_images);
+
+/**
+ * @brief Load a raw binary image file into a canonical RGB565 frame
+ * 
+ * @param filename - The filepath to the binary file
+ * @param saveImage - Whether to save the image as a PNG
+ * @return cv::Mat - The canonical CV_16UC1 frame, or an empty matrix on failure
+ */
+cv::Mat load_binary_image(const std::string& filename, bool saveImage = false);
+
+/**
+ * @brief Vectorized version of load_binary_image. Loads an entire span of binary images into canonical RGB565 frames.
+ * 
+ * @param filenames - The filepaths to the binary files
+ * @param save_images - Whether to save the images as PNGs
+ * @return std::vector<cv::Mat> - A vector of canonical CV_16UC1 frames
+ */
+std::vector<cv::Mat> load_binary_images(std::span<const std::string> filenames, bool save_images = false);
+
+/**
+ * @brief Load an image file saved in the compact hex format into a canonical RGB565 frame
+ * 
+ * @param filename - The filepath to the hex file
+ * @param saveImage - Whether to save the image as a PNG
+ * @return cv::Mat - The canonical CV_16UC1 frame, or an empty matrix on failure
+ */
+cv::Mat load_compact_hex_image(const std::string& filename, bool saveImage = false);
+
+/**
+ * @brief Vectorized version of load_compact_hex_image. Loads an entire span of hex images into canonical RGB565 frames.
+ * 
+ * @param filenames - The filepaths to the hex files
+ * @param save_images - Whether to save the images as PNGs
+ * @return std::vector<cv::Mat> - A vector of canonical CV_16UC1 frames
+ */
+std::vector<cv::Mat> load_compact_hex_images(std::span<const std::string> filenames, bool save_images = false);
+
+/**
+ * @brief Encode a canonical RGB565 frame in the raw binary format the SD card program saves, high byte first
+ * 
+ * @param pixels - The IMG_ROWS x IMG_COLS native-endian pixels
+ * @return std::string - The IMG_SIZE bytes of the file
+ */
+std::string encode_binary_image(std::span<const uint16_t> pixels);
+
+/**
+ * @brief Encode a canonical RGB565 frame in the compact hex format the firmware prints, one line per row
+ * 
+ * @param pixels - The IMG_ROWS x IMG_COLS native-endian pixels
+ * @return std::string - The text of the file
+ */
+std::string encode_compact_hex_image(std::span<const uint16_t> pixels);
+
+/**
+ * @brief Get the path of the PNG saved alongside a raw binary image
+ * 
+ * @param filename - The filepath to the binary file
+ * @return std::string - The filepath of the PNG
+ */
+std::string binary_png_path(const std::string& filename);
+
+/**
+ * @brief Get the path of the PNG saved alongside a compact hex image
+ * 
+ * @param filename - The filepath to the hex file
+ * @return std::string - The filepath of the PNG
+ */
+std::string compact_hex_png_path(const std::string& filename);
+
+/**
+ * @brief Get all of the filenames in a directory. Filters only files with the specified extensions if given.
+ * 
+ * @param directory_path - The path to the directory
+ * @param extensions - The extensions to filter by. Will include all files if empty.
+ * @return std::vector<std::string> - A vector of filepaths 
+ */
+std::vector<std::string> get_filenames_in_dir(const std::string& directory_path, std::span<std::string> extensions = {});
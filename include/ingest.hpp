@@ -0,0 +1,203 @@
+#pragma once
+
+#include "frame_ring.hpp"
+#include "microcv2_core.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Namespace for the TCP frame ingestion server. Linux only, it is built on epoll.
+ *
+ * Each robot opens a TCP connection, sends a handshake line naming its encoding, and then streams frames:
+ *   ESPSTREAM RAW - Raw 18,432 byte frames, high byte first, as the SD card program saves them
+ *   ESPSTREAM HEX - Compact hex frames, 96 lines of 384 hex digits, as the firmware prints them. Lines
+ *                   that are not hex are skipped, so log lines and FILE CONTENT markers can be left in.
+ *                   A line longer than two rows of hex digits is answered with ERROR line too long and the
+ *                   connection is closed.
+ *
+ * The server answers every frame on the same connection with a line of
+ *   seq,stop,white,dist,red_percent
+ * in the order the frames were sent, where seq counts the frames of the connection from 0. Frames from
+ * every connection are processed by one shared worker pool. Each connection may only have a bounded
+ * number of frames queued or in progress; beyond that the server stops reading from it, so TCP flow
+ * control slows that robot down without affecting the others. When a robot shuts down its sending side,
+ * the server answers the frames it still has and then closes the connection.
+ *
+ * With ServerOptions::ring set, the event loop also publishes every answered frame and its results to a
+ * shared memory frame ring, so other processes such as the viewer can watch the streams live.
+ */
+namespace Ingest {
+
+    constexpr uint16_t DEFAULT_PORT = 5760;
+    constexpr std::string_view HANDSHAKE_RAW = "ESPSTREAM RAW";
+    constexpr std::string_view HANDSHAKE_HEX = "ESPSTREAM HEX";
+
+    enum class Encoding : uint8_t {
+        RAW,
+        HEX
+    };
+
+    /**
+     * @brief The detection output the server returns for a frame
+     *
+     */
+    struct FrameResult {
+        uint64_t seq = 0;           ///< Index of the frame on its connection
+        bool stop = false;
+        bool white = false;
+        int8_t dist = 0;            ///< 0 if no line was found
+        uint16_t redPercent = 0;    ///< Percentage of the stop box that was red, times 100
+        float blobArea = 0;         ///< Area of the largest white blob, not sent to the robot
+    };
+
+    /**
+     * @brief Format a result as the line the server sends, including the newline
+     *
+     */
+    std::string formatResult(const FrameResult& result);
+
+    /**
+     * @brief Parse a result line sent by the server, without the newline
+     *
+     * @return true - If the line was a well-formed result
+     */
+    bool parseResult(std::string_view line, FrameResult& result);
+
+    /**
+     * @brief Run the detectors the server runs on a frame
+     *
+     * @param frame - The canonical RGB565 frame
+     * @param cfg - The thresholds to use
+     * @return FrameResult - The result, with seq left at 0
+     */
+    FrameResult detect(std::span<const uint16_t> frame, const MicroCV2::Core::Config& cfg = MicroCV2::Core::DEFAULT_CONFIG);
+
+    struct ServerOptions {
+        std::string host = "127.0.0.1";     ///< Address to listen on. 0.0.0.0 accepts robots on the LAN.
+        uint16_t port = DEFAULT_PORT;       ///< 0 picks a free port
+        unsigned int workers = 0;           ///< Detection threads. Uses all hardware threads if 0.
+        size_t maxInFlight = 8;             ///< Frames a connection may have queued or in progress
+        std::string ring;                   ///< Shared memory frame ring to publish every answered frame to, none if empty
+        uint32_t ringSlots = FrameRing::DEFAULT_SLOTS;
+        MicroCV2::Core::Config config = MicroCV2::Core::DEFAULT_CONFIG;
+    };
+
+    /**
+     * @brief Counts of what the server has done so far
+     *
+     */
+    struct ServerStats {
+        uint64_t connections = 0;   ///< Connections accepted
+        uint64_t frames = 0;        ///< Frames answered
+        uint64_t bytesIn = 0;
+        uint64_t throttled = 0;     ///< Times a connection stopped being read because it hit maxInFlight
+    };
+
+    class Server {
+    public:
+        explicit Server(const ServerOptions& options);
+
+        /**
+         * @brief Close every connection and stop the worker pool
+         *
+         */
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        /**
+         * @brief Open the listening socket and start the worker pool
+         *
+         * @return true - If the server is ready to run
+         */
+        bool listen();
+
+        /**
+         * @brief Run the event loop until stop is called
+         *
+         */
+        void run();
+
+        /**
+         * @brief Make run return. Safe to call from any thread and from a signal handler.
+         *
+         */
+        void stop();
+
+        /**
+         * @brief Get the port the server is listening on
+         *
+         */
+        uint16_t port() const { return m_port; }
+
+        /**
+         * @brief Get a snapshot of the server counts
+         *
+         */
+        ServerStats stats() const;
+
+    private:
+        struct Connection;
+
+        struct Job {
+            uint64_t connection;
+            uint64_t seq;
+            std::vector<uint16_t> pixels;
+        };
+
+        struct Completion {
+            uint64_t connection;
+            FrameResult result;
+            std::vector<uint16_t> pixels;   ///< Kept for the frame ring
+        };
+
+        void workerLoop();
+        void acceptConnections();
+        void readFrom(Connection& connection);
+        void parseFrames(Connection& connection);
+        void failLongLine(Connection& connection);
+        void submit(Connection& connection, std::vector<uint16_t>&& pixels);
+        void writeTo(Connection& connection);
+        void drainCompletions();
+        void updateEvents(Connection& connection);
+        bool finished(const Connection& connection) const;
+        void close(uint64_t id);
+
+        ServerOptions m_options;
+        uint16_t m_port = 0;
+        int m_listenFd = -1;
+        int m_epollFd = -1;
+        int m_wakeFd = -1;          ///< eventfd the workers and stop() use to wake the event loop
+
+        std::unordered_map<uint64_t, std::unique_ptr<Connection>> m_connections;
+        uint64_t m_nextId;
+
+        std::vector<std::thread> m_workers;
+        std::deque<Job> m_jobs;
+        std::mutex m_jobMutex;
+        std::condition_variable m_jobAvailable;
+        bool m_stoppingWorkers = false;
+
+        std::vector<Completion> m_completions;
+        std::mutex m_completionMutex;
+
+        std::unique_ptr<FrameRing::Producer> m_ring;
+
+        std::atomic<bool> m_running = false;
+        std::atomic<uint64_t> m_accepted = 0;
+        std::atomic<uint64_t> m_frames = 0;
+        std::atomic<uint64_t> m_bytesIn = 0;
+        std::atomic<uint64_t> m_throttled = 0;
+    };
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "microcv2_core.hpp"
+
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Namespace for the runtime dispatched pixel kernels.
+ *
+ * Every hot pixel loop is compiled once per instruction set into its own table. At startup the best
+ * table the CPU supports is picked by CPUID, so a single generic binary runs the AVX-512 loops on nodes
+ * that have it and the SSE4.2 or scalar loops everywhere else. Set ESPVIEWER_KERNELS to override the
+ * choice:
+ *   scalar, sse4.2, avx2, avx512 - Force a table. Falls back to auto if the CPU does not support it.
+ *   auto                         - The best table the CPU supports (default)
+ *   calibrate                    - Time every supported table on a synthetic frame and pick the fastest
+ *                                  implementation of each operation
+ */
+namespace Kernels {
+
+    constexpr const char* ENV_VAR = "ESPVIEWER_KERNELS";
+
+    enum class Isa : uint8_t {
+        SCALAR,
+        SSE42,
+        AVX2,
+        AVX512,
+        COUNT
+    };
+
+    /**
+     * @brief Classify a run of canonical RGB565 pixels, writing 255 or 0 into the mask
+     *
+     * @return uint16_t - The number of matching pixels
+     */
+    using ClassifyFn = uint16_t (*)(const uint16_t* pixels, uint8_t* mask, int count, const MicroCV2::Core::Config& cfg);
+
+    /**
+     * @brief Convert a run of canonical RGB565 pixels to interleaved BGR888
+     *
+     */
+    using ConvertFn = void (*)(const uint16_t* pixels, uint8_t* bgr, size_t count);
+
+    /**
+     * @brief Write the BGR colour into every set mask pixel and black into every other pixel
+     *
+     */
+    using ColorizeFn = void (*)(const uint8_t* mask, uint8_t* bgr, size_t count, const uint8_t color[3]);
+
+    /**
+     * @brief Copy every non-black BGR pixel of the source over the destination
+     *
+     */
+    using LayerFn = void (*)(uint8_t* dst, const uint8_t* src, size_t count);
+
+    /**
+     * @brief Decode groups of 4 hex digits into canonical pixels, swapping the bytes the firmware printed
+     *
+     * @return true - If every digit was valid hex
+     */
+    using DecodeHexFn = bool (*)(const char* text, size_t words, uint16_t* pixels);
+
+    /**
+     * @brief One implementation of every kernel
+     *
+     */
+    struct KernelTable {
+        const char* name;
+        Isa isa;
+        ClassifyFn classifyStop;
+        ClassifyFn classifyWhite;
+        ClassifyFn classifyCar;
+        ConvertFn rgb565ToBgr888;
+        ColorizeFn colorizeMask;
+        LayerFn layerMask;
+        DecodeHexFn decodeHex;
+    };
+
+    /**
+     * @brief Get the name used for an instruction set in ESPVIEWER_KERNELS
+     *
+     */
+    const char* isaName(const Isa isa);
+
+    /**
+     * @brief Check whether this CPU and OS can run an instruction set
+     *
+     */
+    bool isSupported(const Isa isa);
+
+    /**
+     * @brief Get the table compiled for an instruction set
+     *
+     * @return const KernelTable* - The table, or nullptr if it was not compiled into this binary
+     */
+    const KernelTable* table(const Isa isa);
+
+    /**
+     * @brief Get every table this binary has that the CPU can run, slowest instruction set first
+     *
+     */
+    std::span<const KernelTable* const> supportedTables();
+
+    /**
+     * @brief Time every supported table on a synthetic frame and build a table from the fastest
+     * implementation of each operation
+     *
+     * @return KernelTable - The calibrated table
+     */
+    KernelTable calibrate();
+
+    /**
+     * @brief Get the table chosen at startup. Resolved once on first use and thread-safe.
+     *
+     */
+    const KernelTable& active();
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "kernels.hpp"
+
+/**
+ * @brief Portable bodies of every kernel. Only included by the src/kernels_*.cpp files, each of which is
+ * compiled with a different instruction set so the same loops are vectorized for it.
+ *
+ * The pointers are __restrict so the vectorizer needs no runtime alias checks. Everything here has
+ * internal linkage and does not call any inline function from another header. If it did, the linker
+ * could keep the AVX-512 copy of that function and hand it to code running on a CPU without AVX-512.
+ */
+namespace {
+
+    inline void decodePixel(const uint16_t pixel, uint16_t& red, uint16_t& green, uint16_t& blue)
+    {
+        red = ((pixel >> 11) & 0x1F) * 255 / 31;
+        green = ((pixel >> 5) & 0x3F) * 255 / 63;
+        blue = (pixel & 0x1F) * 255 / 31;
+    }
+
+    uint16_t classifyStop(const uint16_t* __restrict pixels, uint8_t* __restrict mask, const int count, const MicroCV2::Core::Config& cfg)
+    {
+        const uint16_t greenTol = cfg.STOP_GREEN_TOLERANCE, blueTol = cfg.STOP_BLUE_TOLERANCE;
+        const uint16_t whiteRed = cfg.WHITE_RED_THRESH, whiteGreen = cfg.WHITE_GREEN_THRESH, whiteBlue = cfg.WHITE_BLUE_THRESH;
+
+        uint16_t hits = 0;
+        for (int i = 0; i < count; ++i) {
+            uint16_t red, green, blue;
+            decodePixel(pixels[i], red, green, blue);
+
+            const bool stop = (red >= green + greenTol) & (red >= blue + blueTol);
+            const bool white = (red >= whiteRed) & (green >= whiteGreen) & (blue >= whiteBlue);
+            const uint8_t hit = stop & !white;
+            mask[i] = static_cast<uint8_t>(-hit);
+            hits += hit;
+        }
+        return hits;
+    }
+
+    uint16_t classifyWhite(const uint16_t* __restrict pixels, uint8_t* __restrict mask, const int count, const MicroCV2::Core::Config& cfg)
+    {
+        const uint16_t whiteRed = cfg.WHITE_RED_THRESH, whiteGreen = cfg.WHITE_GREEN_THRESH, whiteBlue = cfg.WHITE_BLUE_THRESH;
+
+        uint16_t hits = 0;
+        for (int i = 0; i < count; ++i) {
+            uint16_t red, green, blue;
+            decodePixel(pixels[i], red, green, blue);
+
+            const uint8_t hit = (red >= whiteRed) & (green >= whiteGreen) & (blue >= whiteBlue);
+            mask[i] = static_cast<uint8_t>(-hit);
+            hits += hit;
+        }
+        return hits;
+    }
+
+    uint16_t classifyCar(const uint16_t* __restrict pixels, uint8_t* __restrict mask, const int count, const MicroCV2::Core::Config& cfg)
+    {
+        const uint16_t redTol = cfg.CAR_RED_TOLERANCE, blueTol = cfg.CAR_BLUE_TOLERANCE;
+
+        uint16_t hits = 0;
+        for (int i = 0; i < count; ++i) {
+            uint16_t red, green, blue;
+            decodePixel(pixels[i], red, green, blue);
+
+            const uint8_t hit = (green >= red + redTol) & (green >= blue + blueTol);
+            mask[i] = static_cast<uint8_t>(-hit);
+            hits += hit;
+        }
+        return hits;
+    }
+
+    void rgb565ToBgr888(const uint16_t* __restrict pixels, uint8_t* __restrict bgr, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t red, green, blue;
+            decodePixel(pixels[i], red, green, blue);
+
+            bgr[3 * i] = static_cast<uint8_t>(blue);
+            bgr[3 * i + 1] = static_cast<uint8_t>(green);
+            bgr[3 * i + 2] = static_cast<uint8_t>(red);
+        }
+    }
+
+    void colorizeMask(const uint8_t* __restrict mask, uint8_t* __restrict bgr, const size_t count, const uint8_t color[3])
+    {
+        const uint8_t b = color[0], g = color[1], r = color[2];
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t set = mask[i] != 0 ? 0xFF : 0x00;
+            bgr[3 * i] = b & set;
+            bgr[3 * i + 1] = g & set;
+            bgr[3 * i + 2] = r & set;
+        }
+    }
+
+    void layerMask(uint8_t* __restrict dst, const uint8_t* __restrict src, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t keep = (src[3 * i] | src[3 * i + 1] | src[3 * i + 2]) != 0 ? 0x00 : 0xFF;
+            dst[3 * i] = (dst[3 * i] & keep) | src[3 * i];
+            dst[3 * i + 1] = (dst[3 * i + 1] & keep) | src[3 * i + 1];
+            dst[3 * i + 2] = (dst[3 * i + 2] & keep) | src[3 * i + 2];
+        }
+    }
+
+    bool decodeHex(const char* __restrict text, const size_t words, uint16_t* __restrict pixels)
+    {
+        uint8_t invalid = 0;
+        for (size_t i = 0; i < words; ++i) {
+            uint16_t value = 0;
+            for (int d = 0; d < 4; ++d) {
+                const uint8_t c = static_cast<uint8_t>(text[4 * i + d]);
+                const uint8_t lower = c | 0x20;     // Folds A-F onto a-f and leaves digits alone
+                const bool digit = (c >= '0') & (c <= '9');
+                const bool letter = (lower >= 'a') & (lower <= 'f');
+
+                invalid |= !(digit | letter);
+                value = (value << 4) | (digit ? c - '0' : lower - 'a' + 10);
+            }
+            pixels[i] = static_cast<uint16_t>((value << 8) | (value >> 8));
+        }
+        return invalid == 0;
+    }
+
+    constexpr Kernels::KernelTable makeTable(const char* name, const Kernels::Isa isa)
+    {
+        return {name, isa, &classifyStop, &classifyWhite, &classifyCar, &rgb565ToBgr888, &colorizeMask, &layerMask, &decodeHex};
+    }
+
+}
@@ -3,13 +3,28 @@
 // Opencv Imports
 #include "opencv2.hpp"
 
+#include "microcv2_core.hpp"
 #include "params.hpp"
+#include "tap.hpp"
 
 #include <span>
 #include <fmt/base.h>
 
 using contour_t = std::vector<cv::Point2i>;
 
+/**
+ * @brief OpenCV versions of the box corners in params.hpp, which stays OpenCV-free for the core
+ * 
+ */
+namespace Params {
+
+const cv::Point2i STOPBOX_TL(STOPBOX_TL_X,STOPBOX_TL_Y);
+const cv::Point2i STOPBOX_BR(STOPBOX_BR_X,STOPBOX_BR_Y);
+const cv::Point2i CARBOX_TL(CARBOX_TL_X,CARBOX_TL_Y);
+const cv::Point2i CARBOX_BR(CARBOX_BR_X,CARBOX_BR_Y);
+
+}
+
 /**
  * @brief Namespace for all functions related to the ESP32's image processing pipeline.
  * These should, where ever possible, match the functions running on the ESP32.
@@ -58,17 +73,41 @@ namespace MicroCV2 {
     /**
      * @brief Process a frame for everything related to the stop line.
      * 
-     * @param img - Input image
+     * @param img - Input canonical CV_16UC1 frame
      * @param mask - Output mask of all red pixels
      * @return Whether the stop line was detected or not
      */
     bool processRedImg(const cv::Mat& img, cv::Mat1b& mask);
 
+    /**
+     * @brief Process a frame for everything related to the stop line using runtime thresholds.
+     * Setting COARSE_FACTOR uses the coarse-to-fine pass.
+     * 
+     * @param img - Input canonical CV_16UC1 frame
+     * @param mask - Output mask of all red pixels
+     * @param cfg - The thresholds to use
+     * @return Whether the stop line was detected or not
+     */
+    bool processRedImg(const cv::Mat& img, cv::Mat1b& mask, const Core::Config& cfg);
+
+    /**
+     * @brief Process a frame for everything related to the stop line and keep the pixel count and percentage.
+     * 
+     * @param img - Input canonical CV_16UC1 frame
+     * @param mask - Output mask of all red pixels
+     * @param cfg - The thresholds to use
+     * @param result - Output count, percentage, and decision of the stop box
+     * @param tap - Optional sink for the intermediate masks and the box result
+     * @return Whether the stop line was detected or not
+     */
+    bool processRedImg(const cv::Mat& img, cv::Mat1b& mask, const Core::Config& cfg, Core::BoxResult& result,
+                       Tap::Sink* tap = nullptr);
+
     /**
      * @warning OBSTACLE AND CAR DETECTION IS CURRENTLY NOT WORKING OR USED (4/8/2025)
      * @brief Process a frame for everything related to detecting obstacles or other cars.
      * 
-     * @param img - Input image
+     * @param img - Input canonical CV_16UC1 frame
      * @param mask - Output mask of all obstacle pixels
      * @return Whether an obstacle was detected or not
      */
@@ -77,7 +116,7 @@ namespace MicroCV2 {
     /**
      * @brief Process a frame for everything related to the white line.
      * 
-     * @param img - Input image
+     * @param img - Input canonical CV_16UC1 frame
      * @param mask - Output mask of all white pixels
      * @param centerLine - Additional output mask showing other reference lines and points
      * @param dist - The reported distance to the white line
@@ -85,6 +124,34 @@ namespace MicroCV2 {
      */
     bool processWhiteImg(const cv::Mat& img, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist);
 
+    /**
+     * @brief Process a frame for everything related to the white line using runtime thresholds.
+     * Setting COARSE_FACTOR uses the coarse-to-fine pass.
+     * 
+     * @param img - Input canonical CV_16UC1 frame
+     * @param mask - Output mask of all white pixels
+     * @param centerLine - Additional output mask showing other reference lines and points
+     * @param dist - The reported distance to the white line
+     * @param cfg - The thresholds to use
+     * @return Whether the white line was detected or not
+     */
+    bool processWhiteImg(const cv::Mat& img, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist, const Core::Config& cfg);
+
+    /**
+     * @brief Process a frame for everything related to the white line and keep the blob and line fit.
+     * 
+     * @param img - Input canonical CV_16UC1 frame
+     * @param mask - Output mask of all white pixels
+     * @param centerLine - Additional output mask showing other reference lines and points
+     * @param dist - The reported distance to the white line
+     * @param cfg - The thresholds to use
+     * @param result - Output largest blob and line fit
+     * @param tap - Optional sink for the intermediate masks, the blob, and the line fit
+     * @return Whether the white line was detected or not
+     */
+    bool processWhiteImg(const cv::Mat& img, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist, const Core::Config& cfg,
+                         Core::WhiteResult& result, Tap::Sink* tap = nullptr);
+
     /**
      * @brief Convert a single channel grayscale mask to a three channel mask of a specified color
      * 
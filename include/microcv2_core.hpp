@@ -0,0 +1,768 @@
+#pragma once
+
+#include "morphology.hpp"
+#include "params.hpp"
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <stdint.h>
+
+/**
+ * @brief OpenCV-free core of the ESP32 image processing pipeline.
+ *
+ * Everything in here works on canonical RGB565 frames passed as a span of native-endian uint16_t pixels
+ * plus a width and height, writes into caller-provided buffers, and never allocates. It has no
+ * dependency beyond the standard library and params.hpp, so the same header can be compiled into the
+ * firmware. The MicroCV2 functions are thin OpenCV adapters over these that add the visualization.
+ */
+namespace MicroCV2::Core {
+
+    /**
+     * @brief Largest frame the fixed size workspaces can hold
+     *
+     */
+    constexpr uint32_t MAX_PIXELS = IMG_ROWS * IMG_COLS;
+
+    /**
+     * @brief Side length of the tiles the coarse-to-fine white line pass refines
+     *
+     */
+    constexpr int COARSE_TILE = 8;
+    constexpr uint32_t MAX_TILES = ((IMG_COLS + COARSE_TILE - 1) / COARSE_TILE) * ((IMG_ROWS + COARSE_TILE - 1) / COARSE_TILE);
+
+    /**
+     * @brief Integer pixel coordinate
+     *
+     */
+    struct Point {
+        int x = 0;
+        int y = 0;
+
+        constexpr bool operator==(const Point&) const = default;
+    };
+
+    /**
+     * @brief Runtime copy of every tunable in Params. Defaults to the compiled in values so the core
+     * matches the firmware unless a caller deliberately changes a threshold.
+     *
+     */
+    struct Config {
+        uint8_t STOPBOX_TL_X            = Params::STOPBOX_TL_X;
+        uint8_t STOPBOX_TL_Y            = Params::STOPBOX_TL_Y;
+        uint8_t STOPBOX_BR_X            = Params::STOPBOX_BR_X;
+        uint8_t STOPBOX_BR_Y            = Params::STOPBOX_BR_Y;
+        uint8_t PERCENT_TO_STOP         = Params::PERCENT_TO_STOP;
+        uint8_t STOP_GREEN_TOLERANCE    = Params::STOP_GREEN_TOLERANCE;
+        uint8_t STOP_BLUE_TOLERANCE     = Params::STOP_BLUE_TOLERANCE;
+
+        uint8_t WHITE_VERTICAL_CROP     = Params::WHITE_VERTICAL_CROP;
+        uint8_t WHITE_HORIZONTAL_CROP   = Params::WHITE_HORIZONTAL_CROP;
+        uint8_t WHITE_RED_THRESH        = Params::WHITE_RED_THRESH;
+        uint8_t WHITE_GREEN_THRESH      = Params::WHITE_GREEN_THRESH;
+        uint8_t WHITE_BLUE_THRESH       = Params::WHITE_BLUE_THRESH;
+        uint16_t WHITE_MIN_SIZE         = Params::WHITE_MIN_SIZE;
+        uint8_t WHITE_CENTER_POS        = Params::WHITE_CENTER_POS;
+
+        uint8_t CARBOX_TL_X             = Params::CARBOX_TL_X;
+        uint8_t CARBOX_TL_Y             = Params::CARBOX_TL_Y;
+        uint8_t CARBOX_BR_X             = Params::CARBOX_BR_X;
+        uint8_t CARBOX_BR_Y             = Params::CARBOX_BR_Y;
+        uint8_t PERCENT_TO_CAR          = Params::PERCENT_TO_CAR;
+        uint8_t CAR_RED_TOLERANCE       = Params::CAR_RED_TOLERANCE;
+        uint8_t CAR_BLUE_TOLERANCE      = Params::CAR_BLUE_TOLERANCE;
+
+        uint8_t COARSE_FACTOR           = 0;    ///< Decimation of the optional coarse-to-fine pass. 0 or 1 scans every pixel. Lowered to suit WHITE_MIN_SIZE for the white line.
+
+        // Optional morphology on the masks, a Morph::Op each. 0 skips it. Morphology needs the whole mask,
+        // so the coarse-to-fine passes are not used for a detector that has it enabled.
+        uint8_t STOP_MORPHOLOGY         = 0;    ///< Run on the stop box before counting
+        uint8_t WHITE_MORPHOLOGY        = 0;    ///< Run on the white line crop before blob analysis
+        uint8_t MORPH_SHAPE             = 0;    ///< Morph::Shape of the structuring element
+
+        constexpr uint16_t stopBoxArea() const { return Params::BOX_AREA(STOPBOX_TL_X, STOPBOX_TL_Y, STOPBOX_BR_X, STOPBOX_BR_Y); }
+        constexpr uint16_t carBoxArea() const { return Params::BOX_AREA(CARBOX_TL_X, CARBOX_TL_Y, CARBOX_BR_X, CARBOX_BR_Y); }
+    };
+
+    constexpr Config DEFAULT_CONFIG{};
+
+    /**
+     * @brief Result of the stop line or car box test
+     *
+     */
+    struct BoxResult {
+        uint16_t count = 0;         ///< Number of matching pixels inside the box. Only a lower bound in coarse-to-fine mode.
+        uint16_t percent = 0;       ///< Percentage of the box that matched, times 100
+        bool detected = false;
+    };
+
+    /**
+     * @brief The largest blob in a mask and its extreme points. Mirrors the points the original
+     * contour-based implementation found on the largest contour.
+     *
+     */
+    struct Blob {
+        bool found = false;
+        int32_t area2 = 0;          ///< Twice the area enclosed by the blob's outer border
+        uint16_t label = 0;         ///< Label of the blob in Workspace::labels
+        Point start;                ///< First pixel of the blob in raster order, where its border starts
+        Point topLeft, topRight, bottomLeft, bottomRight;
+        Point leftTop, leftBottom, rightTop, rightBottom;
+    };
+
+    /**
+     * @brief The line fitted along the left edge of the white line blob
+     *
+     */
+    struct LineFit {
+        float slope = 0;
+        float yIntercept = 0;
+        Point intersection;         ///< Where the line crosses WHITE_VERTICAL_CROP
+        int8_t rawDist = 0;         ///< Distance from WHITE_CENTER_POS before clamping
+        int8_t dist = 0;            ///< Distance clamped to the edge of the image
+    };
+
+    /**
+     * @brief Full result of the white line detector
+     *
+     */
+    struct WhiteResult {
+        bool detected = false;
+        bool refined = false;       ///< True if the coarse-to-fine pass produced the result without falling back
+        Blob blob;
+        LineFit line;
+    };
+
+    /**
+     * @brief Scratch buffers for blob analysis. About 36KB, so keep one per thread rather than on the stack.
+     *
+     */
+    struct Workspace {
+        std::array<uint16_t, MAX_PIXELS> labels;
+        std::array<uint16_t, MAX_PIXELS> stack;
+        std::array<uint8_t, MAX_TILES> tiles;
+    };
+
+    /**
+     * @brief Convert a single 16-bit RGB565 pixel to 3 8-bit RGB888 pixels
+     *
+     */
+    constexpr void RGB565toRGB888(const uint16_t pixel, uint16_t& red, uint16_t& green, uint16_t& blue)
+    {
+        red = (pixel >> 11) & 0x1F;
+        green = (pixel >> 5) & 0x3F;
+        blue = pixel & 0x1F;
+
+        red = (red * 255) / 31;
+        green = (green * 255) / 63;
+        blue = (blue * 255) / 31;
+    }
+
+    /**
+     * @brief Return true if a pixel is red enough to be considered a stop line
+     *
+     */
+    constexpr bool isStopLine(const uint16_t red, const uint16_t green, const uint16_t blue, const Config& cfg = DEFAULT_CONFIG)
+    {
+        return red >= green + cfg.STOP_GREEN_TOLERANCE && red >= blue + cfg.STOP_BLUE_TOLERANCE;
+    }
+
+    /**
+     * @brief Return true if a pixel is white enough to be considered a white line
+     *
+     */
+    constexpr bool isWhiteLine(const uint16_t red, const uint16_t green, const uint16_t blue, const Config& cfg = DEFAULT_CONFIG)
+    {
+        return red >= cfg.WHITE_RED_THRESH && green >= cfg.WHITE_GREEN_THRESH && blue >= cfg.WHITE_BLUE_THRESH;
+    }
+
+    /**
+     * @brief Return true if a pixel is green enough to be considered a car
+     *
+     */
+    constexpr bool isCar(const uint16_t red, const uint16_t green, const uint16_t blue, const Config& cfg = DEFAULT_CONFIG)
+    {
+        return green >= red + cfg.CAR_RED_TOLERANCE && green >= blue + cfg.CAR_BLUE_TOLERANCE;
+    }
+
+    /**
+     * @brief Return true if an RGB565 pixel counts towards the stop line
+     *
+     */
+    constexpr bool isStopPixel(const uint16_t pixel, const Config& cfg = DEFAULT_CONFIG)
+    {
+        uint16_t red, green, blue;
+        RGB565toRGB888(pixel, red, green, blue);
+        return isStopLine(red, green, blue, cfg) && !isWhiteLine(red, green, blue, cfg);
+    }
+
+    /**
+     * @brief Return true if an RGB565 pixel counts towards the white line
+     *
+     */
+    constexpr bool isWhitePixel(const uint16_t pixel, const Config& cfg = DEFAULT_CONFIG)
+    {
+        uint16_t red, green, blue;
+        RGB565toRGB888(pixel, red, green, blue);
+        return isWhiteLine(red, green, blue, cfg);
+    }
+
+    /**
+     * @brief Return true if an RGB565 pixel counts towards a car
+     *
+     */
+    constexpr bool isCarPixel(const uint16_t pixel, const Config& cfg = DEFAULT_CONFIG)
+    {
+        uint16_t red, green, blue;
+        RGB565toRGB888(pixel, red, green, blue);
+        return isCar(red, green, blue, cfg);
+    }
+
+    /**
+     * @brief Classify every pixel inside an inclusive box, writing 255 or 0 into the mask
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame. Pixels outside the box are not touched.
+     * @param tl - Top left corner of the box
+     * @param br - Bottom right corner of the box
+     * @param predicate - Pixel classifier taking the RGB565 value
+     * @return uint16_t - The number of matching pixels
+     */
+    template <typename Predicate>
+    uint16_t classifyBox(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                         const Point tl, const Point br, Predicate&& predicate)
+    {
+        const int x0 = std::max(tl.x, 0), x1 = std::min(br.x, width - 1);
+        const int y0 = std::max(tl.y, 0), y1 = std::min(br.y, height - 1);
+
+        uint16_t count = 0;
+        for (int y = y0; y <= y1; ++y) {
+            const uint16_t* row = frame.data() + y * width;
+            uint8_t* maskRow = mask.data() + y * width;
+
+            for (int x = x0; x <= x1; ++x) {
+                const uint8_t hit = predicate(row[x]) ? 1 : 0;
+                maskRow[x] = static_cast<uint8_t>(-hit);
+                count += hit;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief Apply the detectors' integer percentage test to a box count
+     *
+     */
+    constexpr BoxResult boxResult(const uint16_t count, const uint16_t area, const uint8_t percentToDetect)
+    {
+        BoxResult result;
+        result.count = count;
+        if (area == 0) return result;
+
+        result.percent = (count * 10000) / area;
+        result.detected = result.percent >= (percentToDetect * 100);
+        return result;
+    }
+
+    /**
+     * @brief Run the configured morphology on the stop box of a stop mask
+     *
+     * @param mask - The stop mask, width x height
+     * @param width - Mask width
+     * @param height - Mask height
+     * @param cfg - STOP_MORPHOLOGY and MORPH_SHAPE pick the operation
+     * @return uint16_t - The number of set pixels in the stop box afterwards
+     */
+    inline uint16_t cleanStopMask(std::span<uint8_t> mask, const int width, const int height, const Config& cfg)
+    {
+        return static_cast<uint16_t>(Morph::apply(mask, width, height, cfg.STOPBOX_TL_X, cfg.STOPBOX_TL_Y, cfg.STOPBOX_BR_X,
+                                                  cfg.STOPBOX_BR_Y, static_cast<Morph::Op>(cfg.STOP_MORPHOLOGY),
+                                                  static_cast<Morph::Shape>(cfg.MORPH_SHAPE)));
+    }
+
+    /**
+     * @brief Run the configured morphology on the white line crop of a white mask
+     *
+     * @param mask - The white mask, width x height
+     * @param width - Mask width
+     * @param height - Mask height
+     * @param cfg - WHITE_MORPHOLOGY and MORPH_SHAPE pick the operation
+     * @return uint16_t - The number of set pixels in the crop afterwards
+     */
+    inline uint16_t cleanWhiteMask(std::span<uint8_t> mask, const int width, const int height, const Config& cfg)
+    {
+        return static_cast<uint16_t>(Morph::apply(mask, width, height, 0, cfg.WHITE_VERTICAL_CROP, cfg.WHITE_HORIZONTAL_CROP - 1,
+                                                  height - 1, static_cast<Morph::Op>(cfg.WHITE_MORPHOLOGY),
+                                                  static_cast<Morph::Shape>(cfg.MORPH_SHAPE)));
+    }
+
+    /**
+     * @brief Process a frame for everything related to the stop line
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame of all counted red pixels
+     * @param cfg - Thresholds to use
+     * @return BoxResult - The red pixel count and stop decision
+     */
+    inline BoxResult processRed(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                const Config& cfg = DEFAULT_CONFIG);
+
+    /**
+     * @brief Coarse-to-fine version of processRed. Classifies a decimated grid of the stop box first and
+     * then the rest of the box row by row, stopping as soon as the decision can no longer change. The
+     * decision always matches processRed, but the count and mask only cover the pixels that were visited.
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame of the counted red pixels that were visited
+     * @param cfg - Thresholds to use. COARSE_FACTOR sets the decimation.
+     * @return BoxResult - The red pixel count so far and the stop decision
+     */
+    inline BoxResult processRedCoarse(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                      const Config& cfg = DEFAULT_CONFIG)
+    {
+        std::fill(mask.begin(), mask.end(), 0);
+
+        BoxResult result;
+        const uint16_t area = cfg.stopBoxArea();
+        if (area == 0) return result;
+
+        const int factor = std::max<int>(cfg.COARSE_FACTOR, 1);
+        const int x0 = std::max<int>(cfg.STOPBOX_TL_X, 0), x1 = std::min<int>(cfg.STOPBOX_BR_X, width - 1);
+        const int y0 = std::max<int>(cfg.STOPBOX_TL_Y, 0), y1 = std::min<int>(cfg.STOPBOX_BR_Y, height - 1);
+
+        // Smallest count for which (count * 10000) / area >= PERCENT_TO_STOP * 100
+        const int needed = (cfg.PERCENT_TO_STOP * area + 99) / 100;
+        int remaining = std::max(x1 - x0 + 1, 0) * std::max(y1 - y0 + 1, 0);
+        int count = 0;
+
+        auto visit = [&](const int x, const int y) {
+            const uint8_t hit = isStopPixel(frame[y * width + x], cfg) ? 1 : 0;
+            mask[y * width + x] = static_cast<uint8_t>(-hit);
+            count += hit;
+            remaining--;
+        };
+
+        // Coarse pass over the decimated grid
+        for (int y = y0; y <= y1; y += factor) {
+            for (int x = x0; x <= x1; x += factor) {
+                visit(x, y);
+            }
+        }
+
+        // Fine pass over everything the coarse pass skipped, until the decision is settled either way
+        for (int y = y0; y <= y1 && count < needed && count + remaining >= needed; ++y) {
+            const bool sampledRow = (y - y0) % factor == 0;
+            for (int x = x0; x <= x1; ++x) {
+                if (sampledRow && (x - x0) % factor == 0) continue;
+                visit(x, y);
+            }
+        }
+
+        result.count = count;
+        result.percent = (count * 10000) / area;
+        result.detected = count >= needed;
+        return result;
+    }
+
+    inline BoxResult processRed(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                const Config& cfg)
+    {
+        if (cfg.COARSE_FACTOR > 1 && cfg.STOP_MORPHOLOGY == 0) return processRedCoarse(frame, width, height, mask, cfg);
+
+        std::fill(mask.begin(), mask.end(), 0);
+        uint16_t count = classifyBox(frame, width, height, mask, {cfg.STOPBOX_TL_X, cfg.STOPBOX_TL_Y}, {cfg.STOPBOX_BR_X, cfg.STOPBOX_BR_Y},
+                                     [&](uint16_t pixel) { return isStopPixel(pixel, cfg); });
+        if (cfg.STOP_MORPHOLOGY != 0) count = cleanStopMask(mask, width, height, cfg);
+        return boxResult(count, cfg.stopBoxArea(), cfg.PERCENT_TO_STOP);
+    }
+
+    /**
+     * @warning OBSTACLE AND CAR DETECTION IS CURRENTLY NOT WORKING OR USED (4/8/2025)
+     * @brief Process a frame for everything related to detecting obstacles or other cars
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame of all counted car pixels
+     * @param cfg - Thresholds to use
+     * @return BoxResult - The car pixel count and car decision
+     */
+    inline BoxResult processCar(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                const Config& cfg = DEFAULT_CONFIG)
+    {
+        std::fill(mask.begin(), mask.end(), 0);
+        uint16_t count = classifyBox(frame, width, height, mask, {cfg.CARBOX_TL_X, cfg.CARBOX_TL_Y}, {cfg.CARBOX_BR_X, cfg.CARBOX_BR_Y},
+                                     [&](uint16_t pixel) { return isCarPixel(pixel, cfg); });
+        return boxResult(count, cfg.carBoxArea(), cfg.PERCENT_TO_CAR);
+    }
+
+    /**
+     * @brief Classify the white line crop of a frame
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame. Everything outside the crop is cleared.
+     * @param cfg - Thresholds to use
+     * @return uint16_t - The number of white pixels
+     */
+    inline uint16_t classifyWhite(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                  const Config& cfg = DEFAULT_CONFIG)
+    {
+        std::fill(mask.begin(), mask.end(), 0);
+        return classifyBox(frame, width, height, mask, {0, cfg.WHITE_VERTICAL_CROP}, {cfg.WHITE_HORIZONTAL_CROP - 1, height - 1},
+                           [&](uint16_t pixel) { return isWhitePixel(pixel, cfg); });
+    }
+
+    namespace Detail {
+
+        // Neighbor offsets in Suzuki-Abe chain code order, counter clockwise starting to the right
+        constexpr int DX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+        constexpr int DY[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+        /**
+         * @brief Follow the outer border of the blob starting at its first raster pixel and return twice the
+         * area enclosed by the border. This is the same border OpenCV's findContours traces, so the area
+         * matches cv::contourArea on it exactly.
+         *
+         */
+        inline int32_t outerBorderArea2(const uint8_t* mask, const int width, const int height, const Point start)
+        {
+            auto isSet = [&](const int x, const int y) {
+                return x >= 0 && y >= 0 && x < width && y < height && mask[y * width + x] != 0;
+            };
+
+            // Search clockwise from the left neighbor for the first set pixel
+            int s = 4;
+            do {
+                s = (s - 1) & 7;
+            } while (!isSet(start.x + DX[s], start.y + DY[s]) && s != 4);
+
+            if (s == 4 && !isSet(start.x + DX[s], start.y + DY[s])) {
+                return 0;   // Single pixel blob
+            }
+
+            const Point first = {start.x + DX[s], start.y + DY[s]};
+            Point current = start;
+            int32_t area2 = 0;
+
+            for (;;) {
+                // Search counter clockwise from just past the direction we came from
+                for (int i = 0; i < 8; ++i) {
+                    s = (s + 1) & 7;
+                    if (isSet(current.x + DX[s], current.y + DY[s])) break;
+                }
+
+                const Point next = {current.x + DX[s], current.y + DY[s]};
+                area2 += current.x * next.y - next.x * current.y;
+
+                if (next == start && current == first) break;
+
+                current = next;
+                s = (s + 4) & 7;
+            }
+
+            return area2 < 0 ? -area2 : area2;
+        }
+
+        /**
+         * @brief Find the extreme points of a labelled blob inside its bounding box
+         *
+         */
+        inline void findExtremes(const uint16_t* labels, const int width, const uint16_t label,
+                                 const int xMin, const int xMax, const int yMin, const int yMax, Blob& blob)
+        {
+            auto isBlob = [&](const int x, const int y) { return labels[y * width + x] == label; };
+
+            int topMinX = xMax, topMaxX = xMin, bottomMinX = xMax, bottomMaxX = xMin;
+            for (int x = xMin; x <= xMax; ++x) {
+                if (isBlob(x, yMin)) { topMinX = std::min(topMinX, x); topMaxX = std::max(topMaxX, x); }
+                if (isBlob(x, yMax)) { bottomMinX = std::min(bottomMinX, x); bottomMaxX = std::max(bottomMaxX, x); }
+            }
+
+            int leftMinY = yMax, leftMaxY = yMin, rightMinY = yMax, rightMaxY = yMin;
+            for (int y = yMin; y <= yMax; ++y) {
+                if (isBlob(xMin, y)) { leftMinY = std::min(leftMinY, y); leftMaxY = std::max(leftMaxY, y); }
+                if (isBlob(xMax, y)) { rightMinY = std::min(rightMinY, y); rightMaxY = std::max(rightMaxY, y); }
+            }
+
+            blob.topLeft = {topMinX, yMin};
+            blob.topRight = {topMaxX, yMin};
+            blob.bottomLeft = {bottomMinX, yMax};
+            blob.leftTop = {xMin, leftMinY};
+            blob.leftBottom = {xMin, leftMaxY};
+            blob.rightTop = {xMax, rightMinY};
+
+            // The original implementation seeded these two from the first contour point instead of
+            // searching from scratch, so they only move off of it when a point is strictly further out
+            blob.bottomRight = bottomMaxX > blob.start.x ? Point{bottomMaxX, yMax} : blob.start;
+            blob.rightBottom = rightMaxY > blob.start.y ? Point{xMax, rightMaxY} : blob.start;
+        }
+
+    }
+
+    /**
+     * @brief Find the blob with the largest outer border area in a mask.
+     *
+     * Blobs are 8-connected, like the outer contours of cv::findContours. When two blobs have exactly the
+     * same area the one that starts last in raster order wins, which is the order OpenCV returns them in.
+     *
+     * @param mask - Binary mask, non-zero pixels are foreground
+     * @param width - Mask width
+     * @param height - Mask height
+     * @param ws - Scratch buffers
+     * @return Blob - The largest blob. found is false if the mask is empty or too large for the workspace.
+     */
+    inline Blob findLargestBlob(std::span<const uint8_t> mask, const int width, const int height, Workspace& ws)
+    {
+        Blob best;
+        if (width * height > static_cast<int>(MAX_PIXELS)) return best;
+
+        uint16_t* labels = ws.labels.data();
+        uint16_t* stack = ws.stack.data();
+        std::fill(labels, labels + width * height, 0);
+
+        uint16_t nextLabel = 1;
+        int bestXMin = 0, bestXMax = 0, bestYMin = 0, bestYMax = 0;
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const int idx = y * width + x;
+                if (mask[idx] == 0 || labels[idx] != 0) continue;
+
+                // Flood fill the 8-connected blob while tracking its bounding box
+                const uint16_t label = nextLabel++;
+                int xMin = x, xMax = x, yMin = y, yMax = y;
+                int top = 0;
+                stack[top++] = static_cast<uint16_t>(idx);
+                labels[idx] = label;
+
+                while (top > 0) {
+                    const int p = stack[--top];
+                    const int px = p % width, py = p / width;
+                    xMin = std::min(xMin, px); xMax = std::max(xMax, px);
+                    yMax = std::max(yMax, py);
+
+                    for (int n = 0; n < 8; ++n) {
+                        const int nx = px + Detail::DX[n], ny = py + Detail::DY[n];
+                        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+
+                        const int nidx = ny * width + nx;
+                        if (mask[nidx] != 0 && labels[nidx] == 0) {
+                            labels[nidx] = label;
+                            stack[top++] = static_cast<uint16_t>(nidx);
+                        }
+                    }
+                }
+
+                const int32_t area2 = Detail::outerBorderArea2(mask.data(), width, height, {x, y});
+                if (!best.found || area2 >= best.area2) {
+                    best.found = true;
+                    best.area2 = area2;
+                    best.start = {x, y};
+                    best.label = label;
+                    bestXMin = xMin; bestXMax = xMax; bestYMin = yMin; bestYMax = yMax;
+                }
+            }
+        }
+
+        if (best.found) {
+            Detail::findExtremes(labels, width, best.label, bestXMin, bestXMax, bestYMin, bestYMax, best);
+        }
+        return best;
+    }
+
+    /**
+     * @brief Fit the line along the left edge of the blob and measure where it crosses the crop line.
+     * Uses the same float arithmetic as the firmware so the distance matches it exactly.
+     *
+     * @param blob - The white line blob
+     * @param width - Frame width, used to clamp the distance
+     * @param cfg - Thresholds to use
+     * @return LineFit - The fitted line and distance
+     */
+    inline LineFit fitLine(const Blob& blob, const int width, const Config& cfg = DEFAULT_CONFIG)
+    {
+        LineFit fit;
+
+        const Point top = blob.leftTop;
+        const Point bottom = blob.bottomLeft;
+
+        fit.slope = (float)(bottom.y - top.y) / (bottom.x - top.x);
+        fit.yIntercept = top.y - fit.slope * top.x;
+
+        fit.intersection.y = cfg.WHITE_VERTICAL_CROP;
+        fit.intersection.x = (fit.intersection.y - fit.yIntercept) / fit.slope;
+
+        fit.rawDist = fit.intersection.x - cfg.WHITE_CENTER_POS;
+
+        const int maxDist = Params::CLAMP_CENTER_POS(width, cfg.WHITE_CENTER_POS);
+        fit.dist = fit.rawDist;
+        if (fit.dist > maxDist) fit.dist = maxDist;
+        if (fit.dist < -maxDist) fit.dist = -maxDist;
+
+        return fit;
+    }
+
+    /**
+     * @brief Process a frame for everything related to the white line
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame of all white pixels
+     * @param ws - Scratch buffers for blob analysis
+     * @param cfg - Thresholds to use
+     * @return WhiteResult - The blob, line, and whether the white line was detected
+     */
+    inline WhiteResult processWhite(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                    Workspace& ws, const Config& cfg = DEFAULT_CONFIG);
+
+    /**
+     * @brief Coarse-to-fine version of processWhite.
+     *
+     * Classifies every pixel of every COARSE_FACTOR-th row and column of the crop first, marks every tile
+     * with a white sample plus the tiles around it, and only classifies and analyses those tiles at full
+     * resolution. Falls back to the full scan when the coarse pass finds nothing, when the candidate tiles
+     * cover more than half of the crop, or when a white pixel touches the edge of the candidate tiles, since
+     * a blob could continue past it.
+     *
+     * A connected blob cannot cross a sampled row or column without a pixel on it, so a blob the grid misses
+     * lies inside one cell of (factor - 1) x (factor - 1) pixels and has a contour area of at most
+     * (factor - 2)^2. The factor is lowered until that is below WHITE_MIN_SIZE, so every blob that can be the
+     * white line is sampled and the decision and dist always match the full scan. The mask only covers the
+     * candidate tiles.
+     *
+     * @param frame - Canonical RGB565 frame
+     * @param width - Frame width
+     * @param height - Frame height
+     * @param mask - Output mask the size of the frame of the white pixels in the candidate tiles
+     * @param ws - Scratch buffers for blob analysis
+     * @param cfg - Thresholds to use. COARSE_FACTOR sets the decimation.
+     * @return WhiteResult - The blob, line, and whether the white line was detected
+     */
+    inline WhiteResult processWhiteCoarse(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                          Workspace& ws, const Config& cfg = DEFAULT_CONFIG)
+    {
+        Config fullCfg = cfg;
+        fullCfg.COARSE_FACTOR = 0;
+
+        // Largest factor whose grid cannot miss a blob of WHITE_MIN_SIZE
+        int factor = cfg.COARSE_FACTOR;
+        while (factor > 2 && (factor - 2) * (factor - 2) >= cfg.WHITE_MIN_SIZE) --factor;
+
+        const int x0 = 0, x1 = std::min<int>(cfg.WHITE_HORIZONTAL_CROP, width) - 1;
+        const int y0 = cfg.WHITE_VERTICAL_CROP, y1 = height - 1;
+        const int tilesX = (x1 - x0 + COARSE_TILE) / COARSE_TILE;
+        const int tilesY = (y1 - y0 + COARSE_TILE) / COARSE_TILE;
+        if (factor < 2 || (factor - 2) * (factor - 2) >= cfg.WHITE_MIN_SIZE || x1 < x0 || y1 < y0 ||
+            static_cast<uint32_t>(tilesX * tilesY) > MAX_TILES) {
+            return processWhite(frame, width, height, mask, ws, fullCfg);
+        }
+
+        // Coarse pass: bit 0 marks tiles with a white sample, bit 1 the candidate tiles around them
+        uint8_t* tiles = ws.tiles.data();
+        std::fill(tiles, tiles + tilesX * tilesY, 0);
+
+        bool anyWhite = false;
+        for (int y = y0; y <= y1; ++y) {
+            const uint16_t* row = frame.data() + y * width;
+            const int step = (y - y0) % factor == 0 ? 1 : factor;      // Whole sampled rows, every factor-th pixel between them
+            for (int x = x0; x <= x1; x += step) {
+                if (isWhitePixel(row[x], cfg)) {
+                    tiles[((y - y0) / COARSE_TILE) * tilesX + (x - x0) / COARSE_TILE] = 1;
+                    anyWhite = true;
+                }
+            }
+        }
+        if (!anyWhite) return processWhite(frame, width, height, mask, ws, fullCfg);
+
+        int candidates = 0;
+        for (int ty = 0; ty < tilesY; ++ty) {
+            for (int tx = 0; tx < tilesX; ++tx) {
+                bool near = false;
+                for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, tilesY - 1) && !near; ++ny) {
+                    for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, tilesX - 1) && !near; ++nx) {
+                        near = (tiles[ny * tilesX + nx] & 1) != 0;
+                    }
+                }
+                if (near) {
+                    tiles[ty * tilesX + tx] |= 2;
+                    candidates++;
+                }
+            }
+        }
+        if (candidates * 2 > tilesX * tilesY) return processWhite(frame, width, height, mask, ws, fullCfg);
+
+        // Fine pass over the candidate tiles only
+        std::fill(mask.begin(), mask.end(), 0);
+        for (int ty = 0; ty < tilesY; ++ty) {
+            for (int tx = 0; tx < tilesX; ++tx) {
+                if ((tiles[ty * tilesX + tx] & 2) == 0) continue;
+
+                const Point tl = {x0 + tx * COARSE_TILE, y0 + ty * COARSE_TILE};
+                const Point br = {std::min(tl.x + COARSE_TILE - 1, x1), std::min(tl.y + COARSE_TILE - 1, y1)};
+                classifyBox(frame, width, height, mask, tl, br, [&](uint16_t pixel) { return isWhitePixel(pixel, cfg); });
+            }
+        }
+
+        // A white pixel next to a tile that was never classified means a blob may have been cut off
+        auto isCandidate = [&](const int x, const int y) {
+            if (x < x0 || x > x1 || y < y0 || y > y1) return true;     // Outside the crop is always empty
+            return (tiles[((y - y0) / COARSE_TILE) * tilesX + (x - x0) / COARSE_TILE] & 2) != 0;
+        };
+        for (int y = y0; y <= y1; ++y) {
+            const uint8_t* maskRow = mask.data() + y * width;
+            const bool edgeRow = (y - y0) % COARSE_TILE == 0 || (y - y0) % COARSE_TILE == COARSE_TILE - 1;
+
+            for (int x = x0; x <= x1; ++x) {
+                const bool edgeCol = (x - x0) % COARSE_TILE == 0 || (x - x0) % COARSE_TILE == COARSE_TILE - 1;
+                if (maskRow[x] == 0 || !(edgeRow || edgeCol)) continue;
+
+                for (int n = 0; n < 8; ++n) {
+                    if (!isCandidate(x + Detail::DX[n], y + Detail::DY[n])) {
+                        return processWhite(frame, width, height, mask, ws, fullCfg);
+                    }
+                }
+            }
+        }
+
+        WhiteResult result;
+        result.refined = true;
+        result.blob = findLargestBlob(mask, width, height, ws);
+        if (!result.blob.found || result.blob.area2 < 2 * cfg.WHITE_MIN_SIZE) {
+            return result;
+        }
+
+        result.line = fitLine(result.blob, width, cfg);
+        result.detected = true;
+        return result;
+    }
+
+    inline WhiteResult processWhite(std::span<const uint16_t> frame, const int width, const int height, std::span<uint8_t> mask,
+                                    Workspace& ws, const Config& cfg)
+    {
+        if (cfg.COARSE_FACTOR > 1 && cfg.WHITE_MORPHOLOGY == 0) return processWhiteCoarse(frame, width, height, mask, ws, cfg);
+
+        WhiteResult result;
+
+        classifyWhite(frame, width, height, mask, cfg);
+        if (cfg.WHITE_MORPHOLOGY != 0) cleanWhiteMask(mask, width, height, cfg);
+
+        result.blob = findLargestBlob(mask, width, height, ws);
+        if (!result.blob.found || result.blob.area2 < 2 * cfg.WHITE_MIN_SIZE) {
+            return result;
+        }
+
+        result.line = fitLine(result.blob, width, cfg);
+        result.detected = true;
+        return result;
+    }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "microcv2.hpp"
+
+/**
+ * @brief Frozen scalar reference implementations of the MicroCV2 detectors.
+ * 
+ * These match the ESP32 firmware bit for bit and are the oracles that every optimized variant of the
+ * MicroCV2 detectors is checked against by the MicroCV2Diff harness. Nothing in the viewer uses them.
+ */
+namespace MicroCV2::Reference {
+
+    /**
+     * @brief Reference version of MicroCV2::RGB565toRGB888
+     * 
+     * @param pixel - The 16-bit RGB565 pixel
+     * @param red - The red value output
+     * @param green - The green value output
+     * @param blue - The blue value output
+     */
+    void RGB565toRGB888(const uint16_t pixel, uint16_t& red, uint16_t& green, uint16_t& blue);
+
+    /**
+     * @brief Reference version of MicroCV2::isStopLine
+     * 
+     * @param red
+     * @param green 
+     * @param blue 
+     */
+    bool isStopLine(const uint16_t red, const uint16_t green, const uint16_t blue);
+
+    /**
+     * @brief Reference version of MicroCV2::isWhiteLine
+     * 
+     * @param red 
+     * @param green 
+     * @param blue 
+     */
+    bool isWhiteLine(const uint16_t red, const uint16_t green, const uint16_t blue);
+
+    /**
+     * @brief Reference version of MicroCV2::processRedImg
+     * 
+     * @param img - Input CV_8UC2 image with each pixel stored high byte first
+     * @param mask - Output mask of all red pixels
+     * @return Whether the stop line was detected or not
+     */
+    bool processRedImg(const cv::Mat& img, cv::Mat1b& mask);
+
+    /**
+     * @brief Reference version of MicroCV2::processCarImg
+     * 
+     * @param img - Input CV_8UC2 image. Unlike the other detectors this reads each pixel as a native uint16_t.
+     * @param mask - Output mask of all obstacle pixels
+     * @return Whether an obstacle was detected or not
+     */
+    bool processCarImg(const cv::Mat& img, cv::Mat1b& mask);
+
+    /**
+     * @brief Reference version of MicroCV2::processWhiteImg
+     * 
+     * @param img - Input CV_8UC2 image with each pixel stored high byte first
+     * @param mask - Output mask of all white pixels
+     * @param centerLine - Additional output mask showing other reference lines and points
+     * @param dist - The reported distance to the white line
+     * @return Whether the white line was detected or not
+     */
+    bool processWhiteImg(const cv::Mat& img, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist);
+
+}
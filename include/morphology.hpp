@@ -0,0 +1,286 @@
+#pragma once
+
+#include "params.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <span>
+#include <stdint.h>
+#include <string_view>
+
+/**
+ * @brief Bit-parallel binary morphology for the detector masks.
+ *
+ * A region of a byte mask is packed into one bit per pixel, 64 pixels to a word, so a 96 pixel row is two
+ * words. Eroding or dilating with a 3x3 structuring element is then a handful of word shifts and ANDs or
+ * ORs per row instead of nine byte reads per pixel. Like OpenCV's defaults, pixels outside the region
+ * never grow into it when dilating and never eat into it when eroding.
+ *
+ * Standard library only, so it can be compiled into the firmware with the rest of MicroCV2::Core.
+ */
+namespace MicroCV2::Morph {
+
+    enum class Op : uint8_t {
+        NONE,
+        ERODE,
+        DILATE,
+        OPEN,       ///< Erode then dilate. Removes specks smaller than the structuring element.
+        CLOSE       ///< Dilate then erode. Fills pinholes and thin gaps.
+    };
+
+    enum class Shape : uint8_t {
+        CROSS,      ///< The pixel and its 4 neighbours
+        SQUARE      ///< The pixel and its 8 neighbours
+    };
+
+    constexpr int MAX_WORDS = (IMG_COLS + 63) / 64;
+
+    /**
+     * @brief A region of a mask with one bit per pixel. Bit x % 64 of word x / 64 of a row is column x.
+     *
+     */
+    struct BitMask {
+        int width = 0;
+        int height = 0;
+        int words = 0;              ///< Words per row
+        std::array<uint64_t, IMG_ROWS * MAX_WORDS> bits;
+
+        uint64_t* row(const int y) { return bits.data() + y * words; }
+        const uint64_t* row(const int y) const { return bits.data() + y * words; }
+    };
+
+    /**
+     * @brief Parse an operation name: none, erode, dilate, open, or close
+     *
+     * @return true - If the name was recognised
+     */
+    constexpr bool parseOp(std::string_view name, Op& op)
+    {
+        constexpr std::string_view NAMES[] = {"none", "erode", "dilate", "open", "close"};
+        for (size_t i = 0; i < std::size(NAMES); ++i) {
+            if (name == NAMES[i]) {
+                op = static_cast<Op>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Parse a structuring element name: cross or square
+     *
+     * @return true - If the name was recognised
+     */
+    constexpr bool parseShape(std::string_view name, Shape& shape)
+    {
+        if (name == "cross") shape = Shape::CROSS;
+        else if (name == "square") shape = Shape::SQUARE;
+        else return false;
+        return true;
+    }
+
+    namespace Detail {
+
+        /**
+         * @brief Bits of the last word of a row that lie inside the region
+         *
+         */
+        constexpr uint64_t lastWordMask(const int width)
+        {
+            return width % 64 == 0 ? ~0ULL : (1ULL << (width % 64)) - 1;
+        }
+
+        template <bool ERODE>
+        void apply(const BitMask& in, BitMask& out, const Shape shape)
+        {
+            const int words = in.words;
+            const uint64_t fill = ERODE ? ~0ULL : 0;
+            const uint64_t lastMask = lastWordMask(in.width);
+
+            out.width = in.width;
+            out.height = in.height;
+            out.words = words;
+
+            // Copy the rows between a border of fill words and rows, with the bits past the region's right edge
+            // set to fill too, so the loop below needs no edge cases
+            constexpr int STRIDE = MAX_WORDS + 2;
+            uint64_t padded[(IMG_ROWS + 2) * STRIDE];
+            std::fill(padded, padded + (in.height + 2) * STRIDE, fill);
+            for (int y = 0; y < in.height; ++y) {
+                uint64_t* row = padded + (y + 1) * STRIDE + 1;
+                std::copy(in.row(y), in.row(y) + words, row);
+                row[words - 1] = (row[words - 1] & lastMask) | (fill & ~lastMask);
+            }
+
+            auto combine = [](const uint64_t a, const uint64_t b) { return ERODE ? (a & b) : (a | b); };
+            auto spread = [&](const uint64_t* row, const int k) {
+                const uint64_t left = (row[k] << 1) | (row[k - 1] >> 63);
+                const uint64_t right = (row[k] >> 1) | (row[k + 1] << 63);
+                return combine(row[k], combine(left, right));
+            };
+
+            for (int y = 0; y < in.height; ++y) {
+                const uint64_t* above = padded + y * STRIDE + 1;
+                const uint64_t* middle = above + STRIDE;
+                const uint64_t* below = middle + STRIDE;
+                uint64_t* result = out.row(y);
+
+                for (int k = 0; k < words; ++k) {
+                    const uint64_t vertical = shape == Shape::SQUARE ? combine(spread(above, k), spread(below, k))
+                                                                     : combine(above[k], below[k]);
+                    result[k] = combine(spread(middle, k), vertical);
+                }
+                result[words - 1] &= lastMask;
+            }
+        }
+
+        /**
+         * @brief The 8 mask bytes of every 8 bit pattern, 0xFF where the bit is set
+         *
+         */
+        constexpr std::array<uint64_t, 256> BYTE_LANES = [] {
+            std::array<uint64_t, 256> lanes{};
+            for (int bits = 0; bits < 256; ++bits) {
+                for (int i = 0; i < 8; ++i) {
+                    if (bits & (1 << i)) {
+                        const int lane = std::endian::native == std::endian::little ? i : 7 - i;
+                        lanes[bits] |= 0xFFULL << (8 * lane);
+                    }
+                }
+            }
+            return lanes;
+        }();
+
+    }
+
+    /**
+     * @brief Pack an inclusive box of a byte mask into a bit mask. Bytes with their top bit set are set,
+     * which covers the 255 every classifier writes.
+     *
+     * @param mask - The byte mask, width x height
+     * @param width - Mask width
+     * @param height - Mask height
+     * @param x0, y0, x1, y1 - The inclusive box, clamped to the mask. At most IMG_ROWS x IMG_COLS.
+     * @param out - Output bit mask the size of the box
+     */
+    inline void pack(std::span<const uint8_t> mask, const int width, const int height, int x0, int y0, int x1, int y1, BitMask& out)
+    {
+        x0 = std::max(x0, 0); x1 = std::min({x1, width - 1, x0 + IMG_COLS - 1});
+        y0 = std::max(y0, 0); y1 = std::min({y1, height - 1, y0 + IMG_ROWS - 1});
+
+        out.width = std::max(x1 - x0 + 1, 0);
+        out.height = std::max(y1 - y0 + 1, 0);
+        out.words = std::max((out.width + 63) / 64, 1);
+
+        for (int y = 0; y < out.height; ++y) {
+            const uint8_t* src = mask.data() + (y0 + y) * width + x0;
+            uint64_t* row = out.row(y);
+            std::fill(row, row + out.words, 0);
+
+            // Gather 8 bytes at a time: one multiply moves the top bit of byte i to bit 56 + i
+            int x = 0;
+            for (; x + 8 <= out.width; x += 8) {
+                uint64_t bytes;
+                std::memcpy(&bytes, src + x, sizeof(bytes));
+                if constexpr (std::endian::native == std::endian::big) bytes = std::byteswap(bytes);
+                row[x / 64] |= (((bytes & 0x8080808080808080ULL) * 0x0002040810204081ULL) >> 56) << (x % 64);
+            }
+            for (; x < out.width; ++x) {
+                row[x / 64] |= static_cast<uint64_t>(src[x] >> 7) << (x % 64);
+            }
+        }
+    }
+
+    /**
+     * @brief Write a bit mask back into an inclusive box of a byte mask as 255 and 0
+     *
+     * @param in - The bit mask, the size of the box
+     * @param mask - The byte mask, width x height
+     * @param width - Mask width
+     * @param x0, y0 - Top left corner of the box
+     */
+    inline void unpack(const BitMask& in, std::span<uint8_t> mask, const int width, int x0, int y0)
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+
+        for (int y = 0; y < in.height; ++y) {
+            uint8_t* dst = mask.data() + (y0 + y) * width + x0;
+            const uint64_t* row = in.row(y);
+
+            int x = 0;
+            for (; x + 8 <= in.width; x += 8) {
+                const uint64_t bytes = Detail::BYTE_LANES[(row[x / 64] >> (x % 64)) & 0xFF];
+                std::memcpy(dst + x, &bytes, sizeof(bytes));
+            }
+            for (; x < in.width; ++x) {
+                dst[x] = static_cast<uint8_t>(-static_cast<int>((row[x / 64] >> (x % 64)) & 1));
+            }
+        }
+    }
+
+    /**
+     * @brief Erode a bit mask with a 3x3 structuring element
+     *
+     */
+    inline void erode(const BitMask& in, BitMask& out, const Shape shape = Shape::CROSS)
+    {
+        Detail::apply<true>(in, out, shape);
+    }
+
+    /**
+     * @brief Dilate a bit mask with a 3x3 structuring element
+     *
+     */
+    inline void dilate(const BitMask& in, BitMask& out, const Shape shape = Shape::CROSS)
+    {
+        Detail::apply<false>(in, out, shape);
+    }
+
+    /**
+     * @brief Count the set pixels of a bit mask
+     *
+     */
+    inline uint32_t count(const BitMask& in)
+    {
+        uint32_t total = 0;
+        for (int i = 0; i < in.height * in.words; ++i) {
+            total += std::popcount(in.bits[i]);
+        }
+        return total;
+    }
+
+    /**
+     * @brief Run a morphological operation on an inclusive box of a byte mask in place
+     *
+     * @param mask - The byte mask, width x height. Pixels outside the box are not touched.
+     * @param width - Mask width
+     * @param height - Mask height
+     * @param x0, y0, x1, y1 - The inclusive box
+     * @param op - The operation
+     * @param shape - The structuring element
+     * @return uint32_t - The number of set pixels in the box afterwards
+     */
+    inline uint32_t apply(std::span<uint8_t> mask, const int width, const int height, const int x0, const int y0, const int x1,
+                          const int y1, const Op op, const Shape shape = Shape::CROSS)
+    {
+        BitMask a, b;
+        pack(mask, width, height, x0, y0, x1, y1, a);
+
+        const BitMask* result = &b;
+        switch (op) {
+            case Op::NONE: return count(a);
+            case Op::ERODE: erode(a, b, shape); break;
+            case Op::DILATE: dilate(a, b, shape); break;
+            case Op::OPEN: erode(a, b, shape); dilate(b, a, shape); result = &a; break;
+            case Op::CLOSE: dilate(a, b, shape); erode(b, a, shape); result = &a; break;
+            default: return count(a);
+        }
+
+        unpack(*result, mask, width, x0, y0);
+        return count(*result);
+    }
+
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <stdint.h>
-#include "opencv2.hpp"
 
 // Constants used throughout the code
 constexpr uint8_t IMG_ROWS = 96;    // 96 rows in each image
@@ -38,8 +37,6 @@ constexpr uint8_t PERCENT_TO_STOP       = 20;          ///< Percentage of the st
 constexpr uint8_t STOP_GREEN_TOLERANCE  = 15;          ///< How much more red than green must a pixel be to be "red"
 constexpr uint8_t STOP_BLUE_TOLERANCE   = 20;          ///< How much more red than blue must a pixel be to be "blue"
 
-const cv::Point2i STOPBOX_TL(STOPBOX_TL_X,STOPBOX_TL_Y);
-const cv::Point2i STOPBOX_BR(STOPBOX_BR_X,STOPBOX_BR_Y);
 constexpr uint16_t STOPBOX_AREA = BOX_AREA(STOPBOX_TL_X, STOPBOX_TL_Y, STOPBOX_BR_X, STOPBOX_BR_Y);
 
 
@@ -62,8 +59,6 @@ constexpr uint8_t CARBOX_TL_Y           = 50;
 constexpr uint8_t CARBOX_BR_X           = 15;
 constexpr uint8_t CARBOX_BR_Y           = 70;
 
-const cv::Point2i CARBOX_TL(CARBOX_TL_X,CARBOX_TL_Y);
-const cv::Point2i CARBOX_BR(CARBOX_BR_X,CARBOX_BR_Y);
 constexpr uint16_t CARBOX_AREA = BOX_AREA(CARBOX_TL_X, CARBOX_TL_Y, CARBOX_BR_X, CARBOX_BR_Y);
 
 constexpr uint8_t PERCENT_TO_CAR        = 8;
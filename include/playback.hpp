@@ -0,0 +1,165 @@
+#pragma once
+
+#include "opencv2.hpp"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Namespace for reviewing captures as a time-ordered sequence.
+ *
+ * A Prefetcher decodes, processes and composites the frames around a playhead on a background thread,
+ * into a fixed number of slots, so the viewer only ever copies finished images to the screen. Most of the
+ * slots go to the frames ahead of the playhead in the direction of playback and the rest to the frames
+ * just behind it, so stepping back or reversing is also instant. Memory use depends only on the number of
+ * slots, never on the length of the sequence.
+ */
+namespace Playback {
+
+    constexpr size_t DEFAULT_CAPACITY = 128;
+    constexpr int MIN_FPS = 1;
+    constexpr int MAX_FPS = 240;
+
+    /**
+     * @brief A capture file and its format
+     *
+     */
+    struct Entry {
+        std::string filename;
+        bool compactHex = true;     ///< Compact hex format if true, raw binary otherwise
+    };
+
+    /**
+     * @brief A frame ready to show
+     *
+     */
+    struct Frame {
+        size_t index = 0;           ///< Position of the frame in the sequence
+        bool loaded = false;        ///< False if the file could not be read, in which case composite is empty
+        cv::Mat composite;          ///< The original and the detector overlay side by side, CV_8UC3 in RGB order
+        bool stop = false;
+        bool white = false;
+        int8_t dist = 0;
+    };
+
+    /**
+     * @brief Counts of how well the prefetcher kept ahead of the playhead
+     *
+     */
+    struct Stats {
+        uint64_t hits = 0;          ///< Frames that were ready when they were asked for
+        uint64_t misses = 0;        ///< Frames that were not ready the first time they were asked for
+        uint64_t decoded = 0;       ///< Frames the background thread prepared
+        uint64_t discarded = 0;     ///< Prepared frames that had left the window by the time they were done
+    };
+
+    /**
+     * @brief Check whether one capture file was taken before another
+     *
+     * Compares the file names without their directories, with runs of digits compared as numbers, so the
+     * timestamps the serial monitor writes (compact_hex_20250320_161731.bin) and the counters the SD card
+     * program writes (IMAGE9.BIN before IMAGE10.BIN) both sort in capture order.
+     *
+     * @return true - If a sorts before b
+     */
+    bool capturedBefore(const std::string& a, const std::string& b);
+
+    /**
+     * @brief Sort capture files into capture order
+     *
+     */
+    void sortByCaptureTime(std::vector<Entry>& entries);
+
+    /**
+     * @brief Load one capture and run the detectors on it
+     *
+     * @param entry - The capture file
+     * @param index - Position of the frame in the sequence
+     * @return Frame - The composited frame
+     */
+    Frame renderFrame(const Entry& entry, size_t index);
+
+    /**
+     * @brief Prepares the frames around a playhead in the background
+     *
+     */
+    class Prefetcher {
+    public:
+        /**
+         * @brief Start the background thread
+         *
+         * @param entries - The sequence, in playback order
+         * @param capacity - Number of frames to keep prepared
+         */
+        explicit Prefetcher(std::vector<Entry> entries, size_t capacity = DEFAULT_CAPACITY);
+        ~Prefetcher();
+        Prefetcher(const Prefetcher&) = delete;
+        Prefetcher& operator=(const Prefetcher&) = delete;
+
+        /**
+         * @brief Move the playhead, which moves the window of frames to prepare
+         *
+         * @param index - The frame being shown
+         * @param direction - 1 when playing forwards, -1 when playing backwards
+         */
+        void seek(size_t index, int direction = 1);
+
+        /**
+         * @brief Get a frame if it is ready. Never waits for the background thread. Asking for the same frame
+         * again while it is not ready does not count another miss, so callers can poll.
+         *
+         * @param index - Position of the frame in the sequence
+         * @return std::shared_ptr<const Frame> - The frame, or nullptr if it is not ready yet
+         */
+        std::shared_ptr<const Frame> get(size_t index);
+
+        size_t size() const { return m_entries.size(); }
+        size_t capacity() const { return m_slots.size(); }
+        const Entry& entry(size_t index) const { return m_entries[index]; }
+
+        /**
+         * @brief Number of frames in the window that are ready
+         *
+         */
+        size_t ready() const;
+
+        Stats stats() const;
+
+    private:
+        /**
+         * @brief Find the frame in the window closest to the playhead that is not ready. Needs m_mutex.
+         *
+         * @param index - The frame to prepare
+         * @return true - If there is one
+         */
+        bool nextMissing(size_t& index) const;
+
+        /**
+         * @brief Check whether a frame is in the window around the playhead. Needs m_mutex.
+         *
+         */
+        bool inWindow(size_t index) const;
+
+        void run();
+
+        std::vector<Entry> m_entries;
+        std::vector<std::shared_ptr<const Frame>> m_slots;  ///< Frame i lives in slot i % capacity
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        size_t m_playhead = 0;
+        int m_direction = 1;
+        bool m_stopping = false;
+        Stats m_stats;
+        size_t m_missed = SIZE_MAX;     ///< The frame the last miss was counted for
+
+        std::thread m_thread;
+    };
+
+}
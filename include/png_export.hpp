@@ -0,0 +1,109 @@
+#pragma once
+
+#include "opencv2.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Namespace for exporting loaded frames as PNGs off of the loading and processing path
+ *
+ */
+namespace Export {
+
+    /**
+     * @brief Counts of what the exporter has done so far
+     *
+     */
+    struct ExportStats {
+        uint64_t queued = 0;    ///< Frames handed to the exporter
+        uint64_t written = 0;   ///< PNGs converted and written
+        uint64_t skipped = 0;   ///< PNGs that were already newer than their source
+        uint64_t failed = 0;    ///< PNGs that could not be written
+    };
+
+    /**
+     * @brief Worker pool that converts RGB565 frames to RGB888 and writes them as PNGs in the background.
+     *
+     * A PNG is skipped when it already exists and was modified no earlier than the file it was loaded
+     * from, so unchanged captures are never re-encoded. Enqueuing never blocks on the workers.
+     */
+    class PngExporter {
+    public:
+        /**
+         * @brief Start the worker pool
+         *
+         * @param numThreads - Number of encoding threads. Uses all hardware threads if 0.
+         */
+        explicit PngExporter(unsigned int numThreads = 0);
+
+        /**
+         * @brief Finish every queued export and stop the workers
+         *
+         */
+        ~PngExporter();
+
+        PngExporter(const PngExporter&) = delete;
+        PngExporter& operator=(const PngExporter&) = delete;
+
+        /**
+         * @brief Queue a frame to be written as a PNG
+         *
+         * @param source - The file the frame was loaded from. Used for the up-to-date check.
+         * @param destination - The PNG filepath to write
+         * @param rgb565_image - The canonical CV_16UC1 RGB565 frame. Shares the buffer, so it must not be modified afterwards.
+         */
+        void enqueue(const std::string& source, const std::string& destination, const cv::Mat& rgb565_image);
+
+        /**
+         * @brief Block until every queued export has finished
+         *
+         */
+        void wait();
+
+        /**
+         * @brief Get a snapshot of the export counts
+         *
+         * @return ExportStats - The counts
+         */
+        ExportStats stats() const;
+
+        /**
+         * @brief Check whether a PNG exists and is at least as new as the file it was generated from
+         *
+         * @param source - The source filepath
+         * @param destination - The PNG filepath
+         * @return true - If the PNG does not need to be written again
+         */
+        static bool isUpToDate(const std::string& source, const std::string& destination);
+
+    private:
+        struct Job {
+            std::string source;
+            std::string destination;
+            cv::Mat image;
+        };
+
+        void workerLoop();
+        void exportImage(const Job& job);
+
+        std::vector<std::thread> m_workers;
+        std::deque<Job> m_jobs;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_jobAvailable;
+        std::condition_variable m_idle;
+        size_t m_active = 0;
+        bool m_stopping = false;
+
+        std::atomic<uint64_t> m_queued = 0;
+        std::atomic<uint64_t> m_written = 0;
+        std::atomic<uint64_t> m_skipped = 0;
+        std::atomic<uint64_t> m_failed = 0;
+    };
+
+}
@@ -6,11 +6,14 @@
 #include <QGridLayout>
 #include <QPixmap>
 #include <QImage>
+#include <QTimer>
 
 #include <span>
 #include <vector>
 
+#include "frame_ring.hpp"
 #include "opencv2.hpp"
+#include "playback.hpp"
 
 /**
  * @brief Namespace for dealing with the QT5 framework
@@ -42,6 +45,26 @@ namespace QT5 {
      */
     std::vector<QImage> matToQImage(std::span<const cv::Mat1b> mats);
 
+    /**
+     * @brief Wrap a canonical RGB565 frame from MicroCV2::Core in a QImage without converting it
+     * 
+     * @param frame - The native-endian RGB565 pixels
+     * @param width - The frame width
+     * @param height - The frame height
+     * @return QImage - A deep copy of the frame as Format_RGB16
+     */
+    QImage frameToQImage(std::span<const uint16_t> frame, int width, int height);
+
+    /**
+     * @brief Wrap a mask from MicroCV2::Core in a grayscale QImage
+     * 
+     * @param mask - The mask pixels
+     * @param width - The mask width
+     * @param height - The mask height
+     * @return QImage - A deep copy of the mask as Format_Grayscale8
+     */
+    QImage maskToQImage(std::span<const uint8_t> mask, int width, int height);
+
     /**
      * @brief Create a QLabel from a QImage
      * 
@@ -62,6 +85,34 @@ namespace QT5 {
     void showImageWindows(int argc, char *argv[], const std::span<cv::Mat>& originalImages, 
         const std::span<cv::Mat>& processedImages, const std::span<std::string>& filenames);
 
+    /**
+     * @brief Show the newest frame of a shared memory frame ring in a window, with its detection results
+     * 
+     * The window polls the ring at the display rate and skips straight to the newest frame, so a slow
+     * window never holds up the producer or the other consumers.
+     * 
+     * @param argc - Taken from main function arguments
+     * @param argv - Taken from main function arguments
+     * @param consumer - An open consumer of the ring
+     * @return int - The exit code of the Qt event loop
+     */
+    int showRingWindow(int argc, char *argv[], FrameRing::Consumer& consumer);
+
+    /**
+     * @brief Play a sequence of captures back in a window, with play/pause, stepping, a scrub bar and a frame rate
+     * 
+     * Frames come from the prefetcher, so the window only copies finished images to the screen. If the
+     * next frame is not ready in time the current one stays up and the stall is counted, rather than the
+     * window waiting or skipping frames. Space plays and pauses, and the arrow keys step.
+     * 
+     * @param argc - Taken from main function arguments
+     * @param argv - Taken from main function arguments
+     * @param prefetcher - The prefetcher of the sequence
+     * @param fps - The starting frame rate, clamped to Playback::MIN_FPS to Playback::MAX_FPS
+     * @return int - The exit code of the Qt event loop
+     */
+    int showPlaybackWindow(int argc, char *argv[], Playback::Prefetcher& prefetcher, int fps = 30);
+
 
 }
 
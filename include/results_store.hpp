@@ -0,0 +1,165 @@
+#pragma once
+
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Namespace for the memory-mapped columnar store of detection results.
+ *
+ * A store file is a header followed by chunks. Every append writes one chunk holding the rows of that
+ * append, one fixed-width column after another, followed by the string table its source column indexes
+ * into. The columns are 8 byte aligned, so once the file is mapped a query reads them in place without
+ * parsing or copying anything. Frame ids keep counting up across appends. The file uses the byte order
+ * of the machine that wrote it, which is little-endian on every supported platform.
+ *
+ * Appends are not atomic, but a chunk that was cut short by a crash is dropped with a warning on open.
+ * Only one process may append to a store at a time.
+ */
+namespace Results {
+
+    constexpr char STORE_MAGIC[8] = {'E', 'S', 'P', 'R', 'S', 'L', 'T', '1'};
+
+    /**
+     * @brief One row to append to a store
+     *
+     */
+    struct Record {
+        std::string_view source;    ///< The file the frame was loaded from
+        bool stop = false;          ///< processRedImg result
+        bool white = false;         ///< processWhiteImg result
+        int8_t dist = 0;            ///< Distance reported by processWhiteImg, 0 if no line was found
+        uint16_t redPercent = 0;    ///< Percentage of the stop box that was red, times 100
+        float blobArea = 0;         ///< Area of the largest white blob, 0 if there was none
+    };
+
+    /**
+     * @brief Header at the start of every chunk
+     *
+     */
+    struct ChunkHeader {
+        uint32_t rows;
+        uint32_t strings;           ///< Number of entries in the string table
+        uint32_t stringBytes;       ///< Total length of the strings in the string table
+        uint32_t reserved;
+        uint64_t firstFrame;        ///< Frame id of the first row
+        uint64_t size;              ///< Size of the chunk including this header, a multiple of 8
+    };
+
+    /**
+     * @brief Read-only views of the columns of one chunk, pointing into the mapped file
+     *
+     */
+    struct Chunk {
+        std::span<const uint64_t> frameIds;
+        std::span<const uint32_t> sources;      ///< Index into this chunk's string table
+        std::span<const uint8_t> stops;
+        std::span<const uint8_t> whites;
+        std::span<const int8_t> dists;
+        std::span<const uint16_t> redPercents;
+        std::span<const float> blobAreas;
+        std::span<const uint32_t> stringOffsets;    ///< strings + 1 offsets into stringData
+        const char* stringData = nullptr;
+
+        size_t size() const { return frameIds.size(); }
+
+        /**
+         * @brief Get the source file of a row
+         *
+         */
+        std::string_view source(size_t row) const
+        {
+            const uint32_t index = sources[row];
+            return {stringData + stringOffsets[index], stringOffsets[index + 1] - stringOffsets[index]};
+        }
+    };
+
+    /**
+     * @brief A read-only memory mapping of a whole file
+     *
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * @brief Map a file, replacing any previous mapping
+         *
+         * @param filename - The path of the file
+         * @return true - If the file was mapped. Empty files map to a null pointer and a size of 0.
+         */
+        bool open(const std::string& filename);
+
+        /**
+         * @brief Unmap the file
+         *
+         */
+        void close();
+
+        const uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        void* m_mapping = nullptr;      ///< File mapping handle on Windows, unused elsewhere
+    };
+
+    /**
+     * @brief A store file opened for queries
+     *
+     */
+    class Reader {
+    public:
+        /**
+         * @brief Map a store file and locate every chunk in it
+         *
+         * @param filename - The path of the store file
+         * @return true - If the file is a store. A truncated last chunk is dropped with a warning, while a
+         * chunk whose header or string table is inconsistent makes the whole file fail to open.
+         */
+        bool open(const std::string& filename);
+
+        /**
+         * @brief Get every complete chunk in the file, in the order they were appended
+         *
+         */
+        const std::vector<Chunk>& chunks() const { return m_chunks; }
+
+        /**
+         * @brief Get the total number of rows in every chunk
+         *
+         */
+        uint64_t rows() const { return m_rows; }
+
+        /**
+         * @brief Get the size of the valid part of the file, where the next chunk will be appended
+         *
+         */
+        uint64_t validBytes() const { return m_validBytes; }
+
+    private:
+        MappedFile m_file;
+        std::vector<Chunk> m_chunks;
+        uint64_t m_rows = 0;
+        uint64_t m_validBytes = 0;
+    };
+
+    /**
+     * @brief Append rows to a store as a new chunk, creating the store if it does not exist
+     *
+     * @param filename - The path of the store file
+     * @param records - The rows to append
+     * @return true - If the chunk was written
+     */
+    bool append(const std::string& filename, std::span<const Record> records);
+
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "frame_batch.hpp"
+#include "microcv2_core.hpp"
+
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Namespace for tuning detector parameters against labeled frames.
+ *
+ * A search space lists candidate values for some of the Core::Config fields. Every combination of a grid,
+ * or a number of random draws from it, is scored on a labeled dataset by how many frames get the wrong
+ * stop flag or the wrong dist. The frames are decoded once into memory and shared by every worker thread.
+ *
+ * Two things keep a sweep fast. First, a combination is abandoned as soon as its errors so far exceed the
+ * errors of the current top results, since errors only grow as more frames are scored. Second, the stop
+ * detector only depends on some of the parameters and the white line detector on others, so each
+ * detector's score is remembered per combination of the parameters it depends on. Combinations that only
+ * differ in white line parameters share one run of the stop detector, and the other way round. The
+ * detectors run on batches of frames, classifying the same pixel of every frame of a batch together.
+ *
+ * A search space file has one parameter per line, its name followed by its values:
+ *   STOP_GREEN_TOLERANCE 5:40:5     # 5 to 40 in steps of 5
+ *   WHITE_RED_THRESH 220,230,240    # a list
+ *   WHITE_MORPHOLOGY none,open      # morphology names are allowed for the morphology fields
+ */
+namespace Sweep {
+
+    /**
+     * @brief The values to try for one Core::Config field
+     *
+     */
+    struct Parameter {
+        std::string name;
+        std::vector<int> values;
+    };
+
+    /**
+     * @brief The parameters to tune. Fields that are not listed keep their value from the base config.
+     *
+     */
+    struct Space {
+        std::vector<Parameter> parameters;
+
+        /**
+         * @brief Number of combinations in the full grid, saturating at UINT64_MAX
+         *
+         */
+        uint64_t gridSize() const;
+    };
+
+    /**
+     * @brief The expected output for one frame
+     *
+     */
+    struct Label {
+        std::string file;
+        bool stop = false;
+        int8_t dist = 0;            ///< 0 if the frame has no white line
+    };
+
+    constexpr size_t BATCH_LANES = 16;     ///< Frames scored together by the batch detectors
+
+    /**
+     * @brief Labeled frames decoded into memory, stored as frame batches so the detectors can score
+     * BATCH_LANES frames in one sweep
+     *
+     */
+    struct Dataset {
+        std::vector<Label> labels;
+        std::vector<MicroCV2::Core::FrameBatch<BATCH_LANES>> batches;  ///< Frame i is lane i % BATCH_LANES of batch i / BATCH_LANES
+
+        size_t size() const { return labels.size(); }
+        size_t bytes() const { return batches.size() * BATCH_LANES * IMG_ROWS * IMG_COLS * sizeof(uint16_t); }
+
+        /**
+         * @brief Append a labeled frame
+         *
+         * @param label - The expected output
+         * @param frame - Canonical RGB565 frame
+         */
+        void add(Label label, std::span<const uint16_t> frame)
+        {
+            if (batches.empty() || batches.back().full()) batches.emplace_back();
+            batches.back().push(frame);
+            labels.push_back(std::move(label));
+        }
+    };
+
+    /**
+     * @brief How a sweep is run
+     *
+     */
+    struct Options {
+        MicroCV2::Core::Config base = MicroCV2::Core::DEFAULT_CONFIG;   ///< Values of the fields the space does not list
+        uint64_t random = 0;        ///< Number of random combinations to draw. 0 runs the full grid.
+        uint64_t seed = 1;          ///< Seed of the random draws
+        size_t top = 10;            ///< Combinations are only abandoned once they cannot make the top this many
+        unsigned threads = 0;       ///< Worker threads. 0 uses one per hardware thread.
+    };
+
+    /**
+     * @brief The score of one combination
+     *
+     */
+    struct Score {
+        std::vector<int> values;    ///< One value per parameter of the space
+        bool valid = true;          ///< False if the values make an empty stop box or white line crop
+        bool pruned = false;        ///< True if it was abandoned before every frame was scored
+        uint64_t frames = 0;        ///< Frames scored
+        uint64_t stopErrors = 0;
+        uint64_t distErrors = 0;    ///< Frames where the reported dist differs from the label, including missed and extra lines
+        uint64_t distAbsError = 0;
+        double detectNs = 0;        ///< Time both detectors took per frame
+
+        uint64_t errors() const { return stopErrors + distErrors; }
+    };
+
+    /**
+     * @brief Check whether a field can be tuned, and how its value is limited
+     *
+     * @param name - The Core::Config field name
+     * @param maxValue - Output largest value the field holds
+     * @return true - If the field can be tuned
+     */
+    bool isParameter(const std::string& name, int& maxValue);
+
+    /**
+     * @brief Read a search space file
+     *
+     * @param path - The file
+     * @param space - Output search space
+     * @return true - If every line was valid
+     */
+    bool loadSpace(const std::string& path, Space& space);
+
+    /**
+     * @brief Read a labels file, a CSV whose header names at least the stop, dist, and file columns, with
+     * file last. The truth.csv of FrameGen and the results.csv of a batch merge both qualify.
+     *
+     * @param path - The labels file
+     * @param labels - Output labels. Relative frame paths that do not exist are looked up next to the labels file.
+     * @return true - If the file was read
+     */
+    bool loadLabels(const std::string& path, std::vector<Label>& labels);
+
+    /**
+     * @brief Decode every labeled frame once, in parallel. Frames that cannot be read are skipped with their labels.
+     *
+     * @param labels - The labels
+     * @param threads - Worker threads. 0 uses one per hardware thread.
+     * @return Dataset - The decoded frames
+     */
+    Dataset loadDataset(std::vector<Label> labels, unsigned threads = 0);
+
+    /**
+     * @brief Score every combination of a sweep
+     *
+     * @param dataset - The labeled frames
+     * @param space - The parameters to tune
+     * @param options - How to run the sweep
+     * @return std::vector<Score> - Every combination, best first: complete scores by errors and then by time,
+     * then the abandoned ones, then the invalid ones
+     */
+    std::vector<Score> run(const Dataset& dataset, const Space& space, const Options& options);
+
+}
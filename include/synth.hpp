@@ -0,0 +1,101 @@
+#pragma once
+
+#include "params.hpp"
+
+#include <span>
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Namespace for generating synthetic RGB565 frames with known ground truth.
+ *
+ * A scene is a grey road with an optional red stop line across it and an optional white line crossing
+ * the white line crop, under a lighting gain and gradient, with per-channel noise on top. Every frame is
+ * generated from its own seed derived from the scene seed and the frame index, so any frame of a run
+ * can be regenerated on its own and runs can be split across threads or machines. The random numbers
+ * come from a local generator instead of the std distributions, whose output differs between standard
+ * libraries.
+ */
+namespace Synth {
+
+    /**
+     * @brief Random ranges the scene of every frame is drawn from
+     *
+     */
+    struct SceneConfig {
+        uint64_t seed = 1;
+
+        float whiteProbability = 0.8f;  ///< Chance that a frame has a white line
+        float whiteXMin = 0;            ///< Range of the line's left edge where it crosses WHITE_VERTICAL_CROP
+        float whiteXMax = 70;
+        float whiteSlopeMin = 0.2f;     ///< Range of the line's horizontal shift per row. The detector fits its line
+        float whiteSlopeMax = 0.8f;     ///< through the leftmost and bottom points, so it expects lines leaning right going down.
+        float whiteWidthMin = 4;        ///< Range of the line's width in pixels
+        float whiteWidthMax = 12;
+
+        float stopProbability = 0.3f;   ///< Chance that a frame has a stop line
+        int stopYMin = 60;              ///< Range of the stop line's top row
+        int stopYMax = 90;
+        int stopHeightMin = 3;          ///< Range of the stop line's height in rows
+        int stopHeightMax = 12;
+
+        float noise = 6;                ///< Largest noise added to each RGB888 channel, either way
+        float lightMin = 1;             ///< Range of the gain applied to the whole frame
+        float lightMax = 1;
+        float gradient = 0;             ///< Largest darkening of the top row relative to the bottom row, 0 to 1
+    };
+
+    /**
+     * @brief What the detectors should report for a frame, taken from the scene before lighting and noise
+     *
+     */
+    struct GroundTruth {
+        bool stop = false;              ///< The stop line covers at least PERCENT_TO_STOP of the stop box
+        bool white = false;             ///< At least WHITE_MIN_SIZE white line pixels lie inside the crop
+        int8_t dist = 0;                ///< Distance of the line's left edge at WHITE_VERTICAL_CROP, clamped like the detector. 0 without a line.
+        uint16_t redPercent = 0;        ///< Percentage of the stop box covered by the stop line, times 100
+        uint16_t whitePixels = 0;       ///< White line pixels inside the crop
+    };
+
+    /**
+     * @brief Renders the frames of one scene configuration
+     *
+     */
+    class Generator {
+    public:
+        explicit Generator(const SceneConfig& config = SceneConfig()) : m_config(config) {}
+
+        /**
+         * @brief Render a frame into memory
+         *
+         * @param index - The frame index. The same index always renders the same frame.
+         * @param frame - Output canonical RGB565 frame of IMG_ROWS x IMG_COLS pixels
+         * @return GroundTruth - The expected detector output
+         */
+        GroundTruth render(const uint64_t index, std::span<uint16_t> frame) const;
+
+        const SceneConfig& config() const { return m_config; }
+
+    private:
+        SceneConfig m_config;
+    };
+
+    /**
+     * @brief Write a frame in the raw binary format the SD card program saves, high byte first
+     *
+     * @param filename - The filepath
+     * @param frame - The canonical frame
+     * @return true - If the file was written
+     */
+    bool writeBinary(const std::string& filename, std::span<const uint16_t> frame);
+
+    /**
+     * @brief Write a frame in the compact hex format the firmware prints, one line per row
+     *
+     * @param filename - The filepath
+     * @param frame - The canonical frame
+     * @return true - If the file was written
+     */
+    bool writeCompactHex(const std::string& filename, std::span<const uint16_t> frame);
+
+}
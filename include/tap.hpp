@@ -0,0 +1,70 @@
+#pragma once
+
+#include "opencv2.hpp"
+#include "microcv2_core.hpp"
+
+#include <stdint.h>
+
+/**
+ * @brief Namespace for watching the intermediate results of the MicroCV2 detectors as they run.
+ *
+ * processRedImg and processWhiteImg take an optional Sink. The detectors hand it every intermediate from
+ * the same pass that produces their result, so debug and presentation images never need a second copy
+ * of the detector loops. Without a sink, every tap point is a single null check.
+ *
+ * The production pass only classifies the stop box and the white line crop. The whole frame
+ * classification stages cost one extra scan, so they are only computed for sinks whose wants() asks for them.
+ */
+namespace MicroCV2::Tap {
+
+    enum class Stage : uint8_t {
+        STOP_CLASSIFIED,    ///< Stop line classification of the whole frame. Extra scan, only for sinks that ask for it.
+        STOP_CROPPED,       ///< Stop line pixels inside the stop box, as counted
+        WHITE_CLASSIFIED,   ///< White line classification of the whole frame. Extra scan, only for sinks that ask for it.
+        WHITE_CROPPED,      ///< White line pixels inside the crop, after any morphology
+        WHITE_BLOB,         ///< The largest blob of the crop and its extreme points
+        WHITE_LINE          ///< The line fitted to the blob and its intersection with WHITE_VERTICAL_CROP
+    };
+
+    /**
+     * @brief Receives the intermediates of the detectors. Override the callbacks of the stages of interest.
+     *
+     * Masks are only valid during the callback. Clone them to keep them.
+     */
+    class Sink {
+    public:
+        virtual ~Sink() = default;
+
+        /**
+         * @brief Whether the detectors should produce a stage for this sink. Only the whole frame stages
+         * cost anything extra, so they are left out unless a sink overrides this to ask for them.
+         *
+         */
+        virtual bool wants(Stage stage) const { return stage != Stage::STOP_CLASSIFIED && stage != Stage::WHITE_CLASSIFIED; }
+
+        /**
+         * @brief A mask stage: STOP_CLASSIFIED, STOP_CROPPED, WHITE_CLASSIFIED, or WHITE_CROPPED
+         *
+         */
+        virtual void onMask(Stage, const cv::Mat1b&) {}
+
+        /**
+         * @brief The stop box count and decision, after STOP_CROPPED
+         *
+         */
+        virtual void onStopBox(const Core::BoxResult&) {}
+
+        /**
+         * @brief The WHITE_BLOB stage. Only reached if the crop has a blob.
+         *
+         */
+        virtual void onBlob(const Core::Blob&) {}
+
+        /**
+         * @brief The WHITE_LINE stage. Only reached if the blob is large enough to be the white line.
+         *
+         */
+        virtual void onLine(const Core::LineFit&) {}
+    };
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Namespace for the scoped-span tracing facility used to time the hot path.
+ *
+ * Spans are recorded into a per-thread buffer, so recording only takes an uncontended per-thread lock.
+ * Only exporting the spans contends for it. The spans can be exported as Chrome trace-event JSON (open
+ * with chrome://tracing or https://ui.perfetto.dev) and summarized as p50/p95/p99 latencies per stage.
+ *
+ * All of the instrumentation goes through the TRACE_SCOPE and TRACE_FRAME macros which compile to
+ * nothing unless the project is configured with ESPVIEWER_ENABLE_TRACING.
+ */
+namespace Trace {
+
+    /**
+     * @brief Whether tracing was compiled into this build
+     *
+     */
+#ifdef ESPVIEWER_TRACING
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    /**
+     * @brief Get the current time of the tracing clock
+     *
+     * @return uint64_t - Nanoseconds since the first call to the tracing clock
+     */
+    uint64_t nowNs();
+
+    /**
+     * @brief Record a completed span in the calling thread's buffer
+     *
+     * @param name - The stage name. Must be a string literal or otherwise outlive the trace.
+     * @param startNs - Start time of the span from nowNs()
+     * @param endNs - End time of the span from nowNs()
+     */
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    /**
+     * @brief Set the frame index attached to every span recorded by the calling thread
+     *
+     * @param frame - The frame index, or -1 to stop attaching a frame
+     */
+    void setFrame(int32_t frame);
+
+    /**
+     * @brief Get the frame index currently attached to spans from the calling thread
+     *
+     * @return int32_t - The frame index, or -1 if none is set
+     */
+    int32_t currentFrame();
+
+    /**
+     * @brief Discard all of the recorded spans from every thread
+     *
+     */
+    void clear();
+
+    /**
+     * @brief Write every recorded span to a Chrome trace-event JSON file
+     *
+     * @param filename - The path of the JSON file to write
+     * @return true - If the file was written
+     * @return false - If the file could not be opened
+     */
+    bool writeChromeTrace(const std::string& filename);
+
+    /**
+     * @brief Print the count, mean, p50, p95, and p99 latency of every stage to stdout
+     *
+     */
+    void printSummary();
+
+    /**
+     * @brief RAII span that records the time between its construction and destruction
+     *
+     */
+    class ScopedSpan {
+    public:
+        explicit ScopedSpan(const char* name) : m_name(name), m_start(nowNs()) {}
+        ~ScopedSpan() { record(m_name, m_start, nowNs()); }
+
+        ScopedSpan(const ScopedSpan&) = delete;
+        ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_start;
+    };
+
+    /**
+     * @brief RAII guard that attaches a frame index to the calling thread's spans for its lifetime
+     *
+     */
+    class FrameScope {
+    public:
+        explicit FrameScope(int32_t frame) : m_previous(currentFrame()) { setFrame(frame); }
+        ~FrameScope() { setFrame(m_previous); }
+
+        FrameScope(const FrameScope&) = delete;
+        FrameScope& operator=(const FrameScope&) = delete;
+
+    private:
+        int32_t m_previous;
+    };
+
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef ESPVIEWER_TRACING
+    #define TRACE_SCOPE(name) Trace::ScopedSpan TRACE_CONCAT(traceSpan_, __LINE__)(name)
+    #define TRACE_FRAME(frame) Trace::FrameScope TRACE_CONCAT(traceFrame_, __LINE__)(static_cast<int32_t>(frame))
+#else
+    #define TRACE_SCOPE(name) ((void)0)
+    #define TRACE_FRAME(frame) ((void)0)
+#endif
@@ -0,0 +1,348 @@
+#include "batch.hpp"
+#include "cli.hpp"
+#include "image_io.hpp"
+#include "microcv2.hpp"
+#include "results_store.hpp"
+#include "trace.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    constexpr const char* RESULT_HEADER = "stop,white,dist,red_percent,blob_area,load_ns,process_ns,file";
+    constexpr int RESULT_FIELDS = 7;    // Fields before the file name, which is last so it may contain commas
+
+    uint64_t elapsedNs(const clock_type::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+    }
+
+    void writeResult(std::ofstream& out, const Batch::FrameResult& result)
+    {
+        out << fmt::format("{},{},{},{},{},{},{},{}\n", result.stop ? 1 : 0, result.white ? 1 : 0, result.dist,
+                           result.redPercent, result.blobArea, result.loadNs, result.processNs, result.file);
+    }
+
+    /**
+     * @brief Parse one whole field of a result row. Returns false if it is not entirely a number.
+     *
+     */
+    template <typename T>
+    bool parseField(const std::string_view field, T& value)
+    {
+        const char* end = field.data() + field.size();
+        auto [ptr, ec] = std::from_chars(field.data(), end, value);
+        return ec == std::errc() && ptr == end;
+    }
+
+    /**
+     * @brief Parse a single result row. Returns false for malformed rows.
+     *
+     */
+    bool parseResult(const std::string& line, Batch::FrameResult& result)
+    {
+        size_t pos = 0;
+        std::string_view fields[RESULT_FIELDS];
+        for (int i = 0; i < RESULT_FIELDS; ++i) {
+            size_t comma = line.find(',', pos);
+            if (comma == std::string::npos) return false;
+            fields[i] = std::string_view(line).substr(pos, comma - pos);
+            pos = comma + 1;
+        }
+
+        int64_t stop, white, dist, redPercent;
+        if (!parseField(fields[0], stop) || !parseField(fields[1], white) || !parseField(fields[2], dist) ||
+            !parseField(fields[3], redPercent) || !parseField(fields[4], result.blobArea) ||
+            !parseField(fields[5], result.loadNs) || !parseField(fields[6], result.processNs)) {
+            return false;
+        }
+
+        result.stop = stop != 0;
+        result.white = white != 0;
+        result.dist = static_cast<int8_t>(dist);
+        result.redPercent = static_cast<uint16_t>(redPercent);
+        result.file = line.substr(pos);
+        return true;
+    }
+
+    /**
+     * @brief Read a shard result file written by runShard
+     *
+     */
+    bool readShard(const std::string& path, Batch::ShardSummary& summary, std::vector<Batch::FrameResult>& results)
+    {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Error: Missing shard result " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        std::getline(in, line);     // # shard,shards,frames,wall_ns
+        std::getline(in, line);
+        if (std::sscanf(line.c_str(), "# %u,%u,%llu,%llu", &summary.shard, &summary.shards,
+                        reinterpret_cast<unsigned long long*>(&summary.frames),
+                        reinterpret_cast<unsigned long long*>(&summary.wallNs)) != 4) {
+            std::cerr << "Error: Malformed shard summary in " << path << std::endl;
+            return false;
+        }
+        std::getline(in, line);     // Column header
+
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+
+            Batch::FrameResult result;
+            if (!parseResult(line, result)) {
+                std::cerr << "Error: Malformed result row in " << path << ": " << line << std::endl;
+                return false;
+            }
+            results.push_back(std::move(result));
+        }
+
+        return true;
+    }
+
+}
+
+bool Batch::inShard(const std::string& filename, const uint32_t shard, const uint32_t shards)
+{
+    return stableHash(fs::path(filename).filename().string()) % shards == shard;
+}
+
+std::string Batch::shardResultPath(const std::string& outDir, const uint32_t shard, const uint32_t shards)
+{
+    return (fs::path(outDir) / fmt::format("results.shard-{}-of-{}.csv", shard, shards)).string();
+}
+
+int Batch::runShard(const Options& options)
+{
+    auto shardStart = clock_type::now();
+
+    // Gather this shard's files, sorted so every run of a shard processes them in the same order
+    std::vector<std::string> extensions = {".bin", ".BIN"};
+    std::vector<std::pair<std::string, bool>> files;    // filename, is compact hex
+    for (const auto& filename : get_filenames_in_dir(options.hexDir, extensions)) {
+        if (inShard(filename, options.shard, options.shards)) files.emplace_back(filename, true);
+    }
+    for (const auto& filename : get_filenames_in_dir(options.binDir, extensions)) {
+        if (inShard(filename, options.shard, options.shards)) files.emplace_back(filename, false);
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<FrameResult> results;
+    results.reserve(files.size());
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        const auto& [filename, isHex] = files[i];
+        TRACE_FRAME(i);
+
+        FrameResult result;
+        result.file = filename;
+
+        auto start = clock_type::now();
+        cv::Mat image = isHex ? load_compact_hex_image(filename) : load_binary_image(filename);
+        result.loadNs = elapsedNs(start);
+        if (image.empty()) {
+            std::cerr << "Error: Skipping unreadable file " << filename << std::endl;
+            continue;
+        }
+
+        start = clock_type::now();
+        cv::Mat1b wmask, center, rmask;
+        MicroCV2::Core::WhiteResult white;
+        MicroCV2::Core::BoxResult red;
+        result.white = MicroCV2::processWhiteImg(image, wmask, center, result.dist, options.config, white);
+        result.stop = MicroCV2::processRedImg(image, rmask, options.config, red);
+        result.processNs = elapsedNs(start);
+
+        result.redPercent = red.percent;
+        result.blobArea = white.blob.found ? white.blob.area2 / 2.0f : 0.0f;
+
+        results.push_back(std::move(result));
+    }
+
+    // Write to a temporary file first so a merge never sees a half written shard
+    fs::create_directories(options.outDir);
+    const std::string path = shardResultPath(options.outDir, options.shard, options.shards);
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath);
+        if (!out) {
+            std::cerr << "Error: Could not open file " << tmpPath << std::endl;
+            return 1;
+        }
+
+        out << "# shard,shards,frames,wall_ns\n";
+        out << fmt::format("# {},{},{},{}\n", options.shard, options.shards, results.size(), elapsedNs(shardStart));
+        out << RESULT_HEADER << "\n";
+        for (const auto& result : results) {
+            writeResult(out, result);
+        }
+    }
+    fs::rename(tmpPath, path);
+
+    fmt::println("Shard {}/{}: processed {} frames into {}", options.shard, options.shards, results.size(), path);
+    return 0;
+}
+
+int Batch::mergeShards(const Options& options)
+{
+    std::vector<FrameResult> results;
+    std::vector<ShardSummary> summaries(options.shards);
+
+    bool complete = true;
+    for (uint32_t shard = 0; shard < options.shards; ++shard) {
+        if (!readShard(shardResultPath(options.outDir, shard, options.shards), summaries[shard], results)) {
+            complete = false;
+        }
+    }
+    if (!complete) return 1;
+
+    std::sort(results.begin(), results.end(), [](const FrameResult& a, const FrameResult& b) {
+        return a.file < b.file;
+    });
+
+    auto duplicate = std::adjacent_find(results.begin(), results.end(), [](const FrameResult& a, const FrameResult& b) {
+        return a.file == b.file;
+    });
+    if (duplicate != results.end()) {
+        std::cerr << "Error: " << duplicate->file << " was processed by more than one shard" << std::endl;
+        return 1;
+    }
+
+    const std::string path = (fs::path(options.outDir) / "results.csv").string();
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        return 1;
+    }
+    out << RESULT_HEADER << "\n";
+
+    uint64_t loadNs = 0, processNs = 0, stops = 0, whites = 0;
+    std::vector<Results::Record> records;
+    records.reserve(results.size());
+    for (const auto& result : results) {
+        writeResult(out, result);
+        records.push_back({result.file, result.stop, result.white, result.dist, result.redPercent, result.blobArea});
+        loadNs += result.loadNs;
+        processNs += result.processNs;
+        stops += result.stop;
+        whites += result.white;
+    }
+
+    // Shards run concurrently, so the slowest shard bounds the wall clock time of the whole run
+    uint64_t maxWallNs = 0, sumWallNs = 0;
+    for (const auto& summary : summaries) {
+        maxWallNs = std::max(maxWallNs, summary.wallNs);
+        sumWallNs += summary.wallNs;
+    }
+
+    // Merging the same shards again must not store their frames twice, so only frames the store lacks are appended
+    const std::string storePath = options.store.empty() ? (fs::path(options.outDir) / "results.cols").string() : options.store;
+    if (fs::exists(storePath) && fs::file_size(storePath) > 0) {
+        Results::Reader reader;
+        if (!reader.open(storePath)) return 1;
+
+        std::unordered_set<std::string_view> stored;
+        for (const Results::Chunk& chunk : reader.chunks()) {
+            for (size_t row = 0; row < chunk.size(); ++row) {
+                stored.insert(chunk.source(row));
+            }
+        }
+
+        const size_t before = records.size();
+        std::erase_if(records, [&](const Results::Record& record) { return stored.contains(record.source); });
+        if (records.size() < before) {
+            fmt::println("Skipped {} frames that are already in {}", before - records.size(), storePath);
+        }
+    }
+    if (!records.empty() && !Results::append(storePath, records)) return 1;
+
+    const double frames = static_cast<double>(results.size());
+    fmt::println("Merged {} frames from {} shards into {} and {}", results.size(), options.shards, path, storePath);
+    fmt::println("  stop frames: {}, white line frames: {}", stops, whites);
+    if (!results.empty()) {
+        fmt::println("  mean load: {:.2f} us, mean process: {:.2f} us", loadNs / 1000.0 / frames, processNs / 1000.0 / frames);
+    }
+    if (maxWallNs > 0) {
+        fmt::println("  aggregate throughput: {:.1f} frames/s (slowest shard {:.3f} s)", frames * 1e9 / maxWallNs, maxWallNs / 1e9);
+        fmt::println("  per-shard throughput: {:.1f} frames/s", frames * 1e9 / sumWallNs);
+    }
+    for (const auto& summary : summaries) {
+        fmt::println("  shard {}: {} frames in {:.3f} s", summary.shard, summary.frames, summary.wallNs / 1e9);
+    }
+
+    return 0;
+}
+
+int Batch::run(int argc, char* argv[])
+{
+    Options options;
+    bool merge = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch") continue;
+        if (arg == "--merge") {
+            merge = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << arg << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--shard") {
+            if (!Cli::parseValue(arg, value, options.shard)) return 2;
+        } else if (arg == "--shards") {
+            if (!Cli::parseValue(arg, value, options.shards)) return 2;
+        } else if (arg == "--out") options.outDir = value;
+        else if (arg == "--hex-dir") options.hexDir = value;
+        else if (arg == "--bin-dir") options.binDir = value;
+        else if (arg == "--store") options.store = value;
+        else if (arg == "--coarse") {
+            if (!Cli::parseValue(arg, value, options.config.COARSE_FACTOR, uint8_t{2}, uint8_t{8})) return 2;
+        }
+        else if (arg == "--stop-morph" || arg == "--white-morph") {
+            MicroCV2::Morph::Op op;
+            if (!MicroCV2::Morph::parseOp(value, op)) {
+                std::cerr << "Error: Unknown morphology " << value << ", expected none, erode, dilate, open, or close" << std::endl;
+                return 2;
+            }
+            (arg == "--stop-morph" ? options.config.STOP_MORPHOLOGY : options.config.WHITE_MORPHOLOGY) = static_cast<uint8_t>(op);
+        } else if (arg == "--morph-shape") {
+            MicroCV2::Morph::Shape shape;
+            if (!MicroCV2::Morph::parseShape(value, shape)) {
+                std::cerr << "Error: Unknown structuring element " << value << ", expected cross or square" << std::endl;
+                return 2;
+            }
+            options.config.MORPH_SHAPE = static_cast<uint8_t>(shape);
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    if (options.shards == 0 || options.shard >= options.shards) {
+        std::cerr << "Error: --shard must be less than --shards" << std::endl;
+        return 2;
+    }
+
+    return merge ? mergeShards(options) : runShard(options);
+}
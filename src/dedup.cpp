@@ -0,0 +1,134 @@
+#include "dedup.hpp"
+#include "microcv2_core.hpp"
+#include "trace.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+    constexpr int HASH_COLS = 9;    // One more column than bits per row, each bit compares neighbours
+    constexpr int HASH_ROWS = 8;
+
+}
+
+Dedup::Options Dedup::Options::fromEnvironment()
+{
+    Options options;
+
+    const char* env = std::getenv(ENV_VAR);
+    if (env == nullptr) return options;
+
+    const std::string_view value = env;
+    if (value == "off") {
+        options.enabled = false;
+    } else if (value != "exact") {
+        int distance = 0;
+        auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), distance);
+        if (ec != std::errc() || ptr != value.data() + value.size() || distance < 0 || distance > 64) {
+            std::cerr << "Warning: Unknown " << ENV_VAR << " value " << value << ", using exact" << std::endl;
+        } else {
+            options.maxDistance = distance;
+        }
+    }
+
+    return options;
+}
+
+Dedup::Signature Dedup::computeSignature(std::span<const uint16_t> frame, const int width, const int height)
+{
+    TRACE_SCOPE("Dedup::computeSignature");
+
+    Signature signature;
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (uint16_t pixel : frame) {
+        hash ^= pixel & 0xFF;
+        hash *= 0x100000001B3ULL;
+        hash ^= pixel >> 8;
+        hash *= 0x100000001B3ULL;
+    }
+    signature.exact = hash;
+
+    // Sum the luma of each thumbnail cell
+    uint32_t cells[HASH_ROWS][HASH_COLS] = {};
+    for (int y = 0; y < height; ++y) {
+        const uint16_t* row = frame.data() + y * width;
+        const int cellY = y * HASH_ROWS / height;
+
+        for (int x = 0; x < width; ++x) {
+            uint16_t red, green, blue;
+            MicroCV2::Core::RGB565toRGB888(row[x], red, green, blue);
+            cells[cellY][x * HASH_COLS / width] += (77 * red + 150 * green + 29 * blue) >> 8;
+        }
+    }
+
+    // The columns of cells differ in width, so compare the mean luma of neighbours. Cross-multiplying by the
+    // other cell's width keeps it exact. Every cell in a row has the same height, which cancels out.
+    uint32_t cellWidths[HASH_COLS] = {};
+    for (int x = 0; x < width; ++x) {
+        cellWidths[x * HASH_COLS / width]++;
+    }
+
+    uint64_t bits = 0;
+    for (int y = 0; y < HASH_ROWS; ++y) {
+        for (int x = 0; x < HASH_COLS - 1; ++x) {
+            const uint64_t left = static_cast<uint64_t>(cells[y][x]) * cellWidths[x + 1];
+            const uint64_t right = static_cast<uint64_t>(cells[y][x + 1]) * cellWidths[x];
+            bits = (bits << 1) | (left < right ? 1 : 0);
+        }
+    }
+    signature.perceptual = bits;
+
+    return signature;
+}
+
+Dedup::Signature Dedup::computeSignature(const cv::Mat& image)
+{
+    const cv::Mat continuous = image.isContinuous() ? image : image.clone();
+    return computeSignature({continuous.ptr<uint16_t>(), continuous.total()}, continuous.cols, continuous.rows);
+}
+
+bool Dedup::samePixels(const cv::Mat& a, const cv::Mat& b)
+{
+    if (a.size() != b.size() || a.type() != b.type()) return false;
+
+    const size_t rowBytes = a.cols * a.elemSize();
+    for (int y = 0; y < a.rows; ++y) {
+        if (std::memcmp(a.ptr(y), b.ptr(y), rowBytes) != 0) return false;
+    }
+    return true;
+}
+
+Dedup::Deduplicator::Deduplicator(const Options& options) : m_options(options) {}
+
+std::optional<size_t> Dedup::Deduplicator::findOrAdd(const Signature& signature, const size_t frame,
+                                                     const std::function<bool(size_t)>& samePixels)
+{
+    m_frames++;
+    if (!m_options.enabled) return std::nullopt;
+
+    // A hash collision falls through to the perceptual match, and the first frame keeps the hash
+    const auto it = m_exact.find(signature.exact);
+    if (it != m_exact.end() && samePixels(it->second)) {
+        m_duplicates++;
+        return it->second;
+    }
+
+    if (m_options.maxDistance >= 0) {
+        for (const auto& [perceptual, original] : m_perceptual) {
+            if (std::popcount(perceptual ^ signature.perceptual) <= m_options.maxDistance) {
+                m_duplicates++;
+                return original;
+            }
+        }
+        m_perceptual.emplace_back(signature.perceptual, frame);
+    }
+
+    m_exact.emplace(signature.exact, frame);
+    return std::nullopt;
+}
@@ -0,0 +1,332 @@
+#include "frame_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    // Header is cache line aligned, so the slots that follow it are too
+    constexpr size_t SLOTS_OFFSET = sizeof(FrameRing::Header);
+
+    std::string systemName(const std::string& name)
+    {
+#ifdef _WIN32
+        return "Local\\ESPViewer." + name;
+#else
+        return "/" + name;
+#endif
+    }
+
+}
+
+FrameRing::SharedMemory::~SharedMemory()
+{
+    close();
+}
+
+bool FrameRing::SharedMemory::create(const std::string& name, const size_t size)
+{
+    close();
+    const std::string path = systemName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                        static_cast<DWORD>(size & 0xFFFFFFFF), path.c_str());
+    if (mapping == nullptr) {
+        std::cerr << "Error: Could not create shared memory " << name << std::endl;
+        return false;
+    }
+    // Windows removes the memory once its last handle closes, so an existing mapping belongs to a live producer
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        std::cerr << "Error: Shared memory " << name << " is already in use" << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        std::cerr << "Error: Could not map shared memory " << name << std::endl;
+        return false;
+    }
+    m_mapping = mapping;
+#else
+    // Consumers still attached to an earlier ring of the same name keep their mapping until they close it.
+    // Only the owner may open the memory, so other users can neither read the frames nor corrupt the slots.
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create shared memory " << name << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        shm_unlink(path.c_str());
+        std::cerr << "Error: Could not size shared memory " << name << std::endl;
+        return false;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        std::cerr << "Error: Could not map shared memory " << name << std::endl;
+        return false;
+    }
+#endif
+
+    m_data = static_cast<uint8_t*>(view);
+    m_size = size;
+    m_createdName = path;
+    return true;
+}
+
+bool FrameRing::SharedMemory::open(const std::string& name)
+{
+    close();
+    const std::string path = systemName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (mapping == nullptr) {
+        std::cerr << "Error: Could not open shared memory " << name << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (view == nullptr || VirtualQuery(view, &info, sizeof(info)) == 0) {
+        if (view) UnmapViewOfFile(view);
+        CloseHandle(mapping);
+        std::cerr << "Error: Could not map shared memory " << name << std::endl;
+        return false;
+    }
+    m_mapping = mapping;
+    const size_t size = info.RegionSize;
+#else
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open shared memory " << name << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        std::cerr << "Error: Could not read the size of shared memory " << name << std::endl;
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Error: Could not map shared memory " << name << std::endl;
+        return false;
+    }
+#endif
+
+    m_data = static_cast<uint8_t*>(view);
+    m_size = size;
+    return true;
+}
+
+void FrameRing::SharedMemory::close()
+{
+    if (m_data == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+#else
+    munmap(m_data, m_size);
+    if (!m_createdName.empty()) shm_unlink(m_createdName.c_str());
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_createdName.clear();
+    m_mapping = nullptr;
+}
+
+bool FrameRing::Producer::create(const std::string& name, const uint32_t slotCount)
+{
+    if (slotCount == 0) {
+        std::cerr << "Error: A frame ring needs at least one slot" << std::endl;
+        return false;
+    }
+    if (!m_memory.create(name, SLOTS_OFFSET + static_cast<size_t>(slotCount) * sizeof(Slot))) return false;
+
+    m_header = new (m_memory.data()) Header{};
+    m_slots = reinterpret_cast<Slot*>(m_memory.data() + SLOTS_OFFSET);
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        new (&m_slots[i]) Slot{};
+    }
+    m_slotCount = slotCount;
+    m_next = 0;
+    m_claimed = nullptr;
+
+    m_header->slotCount = slotCount;
+    m_header->slotSize = sizeof(Slot);
+
+    // Consumers only trust the ring once the magic is there, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    return true;
+}
+
+FrameRing::Slot& FrameRing::Producer::claim()
+{
+    if (m_claimed) return *m_claimed;
+
+    Slot& slot = m_slots[m_next % m_slotCount];
+
+    // Mark the slot as being written before touching its contents, so readers of the old frame notice
+    slot.version.store(2 * m_next + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.seq = m_next;
+    slot.source = 0;
+    slot.frame = 0;
+    slot.hasDetection = 0;
+    slot.detection = {};
+
+    m_claimed = &slot;
+    return slot;
+}
+
+void FrameRing::Producer::publish()
+{
+    if (!m_claimed) return;
+
+    m_claimed->publishNs = nowNs();
+    m_claimed->version.store(2 * m_next + 2, std::memory_order_release);
+    m_header->head.store(m_next + 1, std::memory_order_release);
+
+    m_next++;
+    m_claimed = nullptr;
+}
+
+uint64_t FrameRing::Producer::publish(std::span<const uint16_t> pixels, const uint64_t source, const uint64_t frame,
+                                      const Detection* detection)
+{
+    Slot& slot = claim();
+    std::memcpy(slot.pixels, pixels.data(), std::min(pixels.size(), PIXELS) * sizeof(uint16_t));
+    slot.source = source;
+    slot.frame = frame;
+    if (detection) {
+        slot.detection = *detection;
+        slot.hasDetection = 1;
+    }
+
+    const uint64_t seq = slot.seq;
+    publish();
+    return seq;
+}
+
+bool FrameRing::Consumer::open(const std::string& name)
+{
+    if (!m_memory.open(name)) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(m_memory.data());
+    if (m_memory.size() < sizeof(Header) || std::memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0) {
+        std::cerr << "Error: " << name << " is not a frame ring, or its producer is still creating it" << std::endl;
+        m_memory.close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (header->slotSize != sizeof(Slot) || header->slotCount == 0
+        || m_memory.size() < SLOTS_OFFSET + static_cast<size_t>(header->slotCount) * sizeof(Slot)) {
+        std::cerr << "Error: Frame ring " << name << " was created by an incompatible build" << std::endl;
+        m_memory.close();
+        return false;
+    }
+
+    m_header = header;
+    m_slots = reinterpret_cast<const Slot*>(m_memory.data() + SLOTS_OFFSET);
+    m_slotCount = header->slotCount;
+    m_next = header->head.load(std::memory_order_acquire);
+    m_dropped = 0;
+    return true;
+}
+
+std::optional<FrameRing::FrameView> FrameRing::Consumer::next()
+{
+    while (true) {
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (m_next >= head) return std::nullopt;
+
+        // Frames more than a ring's length behind the producer have been overwritten
+        if (head - m_next > m_slotCount) {
+            m_dropped += head - m_slotCount - m_next;
+            m_next = head - m_slotCount;
+        }
+
+        const uint64_t seq = m_next++;
+        const Slot& slot = m_slots[seq % m_slotCount];
+        if (slot.version.load(std::memory_order_acquire) == 2 * seq + 2) {
+            return FrameView{seq, &slot};
+        }
+
+        // The producer lapped this frame between reading head and reading the slot
+        m_dropped++;
+    }
+}
+
+std::optional<FrameRing::FrameView> FrameRing::Consumer::latest()
+{
+    while (true) {
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (m_next >= head) return std::nullopt;
+
+        const uint64_t seq = head - 1;
+        const Slot& slot = m_slots[seq % m_slotCount];
+        if (slot.version.load(std::memory_order_acquire) == 2 * seq + 2) {
+            m_next = seq + 1;
+            return FrameView{seq, &slot};
+        }
+    }
+}
+
+bool FrameRing::Consumer::valid(const FrameView& view)
+{
+    // Order every read of the slot before the version check, the reader side of the seqlock
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (view.slot->version.load(std::memory_order_relaxed) == 2 * view.seq + 2) return true;
+
+    m_dropped++;
+    return false;
+}
+
+bool FrameRing::Consumer::wait(const std::chrono::microseconds timeout) const
+{
+    // Spin briefly for a sub-millisecond hand-off, then back off to short sleeps
+    constexpr int SPINS = 256;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    for (int i = 0; ; ++i) {
+        if (m_header->head.load(std::memory_order_acquire) > m_next) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+
+        if (i < SPINS) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
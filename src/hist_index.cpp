@@ -0,0 +1,216 @@
+#include "hist_index.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+    constexpr char INDEX_MAGIC[8] = {'E', 'S', 'P', 'H', 'I', 'S', 'T', '2'};
+
+    template <typename T>
+    void writeValue(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool readValue(std::ifstream& file, T& value)
+    {
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * @brief Same integer arithmetic as the detectors so the decision matches exactly
+     *
+     */
+    bool exceedsPercent(const uint16_t count, const uint16_t area, const uint8_t percent)
+    {
+        uint16_t percentCount = (count * 10000) / area;
+        return percentCount >= (percent * 100);
+    }
+
+}
+
+void HistIndex::Index::add(const std::string& source, const cv::Mat& image)
+{
+    TRACE_SCOPE("HistIndex::add");
+
+    FrameHistogram hist;
+    hist.source = source;
+
+    std::vector<uint16_t> values;
+    values.reserve(IMG_ROWS * IMG_COLS);
+
+    for (uint8_t r = 0; r < ROI_COUNT; ++r) {
+        const Roi roi = static_cast<Roi>(r);
+        const RoiRect& rect = ROI_RECTS[roi];
+
+        values.clear();
+        for (int y = rect.tlY; y <= rect.brY && y < image.rows; ++y) {
+            const uint16_t* row = image.ptr<uint16_t>(y);
+            for (int x = rect.tlX; x <= rect.brX && x < image.cols; ++x) {
+                values.push_back(row[x]);
+            }
+        }
+
+        // Run-length encode the sorted values into sparse bins
+        std::sort(values.begin(), values.end());
+        auto& bins = hist.rois[roi];
+        for (size_t i = 0; i < values.size();) {
+            size_t j = i;
+            while (j < values.size() && values[j] == values[i]) ++j;
+            bins.push_back({values[i], static_cast<uint16_t>(j - i)});
+            i = j;
+        }
+    }
+
+    m_frames.push_back(std::move(hist));
+}
+
+std::vector<uint16_t> HistIndex::Index::count(const Roi roi, const PixelLut& lut) const
+{
+    std::vector<uint16_t> counts;
+    counts.reserve(m_frames.size());
+
+    for (const auto& frame : m_frames) {
+        uint16_t total = 0;
+        for (const Bin& bin : frame.rois[roi]) {
+            total += lut[bin.value] * bin.count;
+        }
+        counts.push_back(total);
+    }
+
+    return counts;
+}
+
+std::vector<uint8_t> HistIndex::Index::stopFlags(const StopThresholds& t) const
+{
+    auto lut = makeLut([&](uint16_t red, uint16_t green, uint16_t blue) {
+        bool isStop = red >= green + t.greenTolerance && red >= blue + t.blueTolerance;
+        bool isWhite = red >= t.whiteRed && green >= t.whiteGreen && blue >= t.whiteBlue;
+        return isStop && !isWhite;
+    });
+
+    auto counts = count(ROI_STOP, lut);
+    std::vector<uint8_t> flags(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+        flags[i] = exceedsPercent(counts[i], ROI_RECTS[ROI_STOP].area(), t.percentToStop);
+    }
+    return flags;
+}
+
+std::vector<uint8_t> HistIndex::Index::carFlags(const CarThresholds& t) const
+{
+    auto lut = makeLut([&](uint16_t red, uint16_t green, uint16_t blue) {
+        return green >= red + t.redTolerance && green >= blue + t.blueTolerance;
+    });
+
+    auto counts = count(ROI_CAR, lut);
+    std::vector<uint8_t> flags(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+        flags[i] = exceedsPercent(counts[i], ROI_RECTS[ROI_CAR].area(), t.percentToCar);
+    }
+    return flags;
+}
+
+std::vector<uint16_t> HistIndex::Index::whiteCounts(const WhiteThresholds& t) const
+{
+    auto lut = makeLut([&](uint16_t red, uint16_t green, uint16_t blue) {
+        return red >= t.red && green >= t.green && blue >= t.blue;
+    });
+
+    return count(ROI_WHITE, lut);
+}
+
+bool HistIndex::Index::save(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    for (const RoiRect& rect : ROI_RECTS) {
+        writeValue(file, rect);
+    }
+    writeValue(file, static_cast<uint32_t>(m_frames.size()));
+
+    for (const auto& frame : m_frames) {
+        writeValue(file, static_cast<uint16_t>(frame.source.size()));
+        file.write(frame.source.data(), frame.source.size());
+
+        for (const auto& bins : frame.rois) {
+            writeValue(file, static_cast<uint16_t>(bins.size()));
+            file.write(reinterpret_cast<const char*>(bins.data()), bins.size() * sizeof(Bin));
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool HistIndex::Index::load(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(INDEX_MAGIC)];
+    file.read(magic, sizeof(magic));
+    if (!file || std::memcmp(magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        std::cerr << "Error: " << filename << " is not a histogram index" << std::endl;
+        return false;
+    }
+
+    for (const RoiRect& expected : ROI_RECTS) {
+        RoiRect rect;
+        if (!readValue(file, rect) || !(rect == expected)) {
+            std::cerr << "Error: " << filename << " was built with different region geometry, rebuild it" << std::endl;
+            return false;
+        }
+    }
+
+    uint32_t numFrames;
+    if (!readValue(file, numFrames)) return false;
+
+    // Every frame takes at least its name length and one bin count per region, so a corrupt count cannot
+    // allocate more frames than the file could hold
+    const std::streampos framesStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    const uint64_t remaining = static_cast<uint64_t>(file.tellg() - framesStart);
+    file.seekg(framesStart);
+    constexpr uint64_t MIN_FRAME_BYTES = sizeof(uint16_t) * (1 + ROI_COUNT);
+    if (numFrames > remaining / MIN_FRAME_BYTES) {
+        std::cerr << "Error: " << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    std::vector<FrameHistogram> frames(numFrames);
+    for (auto& frame : frames) {
+        uint16_t nameLength;
+        if (!readValue(file, nameLength)) return false;
+        frame.source.resize(nameLength);
+        file.read(frame.source.data(), nameLength);
+
+        for (auto& bins : frame.rois) {
+            uint16_t numBins;
+            if (!readValue(file, numBins)) return false;
+            bins.resize(numBins);
+            file.read(reinterpret_cast<char*>(bins.data()), numBins * sizeof(Bin));
+        }
+
+        if (!file) {
+            std::cerr << "Error: " << filename << " is truncated" << std::endl;
+            return false;
+        }
+    }
+
+    m_frames = std::move(frames);
+    return true;
+}
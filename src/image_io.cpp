@@ -0,0 +1,206 @@
+#include "image_io.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+cv::Mat convert_rgb565_to_rgb888(const cv::Mat rgb565_image) {
+    TRACE_SCOPE("convert_rgb565_to_rgb888");
+
+    cv::Mat rgb888_image(rgb565_image.rows, rgb565_image.cols, CV_8UC3);  // RGB888 output image
+
+    // Convert each row with the dispatched kernel, which writes OpenCV's BGR order
+    const Kernels::KernelTable& kernels = Kernels::active();
+    for (int row = 0; row < rgb565_image.rows; ++row) {
+        kernels.rgb565ToBgr888(rgb565_image.ptr<uint16_t>(row), rgb888_image.ptr<uint8_t>(row), rgb565_image.cols);
+    }
+
+    return rgb888_image;
+}
+
+std::vector<cv::Mat> convert_rgb565_to_rgb888(std::span<const cv::Mat> rgb565_images) {
+    std::vector<cv::Mat> rgb888_images;
+    rgb888_images.reserve(rgb565_images.size());  // Preallocate memory for efficiency
+
+    // Loop through each RGB565 image in the input span
+    for (const auto& rgb565_image : rgb565_images) {
+        rgb888_images.push_back(std::move(convert_rgb565_to_rgb888(rgb565_image)));  // Move the image into the vector
+    }
+
+    return rgb888_images;
+}
+
+cv::Mat load_binary_image(const std::string& filename, bool saveImage) {
+    TRACE_SCOPE("load_binary_image");
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return cv::Mat();
+    }
+
+    // Read binary data
+    // std::vector<uint8_t> buffer(IMG_SIZE);
+    uint8_t buffer[IMG_SIZE];
+    file.read(reinterpret_cast<char*>(buffer), IMG_SIZE);
+    file.close();
+
+    if (file.gcount() != IMG_SIZE) {
+        std::cerr << "Error: Read only " << file.gcount() << " bytes instead of " << IMG_SIZE << std::endl;
+        return cv::Mat();
+    }
+
+    // The camera stores each pixel high byte first
+    cv::Mat image(IMG_ROWS, IMG_COLS, FRAME_TYPE);
+    for (int row = 0; row < IMG_ROWS; ++row) {
+        const uint8_t* src = buffer + row * IMG_COLS * 2;
+        uint16_t* dst = image.ptr<uint16_t>(row);
+        for (int col = 0; col < IMG_COLS; ++col) {
+            dst[col] = (static_cast<uint16_t>(src[2 * col]) << 8) | src[2 * col + 1];
+        }
+    }
+
+    if (saveImage) {
+        TRACE_SCOPE("savePng");
+        auto rgb888image = convert_rgb565_to_rgb888(image);
+        cv::imwrite(binary_png_path(filename), rgb888image);
+    }
+
+    return image;
+}
+
+std::vector<cv::Mat> load_binary_images(std::span<const std::string> filenames, bool save_images) {
+    std::vector<cv::Mat> images;
+    images.reserve(filenames.size());  // Preallocate memory for efficiency
+
+    for (const auto& filename : filenames) {
+        cv::Mat image = load_binary_image(filename, save_images);
+        if (image.empty()) {
+            throw std::runtime_error("Failed to load image: " + filename);
+        }
+        images.push_back(std::move(image));  // Move the matrix into the vector
+    }
+
+    return images;
+}
+
+cv::Mat load_compact_hex_image(const std::string& filename, bool saveImage) {
+    TRACE_SCOPE("load_compact_hex_image");
+
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return cv::Mat();
+    }
+
+    // The firmware prints each pixel as a little endian word of the camera's high byte first data,
+    // so the decoder swaps the bytes back into a native RGB565 value
+    const Kernels::KernelTable& kernels = Kernels::active();
+    std::vector<uint16_t> pixels;
+    pixels.reserve(96*96);
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t words = line.size() / 4;
+        const size_t offset = pixels.size();
+        pixels.resize(offset + words);
+
+        if (!kernels.decodeHex(line.data(), words, pixels.data() + offset)) {
+            std::cerr << "Error: Invalid hex value in " << filename << std::endl;
+            return cv::Mat();
+        }
+    }
+
+    if (pixels.size() < IMG_ROWS * IMG_COLS) {
+        std::cerr << "Error: Read only " << pixels.size() << " pixels instead of " << IMG_ROWS * IMG_COLS << std::endl;
+        return cv::Mat();
+    }
+
+    cv::Mat image(IMG_ROWS, IMG_COLS, FRAME_TYPE);
+    std::copy_n(pixels.begin(), IMG_ROWS * IMG_COLS, image.ptr<uint16_t>());
+
+    if (saveImage) {
+        TRACE_SCOPE("savePng");
+        auto rgb888image = convert_rgb565_to_rgb888(image);
+        cv::imwrite(compact_hex_png_path(filename), rgb888image);
+    }
+
+    return image;
+}
+
+std::vector<cv::Mat> load_compact_hex_images(std::span<const std::string> filenames, bool save_images) {
+    std::vector<cv::Mat> images;
+    images.reserve(filenames.size());  // Preallocate memory for efficiency
+
+    for (const auto& filename : filenames) {
+        cv::Mat image = load_compact_hex_image(filename, save_images);
+        if (image.empty()) {
+            throw std::runtime_error("Failed to load image: " + filename);
+        }
+        images.push_back(std::move(image));  // Move the matrix into the vector
+    }
+
+    return images;
+}
+
+std::string encode_binary_image(std::span<const uint16_t> pixels) {
+    std::string bytes(IMG_SIZE, '\0');
+    for (size_t i = 0; i < IMG_SIZE / 2; ++i) {
+        bytes[2 * i] = static_cast<char>(pixels[i] >> 8);
+        bytes[2 * i + 1] = static_cast<char>(pixels[i] & 0xFF);
+    }
+    return bytes;
+}
+
+std::string encode_compact_hex_image(std::span<const uint16_t> pixels) {
+    // The firmware prints the camera's high byte first data as little endian words, so the low byte comes first
+    constexpr char DIGITS[] = "0123456789ABCDEF";
+    constexpr size_t LINE_LENGTH = IMG_COLS * 4 + 1;
+
+    std::string text(IMG_ROWS * LINE_LENGTH, '\n');
+    for (int y = 0; y < IMG_ROWS; ++y) {
+        char* line = text.data() + y * LINE_LENGTH;
+        for (int x = 0; x < IMG_COLS; ++x) {
+            const uint16_t pixel = pixels[y * IMG_COLS + x];
+            line[4 * x] = DIGITS[(pixel >> 4) & 0xF];
+            line[4 * x + 1] = DIGITS[pixel & 0xF];
+            line[4 * x + 2] = DIGITS[(pixel >> 12) & 0xF];
+            line[4 * x + 3] = DIGITS[(pixel >> 8) & 0xF];
+        }
+    }
+    return text;
+}
+
+std::string binary_png_path(const std::string& filename) {
+    return filename + std::string(".png");
+}
+
+std::string compact_hex_png_path(const std::string& filename) {
+    return filename.substr(0, filename.size() - 4) + std::string(".png");
+}
+
+std::vector<std::string> get_filenames_in_dir(const std::string& directory_path, std::span<std::string> extensions) {
+    std::vector<std::string> filenames;
+
+    try {
+        for (const auto& entry : fs::directory_iterator(directory_path)) {
+            if (entry.is_regular_file()) {
+                const std::string& filename = entry.path().filename().string();
+                if (extensions.empty() || std::any_of(extensions.begin(), extensions.end(), [&](const std::string& ext) {
+                    return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+                })) { 
+                    filenames.push_back(entry.path().string()); 
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading directory: " << e.what() << std::endl;
+    }
+
+    return filenames;
+}
@@ -0,0 +1,541 @@
+#include "ingest.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <map>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr uint64_t LISTEN_ID = 0;
+    constexpr uint64_t WAKE_ID = 1;
+    constexpr uint64_t FIRST_CONNECTION_ID = 2;
+
+    constexpr size_t READ_CHUNK = 64 * 1024;
+    constexpr size_t MAX_OUTPUT = 1024 * 1024;  ///< Stop reading from a robot that is not reading its results
+    constexpr size_t PIXELS = IMG_ROWS * IMG_COLS;
+    constexpr size_t MAX_LINE = 2 * IMG_COLS * 4 + 2;    ///< Longest hex line the parser accepts, two rows and a CRLF
+
+    bool setNonBlocking(const int fd)
+    {
+        const int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+}
+
+/**
+ * @brief State of one robot's connection. Only touched by the event loop thread.
+ *
+ */
+struct Ingest::Server::Connection {
+    uint64_t id = 0;
+    int fd = -1;
+
+    bool handshake = false;
+    Encoding encoding = Encoding::RAW;
+
+    std::string input;                      ///< Received bytes that have not been parsed into frames yet
+    std::vector<uint16_t> hexPixels;        ///< Pixels of the hex frame being received
+
+    uint64_t nextSeq = 0;                   ///< Seq of the next frame received
+    uint64_t nextToSend = 0;                ///< Seq of the next result to send
+    size_t inFlight = 0;                    ///< Frames queued or being processed
+    std::map<uint64_t, FrameResult> done;   ///< Results waiting for an earlier frame to finish
+
+    std::string output;                     ///< Result lines not yet written to the socket
+
+    bool peerClosed = false;                ///< The robot shut down its sending side
+    bool failed = false;                    ///< Protocol error, close once the error line is written
+    uint32_t events = 0;                    ///< The epoll events currently registered
+};
+
+std::string Ingest::formatResult(const FrameResult& result)
+{
+    return fmt::format("{},{},{},{},{}\n", result.seq, result.stop ? 1 : 0, result.white ? 1 : 0, result.dist, result.redPercent);
+}
+
+bool Ingest::parseResult(std::string_view line, FrameResult& result)
+{
+    int64_t fields[5];
+    const char* pos = line.data();
+    const char* end = line.data() + line.size();
+
+    for (int i = 0; i < 5; ++i) {
+        auto [ptr, ec] = std::from_chars(pos, end, fields[i]);
+        if (ec != std::errc()) return false;
+        if (i < 4 && (ptr == end || *ptr != ',')) return false;
+        pos = ptr + 1;
+    }
+
+    result.seq = fields[0];
+    result.stop = fields[1] != 0;
+    result.white = fields[2] != 0;
+    result.dist = static_cast<int8_t>(fields[3]);
+    result.redPercent = static_cast<uint16_t>(fields[4]);
+    return true;
+}
+
+Ingest::FrameResult Ingest::detect(std::span<const uint16_t> frame, const MicroCV2::Core::Config& cfg)
+{
+    using namespace MicroCV2;
+
+    thread_local Core::Workspace workspace;
+    thread_local std::vector<uint8_t> mask(Core::MAX_PIXELS);
+
+    FrameResult result;
+    const Core::BoxResult red = Core::processRed(frame, IMG_COLS, IMG_ROWS, mask, cfg);
+    const Core::WhiteResult white = Core::processWhite(frame, IMG_COLS, IMG_ROWS, mask, workspace, cfg);
+
+    result.stop = red.detected;
+    result.redPercent = red.percent;
+    result.white = white.detected;
+    result.dist = white.detected ? white.line.dist : 0;
+    result.blobArea = white.blob.found ? white.blob.area2 / 2.0f : 0.0f;
+    return result;
+}
+
+Ingest::Server::Server(const ServerOptions& options) : m_options(options), m_nextId(FIRST_CONNECTION_ID) {}
+
+Ingest::Server::~Server()
+{
+    {
+        std::lock_guard lock(m_jobMutex);
+        m_stoppingWorkers = true;
+        m_jobs.clear();
+    }
+    m_jobAvailable.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+
+    for (auto& [id, connection] : m_connections) {
+        ::close(connection->fd);
+    }
+    if (m_listenFd >= 0) ::close(m_listenFd);
+    if (m_wakeFd >= 0) ::close(m_wakeFd);
+    if (m_epollFd >= 0) ::close(m_epollFd);
+}
+
+bool Ingest::Server::listen()
+{
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenFd < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    const int reuse = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_options.port);
+    if (inet_pton(AF_INET, m_options.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Error: Invalid listen address " << m_options.host << std::endl;
+        return false;
+    }
+
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Could not listen on " << m_options.host << ":" << m_options.port << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    setNonBlocking(m_listenFd);
+
+    if (!m_options.ring.empty()) {
+        m_ring = std::make_unique<FrameRing::Producer>();
+        if (!m_ring->create(m_options.ring, m_options.ringSlots)) return false;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+
+    m_epollFd = epoll_create1(0);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK);
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        std::cerr << "Error: Could not create the event loop: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_ID;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+    event.data.u64 = WAKE_ID;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+    unsigned int numThreads = m_options.workers;
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_workers.reserve(numThreads);
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        m_workers.emplace_back(&Server::workerLoop, this);
+    }
+
+    m_running = true;
+    return true;
+}
+
+void Ingest::Server::run()
+{
+    epoll_event events[64];
+
+    while (m_running) {
+        const int count = epoll_wait(m_epollFd, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const uint64_t id = events[i].data.u64;
+
+            if (id == LISTEN_ID) {
+                acceptConnections();
+                continue;
+            }
+            if (id == WAKE_ID) {
+                uint64_t counter;
+                while (read(m_wakeFd, &counter, sizeof(counter)) > 0) {}
+                drainCompletions();
+                continue;
+            }
+
+            // An earlier event in this batch may already have closed the connection
+            auto it = m_connections.find(id);
+            if (it == m_connections.end()) continue;
+            Connection& connection = *it->second;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close(id);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) readFrom(connection);
+            if (m_connections.contains(id) && (events[i].events & EPOLLOUT)) writeTo(connection);
+        }
+    }
+}
+
+void Ingest::Server::stop()
+{
+    m_running = false;
+
+    const uint64_t one = 1;
+    [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+}
+
+Ingest::ServerStats Ingest::Server::stats() const
+{
+    return {m_accepted.load(), m_frames.load(), m_bytesIn.load(), m_throttled.load()};
+}
+
+void Ingest::Server::workerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(m_jobMutex);
+            m_jobAvailable.wait(lock, [this] { return m_stoppingWorkers || !m_jobs.empty(); });
+            if (m_stoppingWorkers) return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        Completion completion;
+        completion.connection = job.connection;
+        {
+            TRACE_SCOPE("Ingest::detect");
+            completion.result = detect(job.pixels, m_options.config);
+        }
+        completion.result.seq = job.seq;
+        if (m_ring) completion.pixels = std::move(job.pixels);
+
+        {
+            std::lock_guard lock(m_completionMutex);
+            m_completions.push_back(std::move(completion));
+        }
+
+        const uint64_t one = 1;
+        [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+    }
+}
+
+void Ingest::Server::acceptConnections()
+{
+    while (true) {
+        const int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        setNonBlocking(fd);
+        const int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        auto connection = std::make_unique<Connection>();
+        connection->id = m_nextId++;
+        connection->fd = fd;
+        connection->hexPixels.reserve(PIXELS);
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = connection->id;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+        connection->events = EPOLLIN;
+
+        m_accepted++;
+        m_connections.emplace(connection->id, std::move(connection));
+    }
+}
+
+void Ingest::Server::readFrom(Connection& connection)
+{
+    char buffer[READ_CHUNK];
+    const ssize_t bytes = recv(connection.fd, buffer, sizeof(buffer), 0);
+
+    if (bytes < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+        close(connection.id);
+        return;
+    }
+
+    if (bytes == 0) {
+        // A partial frame at the end of the stream is dropped
+        connection.peerClosed = true;
+    } else {
+        m_bytesIn += bytes;
+        connection.input.append(buffer, bytes);
+        parseFrames(connection);
+    }
+
+    if (finished(connection)) {
+        close(connection.id);
+        return;
+    }
+    updateEvents(connection);
+}
+
+void Ingest::Server::parseFrames(Connection& connection)
+{
+    size_t pos = 0;
+    std::string_view input = connection.input;
+
+    if (!connection.handshake) {
+        const size_t newline = input.find('\n');
+        if (newline == std::string_view::npos) {
+            if (input.size() > MAX_LINE) failLongLine(connection);
+            return;
+        }
+
+        std::string_view line = input.substr(0, newline);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (line == HANDSHAKE_RAW) {
+            connection.encoding = Encoding::RAW;
+        } else if (line == HANDSHAKE_HEX) {
+            connection.encoding = Encoding::HEX;
+        } else {
+            connection.output += "ERROR unknown handshake\n";
+            connection.failed = true;
+            connection.input.clear();
+            return;
+        }
+        connection.handshake = true;
+        pos = newline + 1;
+    }
+
+    // Stop parsing once the connection has as many frames in flight as it may, the rest waits in the buffer
+    if (connection.encoding == Encoding::RAW) {
+        while (connection.inFlight < m_options.maxInFlight && input.size() - pos >= IMG_SIZE) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(input.data() + pos);
+
+            std::vector<uint16_t> pixels(PIXELS);
+            for (size_t i = 0; i < PIXELS; ++i) {
+                pixels[i] = (static_cast<uint16_t>(bytes[2 * i]) << 8) | bytes[2 * i + 1];
+            }
+            submit(connection, std::move(pixels));
+            pos += IMG_SIZE;
+        }
+    } else {
+        const Kernels::KernelTable& kernels = Kernels::active();
+        uint16_t words[IMG_COLS * 2];
+
+        while (connection.inFlight < m_options.maxInFlight) {
+            const size_t newline = input.find('\n', pos);
+            if (newline == std::string_view::npos) {
+                // Reading pauses once the buffer is full, so a line that never ends would stall the connection
+                if (input.size() - pos > MAX_LINE) {
+                    failLongLine(connection);
+                    return;
+                }
+                break;
+            }
+
+            std::string_view line = input.substr(pos, newline - pos);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            pos = newline + 1;
+
+            // Anything that is not a row of hex pixels is a log line, skip it
+            const size_t count = line.size() / 4;
+            if (count == 0 || count > std::size(words) || !kernels.decodeHex(line.data(), count, words)) continue;
+
+            for (size_t i = 0; i < count; ++i) {
+                connection.hexPixels.push_back(words[i]);
+                if (connection.hexPixels.size() == PIXELS) {
+                    std::vector<uint16_t> pixels;
+                    pixels.reserve(PIXELS);
+                    std::swap(pixels, connection.hexPixels);
+                    submit(connection, std::move(pixels));
+                }
+            }
+        }
+    }
+
+    connection.input.erase(0, pos);
+}
+
+void Ingest::Server::failLongLine(Connection& connection)
+{
+    connection.output += "ERROR line too long\n";
+    connection.failed = true;
+    connection.input.clear();
+}
+
+void Ingest::Server::submit(Connection& connection, std::vector<uint16_t>&& pixels)
+{
+    {
+        std::lock_guard lock(m_jobMutex);
+        m_jobs.push_back({connection.id, connection.nextSeq++, std::move(pixels)});
+    }
+    connection.inFlight++;
+    m_jobAvailable.notify_one();
+
+    if (connection.inFlight == m_options.maxInFlight) {
+        m_throttled++;
+    }
+}
+
+void Ingest::Server::writeTo(Connection& connection)
+{
+    while (!connection.output.empty()) {
+        const ssize_t bytes = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (bytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            close(connection.id);
+            return;
+        }
+        connection.output.erase(0, bytes);
+    }
+
+    if (finished(connection)) {
+        close(connection.id);
+        return;
+    }
+    updateEvents(connection);
+}
+
+void Ingest::Server::drainCompletions()
+{
+    std::vector<Completion> completions;
+    {
+        std::lock_guard lock(m_completionMutex);
+        std::swap(completions, m_completions);
+    }
+
+    std::vector<uint64_t> touched;
+    for (const Completion& completion : completions) {
+        if (m_ring) {
+            const FrameResult& result = completion.result;
+            const FrameRing::Detection detection = {result.stop, result.white, result.dist, 0, result.redPercent, 0, result.blobArea};
+            m_ring->publish(completion.pixels, completion.connection, result.seq, &detection);
+        }
+
+        auto it = m_connections.find(completion.connection);
+        if (it == m_connections.end()) continue;    // The robot disconnected before its result was ready
+        Connection& connection = *it->second;
+
+        connection.inFlight--;
+        connection.done.emplace(completion.result.seq, completion.result);
+        m_frames++;
+
+        // Send results in frame order
+        while (!connection.done.empty() && connection.done.begin()->first == connection.nextToSend) {
+            connection.output += formatResult(connection.done.begin()->second);
+            connection.done.erase(connection.done.begin());
+            connection.nextToSend++;
+        }
+        touched.push_back(connection.id);
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (const uint64_t id : touched) {
+        auto it = m_connections.find(id);
+        if (it == m_connections.end()) continue;
+
+        // Frames that were held back by the in-flight limit can be queued now
+        parseFrames(*it->second);
+        if (m_connections.contains(id)) writeTo(*it->second);
+    }
+}
+
+void Ingest::Server::updateEvents(Connection& connection)
+{
+    // Reading is paused while the connection is at its in-flight limit or the robot is not reading its results
+    uint32_t events = 0;
+    if (!connection.peerClosed && !connection.failed && connection.inFlight < m_options.maxInFlight
+        && connection.output.size() < MAX_OUTPUT && connection.input.size() < 2 * IMG_SIZE) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+
+    if (events == connection.events) return;
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = connection.id;
+    epoll_ctl(m_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+bool Ingest::Server::finished(const Connection& connection) const
+{
+    if (!connection.output.empty()) return false;
+    if (connection.failed) return true;
+    return connection.peerClosed && connection.inFlight == 0;
+}
+
+void Ingest::Server::close(uint64_t id)
+{
+    auto it = m_connections.find(id);
+    if (it == m_connections.end()) return;
+
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, it->second->fd, nullptr);
+    ::close(it->second->fd);
+    m_connections.erase(it);
+}
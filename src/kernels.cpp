@@ -0,0 +1,226 @@
+#include "kernels_impl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#if defined(ESPVIEWER_X86_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Kernels::Detail {
+#if defined(ESPVIEWER_X86_KERNELS)
+    extern const KernelTable SSE42_TABLE;
+    extern const KernelTable AVX2_TABLE;
+    extern const KernelTable AVX512_TABLE;
+#endif
+}
+
+namespace {
+
+    // Built with the baseline flags of the rest of the project
+    constexpr Kernels::KernelTable SCALAR_TABLE = makeTable("scalar", Kernels::Isa::SCALAR);
+
+    struct CpuFeatures {
+        bool sse42 = false;
+        bool avx2 = false;
+        bool avx512 = false;    ///< AVX-512 F, BW, and VL
+    };
+
+    CpuFeatures detectCpu()
+    {
+        CpuFeatures features;
+
+#if defined(ESPVIEWER_X86_KERNELS) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        features.sse42 = (info[2] & (1 << 20)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        // The OS has to save the YMM and ZMM registers on a context switch too
+        const uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool ymmState = (xcr0 & 0x06) == 0x06;
+        const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+        if (maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            features.avx2 = avx && ymmState && (info[1] & (1 << 5)) != 0;
+            features.avx512 = zmmState && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0
+                           && (info[1] & (1 << 31)) != 0;
+        }
+#elif defined(ESPVIEWER_X86_KERNELS)
+        __builtin_cpu_init();
+        features.sse42 = __builtin_cpu_supports("sse4.2");
+        features.avx2 = __builtin_cpu_supports("avx2");
+        features.avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                       && __builtin_cpu_supports("avx512vl");
+#endif
+
+        return features;
+    }
+
+    const CpuFeatures& cpu()
+    {
+        static const CpuFeatures features = detectCpu();
+        return features;
+    }
+
+    /**
+     * @brief Time a kernel call, keeping the fastest of a few rounds to ignore scheduling noise
+     *
+     */
+    template <typename Fn>
+    uint64_t timeKernel(Fn&& fn)
+    {
+        constexpr int ROUNDS = 5;
+        constexpr int REPEATS = 20;
+
+        uint64_t best = UINT64_MAX;
+        for (int round = 0; round < ROUNDS; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < REPEATS; ++i) {
+                fn();
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            best = std::min<uint64_t>(best, ns);
+        }
+        return best;
+    }
+
+    /**
+     * @brief Pick the fastest table for one operation and copy its function pointer into the result
+     *
+     */
+    template <typename Member, typename Fn>
+    void pickFastest(Kernels::KernelTable& result, Member member, Fn&& run)
+    {
+        uint64_t best = UINT64_MAX;
+        for (const Kernels::KernelTable* candidate : Kernels::supportedTables()) {
+            uint64_t ns = timeKernel([&] { run(candidate->*member); });
+            if (ns < best) {
+                best = ns;
+                result.*member = candidate->*member;
+            }
+        }
+    }
+
+}
+
+const char* Kernels::isaName(const Isa isa)
+{
+    switch (isa) {
+        case Isa::SCALAR: return "scalar";
+        case Isa::SSE42: return "sse4.2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool Kernels::isSupported(const Isa isa)
+{
+    switch (isa) {
+        case Isa::SCALAR: return true;
+        case Isa::SSE42: return cpu().sse42;
+        case Isa::AVX2: return cpu().avx2;
+        case Isa::AVX512: return cpu().avx512;
+        default: return false;
+    }
+}
+
+const Kernels::KernelTable* Kernels::table(const Isa isa)
+{
+    switch (isa) {
+        case Isa::SCALAR: return &SCALAR_TABLE;
+#if defined(ESPVIEWER_X86_KERNELS)
+        case Isa::SSE42: return &Detail::SSE42_TABLE;
+        case Isa::AVX2: return &Detail::AVX2_TABLE;
+        case Isa::AVX512: return &Detail::AVX512_TABLE;
+#endif
+        default: return nullptr;
+    }
+}
+
+std::span<const Kernels::KernelTable* const> Kernels::supportedTables()
+{
+    static const std::vector<const KernelTable*> tables = [] {
+        std::vector<const KernelTable*> result;
+        for (uint8_t i = 0; i < static_cast<uint8_t>(Isa::COUNT); ++i) {
+            const Isa isa = static_cast<Isa>(i);
+            if (table(isa) != nullptr && isSupported(isa)) {
+                result.push_back(table(isa));
+            }
+        }
+        return result;
+    }();
+    return tables;
+}
+
+Kernels::KernelTable Kernels::calibrate()
+{
+    constexpr size_t PIXELS = IMG_ROWS * IMG_COLS;
+
+    // A deterministic frame with a mix of every colour class
+    std::vector<uint16_t> frame(PIXELS);
+    uint32_t state = 0x12345678;
+    for (auto& pixel : frame) {
+        state = state * 1664525 + 1013904223;
+        pixel = static_cast<uint16_t>(state >> 16);
+    }
+
+    std::vector<uint8_t> mask(PIXELS), bgr(PIXELS * 3), layered(PIXELS * 3);
+    std::vector<char> hex(PIXELS * 4);
+    for (size_t i = 0; i < hex.size(); ++i) {
+        hex[i] = "0123456789abcdef"[(frame[i / 4] >> (4 * (i % 4))) & 0xF];
+    }
+    std::vector<uint16_t> decoded(PIXELS);
+    const MicroCV2::Core::Config& cfg = MicroCV2::Core::DEFAULT_CONFIG;
+    const uint8_t color[3] = {255, 0, 0};
+
+    KernelTable result = *supportedTables().back();
+    result.name = "calibrated";
+
+    auto classify = [&](ClassifyFn fn) { fn(frame.data(), mask.data(), static_cast<int>(PIXELS), cfg); };
+    pickFastest(result, &KernelTable::classifyStop, classify);
+    pickFastest(result, &KernelTable::classifyWhite, classify);
+    pickFastest(result, &KernelTable::classifyCar, classify);
+    pickFastest(result, &KernelTable::rgb565ToBgr888, [&](ConvertFn fn) { fn(frame.data(), bgr.data(), PIXELS); });
+    pickFastest(result, &KernelTable::colorizeMask, [&](ColorizeFn fn) { fn(mask.data(), bgr.data(), PIXELS, color); });
+    pickFastest(result, &KernelTable::layerMask, [&](LayerFn fn) { fn(layered.data(), bgr.data(), PIXELS); });
+    pickFastest(result, &KernelTable::decodeHex, [&](DecodeHexFn fn) { fn(hex.data(), PIXELS, decoded.data()); });
+
+    return result;
+}
+
+const Kernels::KernelTable& Kernels::active()
+{
+    static const KernelTable selected = [] {
+        const char* env = std::getenv(ENV_VAR);
+        const std::string_view request = env != nullptr ? env : "auto";
+
+        if (request == "calibrate") return calibrate();
+
+        if (request != "auto") {
+            for (uint8_t i = 0; i < static_cast<uint8_t>(Isa::COUNT); ++i) {
+                const Isa isa = static_cast<Isa>(i);
+                if (request != isaName(isa)) continue;
+
+                if (table(isa) != nullptr && isSupported(isa)) return *table(isa);
+                std::cerr << "Warning: " << ENV_VAR << "=" << request << " is not supported here, using auto" << std::endl;
+                return *supportedTables().back();
+            }
+            std::cerr << "Warning: Unknown " << ENV_VAR << " value " << request << ", using auto" << std::endl;
+        }
+
+        return *supportedTables().back();
+    }();
+    return selected;
+}
@@ -0,0 +1,7 @@
+#include "kernels_impl.hpp"
+
+// Compiled with the avx2 code generation flags, see CMakeLists.txt
+namespace Kernels::Detail {
+    extern const KernelTable AVX2_TABLE;
+    const KernelTable AVX2_TABLE = makeTable("avx2", Isa::AVX2);
+}
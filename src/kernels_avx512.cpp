@@ -0,0 +1,7 @@
+#include "kernels_impl.hpp"
+
+// Compiled with the avx512 code generation flags, see CMakeLists.txt
+namespace Kernels::Detail {
+    extern const KernelTable AVX512_TABLE;
+    const KernelTable AVX512_TABLE = makeTable("avx512", Isa::AVX512);
+}
@@ -0,0 +1,7 @@
+#include "kernels_impl.hpp"
+
+// Compiled with the sse4.2 code generation flags, see CMakeLists.txt
+namespace Kernels::Detail {
+    extern const KernelTable SSE42_TABLE;
+    const KernelTable SSE42_TABLE = makeTable("sse4.2", Isa::SSE42);
+}
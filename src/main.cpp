@@ -1,251 +1,46 @@
+#include "batch.hpp"
+#include "cli.hpp"
+#include "dedup.hpp"
+#include "image_io.hpp"
 #include "microcv2.hpp"
+#include "playback.hpp"
+#include "png_export.hpp"
 #include "opencv2.hpp"
 #include <fmt/core.h>
 #include "qt5.hpp"
+#include "trace.hpp"
 #include <fstream>
+#include <iostream>
 #include <qapplication.h>
 #include <string>
 #include <type_traits>
 #include <vector>
+#include <algorithm>
 #include <array>
 #include <filesystem>
+#include <map>
 #include <span>
 
 namespace fs = std::filesystem;
 
 /**
- * @brief Convert an RGB888 color to a 16-bit RGB565 color.
+ * @brief Keeps the intermediates of one detector pass for the presentation images
  * 
- * @param r - The red value
- * @param g - The green value
- * @param b - the blue value
- * @return constexpr uint16_t - The RGB565 color 
  */
-constexpr uint16_t RGB888toRGB565(const uint8_t r, const uint8_t g, const uint8_t b) {
-    uint16_t red = (r * 31) / 255;
-    uint16_t green = (g * 63) / 255;
-    uint16_t blue = (b * 31) / 255;
-
-    return (red << 11) | (green << 5) | blue;
-}
-
-/**
- * @brief Convert an RGB565 color to an RGB888 color.
- * 
- * @param pixel - The encoded RGB565 color
- * @return std::array<uint8_t, 3> - Red, green, and blue values
- */
-constexpr std::array<uint8_t, 3> RGB565toRGB888(const uint16_t pixel) {
-    // Extract individual color components (5-bit Red, 6-bit Green, 5-bit Blue)
-    uint8_t r = (pixel >> 11) & 0x1F;  // Extract red (5 bits)
-    uint8_t g = (pixel >> 5) & 0x3F;   // Extract green (6 bits)
-    uint8_t b = pixel & 0x1F;          // Extract blue (5 bits)
-
-    // Scale the components to 0-255 range
-    uint8_t red = (r * 255) / 31;  // Scale red from 5 bits to 8 bits
-    uint8_t green = (g * 255) / 63;  // Scale green from 6 bits to 8 bits
-    uint8_t blue = (b * 255) / 31;  // Scale blue from 5 bits to 8 bits
-
-    return {red, green, blue};
-}
-
-/**
- * @brief Convert an CV_8UC2 opencv matrix of RGB565 to a CV_8UC3 opencv matrix of RGB888
- * 
- * @param rgb565_image - The CV_8UC2 opencv matrix of RGB565
- * @return cv::Mat - The CV_8UC3 opencv matrix of RGB888
- */
-cv::Mat convert_rgb565_to_rgb888(const cv::Mat rgb565_image) {
-    cv::Mat rgb888_image(rgb565_image.rows, rgb565_image.cols, CV_8UC3);  // RGB888 output image
-
-    // Loop through each pixel in the RGB565 image
-    for (int row = 0; row < rgb565_image.rows; ++row) {
-        for (int col = 0; col < rgb565_image.cols; ++col) {
-            // Get the RGB565 pixel (2 bytes per pixel)
-            cv::Vec2b vecpixel = rgb565_image.at<cv::Vec2b>(row, col);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
-            auto rgb = RGB565toRGB888(pixel);
-
-            // Set the RGB888 pixel in the output image
-            rgb888_image.at<cv::Vec3b>(row, col) = cv::Vec3b(rgb[2], rgb[1], rgb[0]);  // OpenCV uses BGR order
-        }
-    }
-
-    return rgb888_image;
-}
-
-/**
- * @brief Vectorized version of convert_rgb565_to_rgb888. Converts an entire span of RGB565 images to RGB888.
- * 
- * @overload
- * @param rgb565_images - A span of CV_8UC2 opencv matrices of RGB565
- * @return std::vector<cv::Mat> - A vector of CV_8UC3 opencv matrices of RGB888
- */
-std::vector<cv::Mat> convert_rgb565_to_rgb888(std::span<const cv::Mat> rgb565_images) {
-    std::vector<cv::Mat> rgb888_images;
-    rgb888_images.reserve(rgb565_images.size());  // Preallocate memory for efficiency
-
-    // Loop through each RGB565 image in the input span
-    for (const auto& rgb565_image : rgb565_images) {
-        rgb888_images.push_back(std::move(convert_rgb565_to_rgb888(rgb565_image)));  // Move the image into the vector
-    }
-
-    return rgb888_images;
-}
-
-/**
- * @brief Load a raw binary image file into an CV_8UC2 opencv matrix
- * 
- * @param filename - The filepath to the binary file
- * @param saveImage - Whether to save the image as a PNG
- * @return cv::Mat - The CV_8UC2 opencv matrix image
- */
-cv::Mat load_binary_image(const std::string& filename, bool saveImage = false) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        return cv::Mat();
-    }
-
-    // Read binary data
-    // std::vector<uint8_t> buffer(IMG_SIZE);
-    uint8_t buffer[IMG_SIZE];
-    file.read(reinterpret_cast<char*>(buffer), IMG_SIZE);
-    file.close();
-
-    if (file.gcount() != IMG_SIZE) {
-        std::cerr << "Error: Read only " << file.gcount() << " bytes instead of " << IMG_SIZE << std::endl;
-        return cv::Mat();
-    }
-
-    // Convert buffer into cv::Mat
-    cv::Mat image(IMG_ROWS, IMG_COLS, CV_8UC2, buffer);
-
-    if (saveImage) {
-        auto rgb888image = convert_rgb565_to_rgb888(image);
-        cv::imwrite(filename + std::string(".png"), rgb888image);
-    }
-
-    // Make a deep copy to ensure it remains valid after buffer goes out of scope
-    return image.clone();
-}
-
-/**
- * @brief Vectorized version of load_binary_image. Loads an entire span of binary images into CV_8UC2 opencv matrices.
- * 
- * @param filenames - The filepaths to the binary files
- * @param save_images - Whether to save the images as PNGs
- * @return std::vector<cv::Mat> - A vector of CV_8UC2 opencv matrices
- */
-std::vector<cv::Mat> load_binary_images(std::span<const std::string> filenames, bool save_images = false) {
-    std::vector<cv::Mat> images;
-    images.reserve(filenames.size());  // Preallocate memory for efficiency
-
-    for (const auto& filename : filenames) {
-        cv::Mat image = load_binary_image(filename, save_images);
-        if (image.empty()) {
-            throw std::runtime_error("Failed to load image: " + filename);
-        }
-        images.push_back(std::move(image));  // Move the matrix into the vector
-    }
-
-    return images;
-}
-
-/**
- * @brief Load an image file saved in the compact hex format into an CV_8UC2 opencv matrix
- * 
- * @param filename - The filepath to the hex file
- * @param saveImage - Whether to save the image as a PNG
- * @return cv::Mat - The CV_8UC2 opencv matrix image
- */
-cv::Mat load_compact_hex_image(const std::string& filename, bool saveImage = false) {
-    std::ifstream file(filename);
-    if (!file) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        return cv::Mat();
-    }
-
-    std::vector<uint16_t> hexNumbers;
-    hexNumbers.reserve(96*96);
-
-    std::string line;
-    while (std::getline(file, line)) {
-        for (size_t i = 0; i < line.size(); i += 4) {
-            std::string hexStr = line.substr(i, 4);
-            uint16_t value = static_cast<uint16_t>(std::stoul(hexStr, nullptr, 16));
-            hexNumbers.push_back(value);
-        }
-    }
-
-    cv::Mat image(IMG_ROWS, IMG_COLS, CV_8UC2);
-
-    for (int i = 0; i < IMG_ROWS; i++) {
-        for (int j = 0; j < IMG_COLS; j++) {
-            uint16_t value = hexNumbers[i * IMG_COLS + j];
-            image.at<cv::Vec2b>(i, j) = cv::Vec2b(static_cast<uint8_t>(value & 0xFF), static_cast<uint8_t>((value >> 8) & 0xFF));
-        }
-    }
-
-    if (saveImage) {
-        auto rgb888image = convert_rgb565_to_rgb888(image);
-        auto newfilename = filename.substr(0, filename.size() - 4) + std::string(".png");
-
-        cv::imwrite(newfilename, rgb888image);
-    }
-
-    return image;
-}
-
-/**
- * @brief Vectorized version of load_compact_hex_image. Loads an entire span of hex images into CV_8UC2 opencv matrices.
- * 
- * @param filenames - The filepaths to the hex files
- * @param save_images - Whether to save the images as PNGs
- * @return std::vector<cv::Mat> - A vector of CV_8UC2 opencv matrices
- */
-std::vector<cv::Mat> load_compact_hex_images(std::span<const std::string> filenames, bool save_images = false) {
-    std::vector<cv::Mat> images;
-    images.reserve(filenames.size());  // Preallocate memory for efficiency
-
-    for (const auto& filename : filenames) {
-        cv::Mat image = load_compact_hex_image(filename, save_images);
-        if (image.empty()) {
-            throw std::runtime_error("Failed to load image: " + filename);
-        }
-        images.push_back(std::move(image));  // Move the matrix into the vector
-    }
-
-    return images;
-}
-
-/**
- * @brief Get all of the filenames in a directory. Filters only files with the specified extensions if given.
- * 
- * @param directory_path - The path to the directory
- * @param extensions - The extensions to filter by. Will include all files if empty.
- * @return std::vector<std::string> - A vector of filepaths 
- */
-std::vector<std::string> get_filenames_in_dir(const std::string& directory_path, std::span<std::string> extensions = {}) {
-    std::vector<std::string> filenames;
-
-    try {
-        for (const auto& entry : fs::directory_iterator(directory_path)) {
-            if (entry.is_regular_file()) {
-                const std::string& filename = entry.path().filename().string();
-                if (extensions.empty() || std::any_of(extensions.begin(), extensions.end(), [&](const std::string& ext) {
-                    return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
-                })) { 
-                    filenames.push_back(entry.path().string()); 
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Error reading directory: " << e.what() << std::endl;
-    }
-
-    return filenames;
-}
+class PresentationTap : public MicroCV2::Tap::Sink {
+public:
+    std::map<MicroCV2::Tap::Stage, cv::Mat1b> masks;
+    MicroCV2::Core::BoxResult stopBox;
+    MicroCV2::Core::Blob blob;
+    MicroCV2::Core::LineFit line;
+    bool hasLine = false;
+
+    bool wants(MicroCV2::Tap::Stage) const override { return true; }    // The whole frame stages too
+    void onMask(MicroCV2::Tap::Stage stage, const cv::Mat1b& mask) override { masks[stage] = mask.clone(); }
+    void onStopBox(const MicroCV2::Core::BoxResult& result) override { stopBox = result; }
+    void onBlob(const MicroCV2::Core::Blob& found) override { blob = found; }
+    void onLine(const MicroCV2::Core::LineFit& fit) override { line = fit; hasLine = true; }
+};
 
 /**
  * @brief Function to generate intermediary steps of a white line image for presentation purposes
@@ -253,93 +48,52 @@ std::vector<std::string> get_filenames_in_dir(const std::string& directory_path,
  */
 void process_white_presentation_image()
 {
+    using MicroCV2::Tap::Stage;
+
     fs::path white_pre_path = "../presentation_images/0_white_preprocess.bin";
     
-    // Load the original image
+    // Load the original image and run the white line detector once, keeping every stage
     auto white_img = load_compact_hex_image(white_pre_path.string(), true);
 
-    // Filter the white pixels
-    cv::Mat white_processed = cv::Mat::zeros(white_img.size(), CV_8UC1);
-    for (uint8_t y = 0; y < white_img.rows; ++y) {
-        for (uint8_t x = 0; x < white_img.cols; ++x) {
-            cv::Vec2b vecpixel = white_img.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
+    PresentationTap tap;
+    cv::Mat1b wmask, center;
+    int8_t dist;
+    MicroCV2::Core::WhiteResult result;
+    MicroCV2::processWhiteImg(white_img, wmask, center, dist, MicroCV2::Core::DEFAULT_CONFIG, result, &tap);
 
-            auto [red, green, blue] = RGB565toRGB888(pixel);
+    // The white pixels of the whole frame
+    cv::imwrite("../presentation_images/1_white_filtered.png", MicroCV2::colorizeMask(tap.masks[Stage::WHITE_CLASSIFIED], {255,255,255}));
 
-            if (MicroCV2::isWhiteLine(red, green, blue)) {
-                white_processed.at<uchar>(y,x) = 255;
-            }
-        }
-    }
-    cv::imwrite("../presentation_images/1_white_filtered.png", MicroCV2::colorizeMask(white_processed, {255,255,255}));
-
-    // Crop the image
-    white_processed = cv::Mat::zeros(white_img.size(), CV_8UC1);
-    for (uint8_t y = Params::WHITE_VERTICAL_CROP; y < white_img.rows; ++y) {
-        for (uint8_t x = 0; x < Params::WHITE_HORIZONTAL_CROP; ++x) {
-            cv::Vec2b vecpixel = white_img.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
-
-            auto [red, green, blue] = RGB565toRGB888(pixel);
-
-            if (MicroCV2::isWhiteLine(red, green, blue)) {
-                white_processed.at<uchar>(y,x) = 255;
-            }
-        }
-    }
-    cv::Mat white_decorated = MicroCV2::colorizeMask(white_processed, {255,255,255});
+    // The white pixels inside the crop
+    cv::Mat white_decorated = MicroCV2::colorizeMask(tap.masks[Stage::WHITE_CROPPED], {255,255,255});
     cv::line(white_decorated, cv::Point(0, Params::WHITE_VERTICAL_CROP), cv::Point(white_decorated.cols - 1, Params::WHITE_VERTICAL_CROP), cv::Scalar(0,255,0), 1);
 
     cv::imwrite("../presentation_images/2_white_cropped.png", white_decorated);
 
-
-    // Contour and find slope of the side of the line
-    std::vector<contour_t> contours;
-    cv::findContours(white_processed, contours, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
-
-    // Sort the contours to put the largest at index 0
-    std::sort(contours.begin(), contours.end(), [](const contour_t& a, const contour_t& b) {
-            return cv::contourArea(a) > cv::contourArea(b);
-    });
-    
-    cv::Point bottomLeft = contours[0][0];
-    cv::Point leftTop = contours[0][0];
-
-    for (const auto& pt : contours[0]) {
-        // bottom left point
-        if (pt.y > bottomLeft.y || (bottomLeft.y == pt.y && pt.x < bottomLeft.x)) {
-            bottomLeft = pt;
-        }
-        // left top point
-        if (pt.x < leftTop.x || (pt.x == leftTop.x && pt.y < leftTop.y)) {
-            leftTop = pt;
-        }
+    if (!tap.hasLine) {
+        fmt::println("No white line found in {}", white_pre_path.string());
+        return;
     }
 
+    // The points of the largest blob the slope is fitted through
+    cv::Point leftTop(tap.blob.leftTop.x, tap.blob.leftTop.y);
+    cv::Point bottomLeft(tap.blob.bottomLeft.x, tap.blob.bottomLeft.y);
     cv::circle(white_decorated, leftTop, 3, cv::Scalar(255,0,255));
     cv::circle(white_decorated, bottomLeft, 3, cv::Scalar(255,0,255));
 
-    float slope = (float)(bottomLeft.y - leftTop.y) / (bottomLeft.x - leftTop.x);
-    float y_intercept = leftTop.y - slope * leftTop.x;
-
     int16_t p1_x, p1_y, p2_x, p2_y;         // points for drawing slope line
     p1_y = 0;
     p2_y = white_decorated.rows - 1;
-    p1_x = (p1_y - y_intercept) / slope;
-    p2_x = (p2_y - y_intercept) / slope;
+    p1_x = (p1_y - tap.line.yIntercept) / tap.line.slope;
+    p2_x = (p2_y - tap.line.yIntercept) / tap.line.slope;
     cv::line(white_decorated, cv::Point(p1_x, p1_y), cv::Point(p2_x, p2_y), cv::Scalar(0,0,255), 1);
 
     cv::imwrite("../presentation_images/3_white_slope.png", white_decorated);
 
 
-    // Find the intersection point
-    cv::Point intersectionPoint;        // Point where the slope line intersects the WHITE_CENTER_POS line
-    intersectionPoint.y = Params::WHITE_VERTICAL_CROP;
-    intersectionPoint.x = (intersectionPoint.y - y_intercept) / slope;
-
-    cv::line(white_decorated, cv::Point(20, 0), cv::Point(20, white_processed.rows - 1), cv::Scalar(255,255,0), 1);
-    cv::line(white_decorated, cv::Point(intersectionPoint.x, 0), cv::Point(intersectionPoint.x, white_processed.rows - 1), cv::Scalar(255,0,255), 1);
+    // Where the slope line crosses WHITE_VERTICAL_CROP, against the position the robot steers for
+    cv::line(white_decorated, cv::Point(Params::WHITE_CENTER_POS, 0), cv::Point(Params::WHITE_CENTER_POS, white_decorated.rows - 1), cv::Scalar(255,255,0), 1);
+    cv::line(white_decorated, cv::Point(tap.line.intersection.x, 0), cv::Point(tap.line.intersection.x, white_decorated.rows - 1), cv::Scalar(255,0,255), 1);
 
     cv::imwrite("../presentation_images/4_white_distance.png", white_decorated);
 }
@@ -350,54 +104,27 @@ void process_white_presentation_image()
  */
 void process_red_presentation_image()
 {
+    using MicroCV2::Tap::Stage;
+
     fs::path red_pre_path = "../presentation_images/0_red_preprocess.bin";
     
-    // Load the original image
+    // Load the original image and run the stop line detector once, keeping every stage
     auto red_img = load_compact_hex_image(red_pre_path.string(), true);
 
-    // Filter the white pixels
-    cv::Mat red_processed = cv::Mat::zeros(red_img.size(), CV_8UC1);
-    for (uint8_t y = 0; y < red_img.rows; ++y) {
-        for (uint8_t x = 0; x < red_img.cols; ++x) {
-            cv::Vec2b vecpixel = red_img.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
+    PresentationTap tap;
+    cv::Mat1b rmask;
+    MicroCV2::Core::BoxResult result;
+    MicroCV2::processRedImg(red_img, rmask, MicroCV2::Core::DEFAULT_CONFIG, result, &tap);
 
-            auto [red, green, blue] = RGB565toRGB888(pixel);
+    // The red pixels of the whole frame
+    cv::imwrite("../presentation_images/1_red_filtered.png", MicroCV2::colorizeMask(tap.masks[Stage::STOP_CLASSIFIED], {255,0,0}));
 
-            if (MicroCV2::isStopLine(red, green, blue) && !MicroCV2::isWhiteLine(red, green, blue)) {
-                red_processed.at<uchar>(y,x) = 255;
-            }
-        }
-    }
-    cv::imwrite("../presentation_images/1_red_filtered.png", MicroCV2::colorizeMask(red_processed, {255,0,0}));
-
-
-
-    // Crop the image
-    red_processed = cv::Mat::zeros(red_img.size(), CV_8UC1);
-    uint16_t redCount = 0;
-    for (uint8_t y = 0; y < red_img.rows; ++y) {
-        for (uint8_t x = 0; x < red_img.cols; ++x) {
-            cv::Vec2b vecpixel = red_img.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
-
-            auto [red, green, blue] = RGB565toRGB888(pixel);
-
-            if (MicroCV2::isStopLine(red, green, blue) && !MicroCV2::isWhiteLine(red, green, blue)) {
-                if (x >= Params::STOPBOX_TL.x && x <= Params::STOPBOX_BR.x && y >= Params::STOPBOX_TL.y && y <= Params::STOPBOX_BR.y) {
-                    redCount++;
-                    red_processed.at<uchar>(y,x) = 255;
-                }
-            }
-        }
-    }
-
-    cv::Mat red_decorated = MicroCV2::colorizeMask(red_processed, {255,0,0});
+    // The red pixels inside the stop box
+    cv::Mat red_decorated = MicroCV2::colorizeMask(tap.masks[Stage::STOP_CROPPED], {255,0,0});
     cv::rectangle(red_decorated, Params::STOPBOX_TL, Params::STOPBOX_BR, cv::Scalar(255,255,255), 1);
     cv::imwrite("../presentation_images/2_red_cropped.png", red_decorated);
  
-    uint16_t percentRed = (redCount*10000) / Params::STOPBOX_AREA;
-    float percent = (float)percentRed / 100;
+    float percent = (float)tap.stopBox.percent / 100;
 
     std::ostringstream ss;
     ss << std::fixed << std::setprecision(2) << percent << "%";
@@ -409,6 +136,51 @@ void process_red_presentation_image()
 }
 
 int main(int argc, char *argv[]) {
+
+    // Headless sharded batch processing and merging of shard results
+    if (argc > 1 && (std::string(argv[1]) == "--batch" || std::string(argv[1]) == "--merge")) {
+        return Batch::run(argc, argv);
+    }
+
+    // Live view of a shared memory frame ring written by another process, such as IngestServer --ring
+    if (argc > 2 && std::string(argv[1]) == "--ring") {
+        FrameRing::Consumer consumer;
+        if (!consumer.open(argv[2])) return 1;
+        return QT5::showRingWindow(argc, argv, consumer);
+    }
+
+    // Time-ordered playback of the captures, decoded and processed in the background around the playhead
+    if (argc > 1 && std::string(argv[1]) == "--play") {
+        std::map<std::string, std::string> options;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            options[argv[i]] = argv[i + 1];
+        }
+        int fps = 30;
+        size_t prefetch = Playback::DEFAULT_CAPACITY;
+        if (!Cli::parseOption(options, "--fps", fps) || !Cli::parseOption(options, "--prefetch", prefetch)) return 2;
+        if (fps < Playback::MIN_FPS || fps > Playback::MAX_FPS) {
+            fps = std::clamp(fps, Playback::MIN_FPS, Playback::MAX_FPS);
+            std::cerr << "Warning: --fps must be between " << Playback::MIN_FPS << " and " << Playback::MAX_FPS
+                      << ", using " << fps << std::endl;
+        }
+
+        std::vector<std::string> extensions = {".bin", ".BIN"};
+        std::vector<Playback::Entry> entries;
+        for (auto& filename : get_filenames_in_dir(options.contains("--hex-dir") ? options.at("--hex-dir") : "../hex_images/", extensions)) {
+            entries.push_back({std::move(filename), true});
+        }
+        for (auto& filename : get_filenames_in_dir(options.contains("--bin-dir") ? options.at("--bin-dir") : "../binary_images/", extensions)) {
+            entries.push_back({std::move(filename), false});
+        }
+        Playback::sortByCaptureTime(entries);
+
+        Playback::Prefetcher prefetcher(std::move(entries), prefetch);
+        const int result = QT5::showPlaybackWindow(argc, argv, prefetcher, fps);
+
+        const auto stats = prefetcher.stats();
+        fmt::println("Prepared {} frames, {} shown from the prefetch buffer, {} not ready in time", stats.decoded, stats.hits, stats.misses);
+        return result;
+    }
    
     // process_white_presentation_image();
     // process_red_presentation_image();
@@ -426,8 +198,17 @@ int main(int argc, char *argv[]) {
     allFileNames.insert(allFileNames.end(), binaryFiles.begin(), binaryFiles.end());
 
     // Load the images
-    auto hexImages = load_compact_hex_images(compacthexfiles, true);
-    auto binImages = load_binary_images(binaryFiles, true);
+    auto hexImages = load_compact_hex_images(compacthexfiles);
+    auto binImages = load_binary_images(binaryFiles);
+
+    // Save the images as PNGs in the background, skipping any that are already up to date
+    Export::PngExporter exporter;
+    for (size_t i = 0; i < compacthexfiles.size(); ++i) {
+        exporter.enqueue(compacthexfiles[i], compact_hex_png_path(compacthexfiles[i]), hexImages[i]);
+    }
+    for (size_t i = 0; i < binaryFiles.size(); ++i) {
+        exporter.enqueue(binaryFiles[i], binary_png_path(binaryFiles[i]), binImages[i]);
+    }
 
     // Combine the images into a single vector
     std::vector<cv::Mat> images;
@@ -442,8 +223,21 @@ int main(int argc, char *argv[]) {
     std::vector<cv::Mat> combinedMasks;
     combinedMasks.reserve(numFiles);
 
+    // Burst captures repeat the same frame many times, so duplicates reuse the overlay of the first copy
+    Dedup::Deduplicator deduplicator;
+
     // Process the images
-    for (const auto& img : images) {
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto& img = images[i];
+        TRACE_FRAME(i);
+        TRACE_SCOPE("frame");
+
+        auto samePixels = [&](const size_t original) { return Dedup::samePixels(images[original], img); };
+        if (auto original = deduplicator.findOrAdd(Dedup::computeSignature(img), i, samePixels)) {
+            combinedMasks.push_back(combinedMasks[*original]);
+            continue;
+        }
+
         cv::Mat3b combMat = cv::Mat::zeros(img.size(), CV_8UC3);
 
         // Process the image for the white line
@@ -468,8 +262,19 @@ int main(int argc, char *argv[]) {
         combinedMasks.push_back(combMat);
 
     }
+    fmt::println("Deduplicated {} of {} frames", deduplicator.duplicates(), deduplicator.frames());
 
     // Display all the images and their processed versions in windows
     QT5::showImageWindows(argc, argv, rgb888Images, combinedMasks, allFileNames);
+
+    exporter.wait();
+    auto exportStats = exporter.stats();
+    fmt::println("Exported {} PNGs ({} up to date, {} failed)", exportStats.written, exportStats.skipped, exportStats.failed);
+
+    if constexpr (Trace::ENABLED) {
+        Trace::writeChromeTrace("trace.json");
+        Trace::printSummary();
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -1,17 +1,73 @@
 #include "microcv2.hpp"
+#include "microcv2_core.hpp"
+#include "kernels.hpp"
 #include "params.hpp"
+#include "trace.hpp"
 #include <opencv2/core/types.hpp>
 #include <opencv2/opencv.hpp>
 
+namespace {
+
+    /**
+     * @brief View a canonical frame as the span of pixels the core works on
+     *
+     * @param image - The canonical CV_16UC1 frame
+     * @param storage - Holds a continuous copy of the frame if it is a non-continuous view
+     */
+    std::span<const uint16_t> framePixels(const cv::Mat& image, cv::Mat& storage)
+    {
+        storage = image.isContinuous() ? image : image.clone();
+        return {storage.ptr<uint16_t>(), storage.total()};
+    }
+
+    std::span<uint8_t> maskPixels(cv::Mat1b& mask)
+    {
+        return {mask.ptr<uint8_t>(), mask.total()};
+    }
+
+    cv::Point toCv(const MicroCV2::Core::Point& point)
+    {
+        return {point.x, point.y};
+    }
+
+    /**
+     * @brief Classify an inclusive box of a frame row by row with a dispatched kernel
+     *
+     * @return uint16_t - The number of matching pixels
+     */
+    uint16_t classifyBox(Kernels::ClassifyFn classify, const cv::Mat& image, cv::Mat1b& mask,
+                         const cv::Point& tl, const cv::Point& br, const MicroCV2::Core::Config& cfg)
+    {
+        const int x0 = std::max(tl.x, 0), x1 = std::min(br.x, image.cols - 1);
+        const int y0 = std::max(tl.y, 0), y1 = std::min(br.y, image.rows - 1);
+        if (x1 < x0) return 0;
+
+        uint16_t count = 0;
+        for (int y = y0; y <= y1; ++y) {
+            count += classify(image.ptr<uint16_t>(y) + x0, mask.ptr<uint8_t>(y) + x0, x1 - x0 + 1, cfg);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Classify the whole frame for a tap. The detectors themselves only classify their boxes.
+     *
+     */
+    void tapWholeFrame(MicroCV2::Tap::Sink& tap, const MicroCV2::Tap::Stage stage, Kernels::ClassifyFn classify, const cv::Mat& image,
+                       const MicroCV2::Core::Config& cfg)
+    {
+        TRACE_SCOPE("tapWholeFrame");
+
+        cv::Mat1b mask = cv::Mat::zeros(image.size(), CV_8UC1);
+        classifyBox(classify, image, mask, cv::Point(0, 0), cv::Point(image.cols - 1, image.rows - 1), cfg);
+        tap.onMask(stage, mask);
+    }
+
+}
+
 void MicroCV2::RGB565toRGB888(const uint16_t pixel, uint16_t& red, uint16_t& green, uint16_t& blue)
 {
-    red = (pixel >> 11) & 0x1F;
-    green = (pixel >> 5) & 0x3F;
-    blue = pixel & 0x1F;
-
-    red = (red * 255) / 31;
-    green = (green * 255) / 63;
-    blue = (blue * 255) / 31;
+    Core::RGB565toRGB888(pixel, red, green, blue);
 }
 
 void MicroCV2::cropImage(cv::Mat& image, const cv::Point2i& BOX_TL, const cv::Point2i& BOX_BR)
@@ -23,206 +79,176 @@ void MicroCV2::cropImage(cv::Mat& image, const cv::Point2i& BOX_TL, const cv::Po
 
 bool MicroCV2::isStopLine(const uint16_t red, const uint16_t green, const uint16_t blue)
 {
-    if (red >= green + Params::STOP_GREEN_TOLERANCE && red >= blue + Params::STOP_BLUE_TOLERANCE) { 
-        return true;
-    }
-    return false;
+    return Core::isStopLine(red, green, blue);
 }
 
 bool MicroCV2::isWhiteLine(const uint16_t red, const uint16_t green, const uint16_t blue)
 {
-    if (red >= Params::WHITE_RED_THRESH && green >= Params::WHITE_GREEN_THRESH && blue >= Params::WHITE_BLUE_THRESH) { 
-        return true;
-    }
-    return false;
+    return Core::isWhiteLine(red, green, blue);
 }
 
 bool MicroCV2::processRedImg(const cv::Mat& image, cv::Mat1b& mask)
 {
-    mask = cv::Mat::zeros(image.size(), CV_8UC1);
+    return processRedImg(image, mask, Core::DEFAULT_CONFIG);
+}
+
+bool MicroCV2::processRedImg(const cv::Mat& image, cv::Mat1b& mask, const Core::Config& cfg)
+{
+    Core::BoxResult result;
+    return processRedImg(image, mask, cfg, result);
+}
 
-    uint16_t redCount = 0;
-    for (uint8_t y = 0; y < image.rows; ++y) {
-        for (uint8_t x = 0; x < image.cols; ++x) {
-            cv::Vec2b vecpixel = image.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
-
-            uint16_t red, green, blue;
-            RGB565toRGB888(pixel, red, green, blue);
-
-            if (isStopLine(red, green, blue) && !isWhiteLine(red, green, blue)) {
-                if (x >= Params::STOPBOX_TL.x && x <= Params::STOPBOX_BR.x && y >= Params::STOPBOX_TL.y && y <= Params::STOPBOX_BR.y) {
-                    redCount++;
-                    mask.at<uchar>(y,x) = 255;
-                }
-            }
+bool MicroCV2::processRedImg(const cv::Mat& image, cv::Mat1b& mask, const Core::Config& cfg, Core::BoxResult& result,
+                             Tap::Sink* tap)
+{
+    TRACE_SCOPE("processRedImg");
+
+    const cv::Point tl(cfg.STOPBOX_TL_X, cfg.STOPBOX_TL_Y), br(cfg.STOPBOX_BR_X, cfg.STOPBOX_BR_Y);
+    if (tap && tap->wants(Tap::Stage::STOP_CLASSIFIED)) {
+        tapWholeFrame(*tap, Tap::Stage::STOP_CLASSIFIED, Kernels::active().classifyStop, image, cfg);
+    }
+
+    if (cfg.COARSE_FACTOR > 1 && cfg.STOP_MORPHOLOGY == 0) {
+        cv::Mat storage;
+        auto pixels = framePixels(image, storage);
+        mask = cv::Mat1b(image.size());
+        result = Core::processRedCoarse(pixels, image.cols, image.rows, maskPixels(mask), cfg);
+    } else {
+        mask = cv::Mat::zeros(image.size(), CV_8UC1);
+        uint16_t count = classifyBox(Kernels::active().classifyStop, image, mask, tl, br, cfg);
+        if (cfg.STOP_MORPHOLOGY != 0) {
+            TRACE_SCOPE("processRedImg/morphology");
+            count = Core::cleanStopMask(maskPixels(mask), mask.cols, mask.rows, cfg);
         }
+        result = Core::boxResult(count, cfg.stopBoxArea(), cfg.PERCENT_TO_STOP);
     }
 
-    cv::rectangle(mask, Params::STOPBOX_TL, Params::STOPBOX_BR, cv::Scalar(255), 1);
+    if (tap) {
+        if (tap->wants(Tap::Stage::STOP_CROPPED)) tap->onMask(Tap::Stage::STOP_CROPPED, mask);
+        tap->onStopBox(result);
+    }
 
-    uint16_t percentRed = (redCount*10000) / Params::STOPBOX_AREA;
-    return percentRed >= (Params::PERCENT_TO_STOP*100);
+    cv::rectangle(mask, tl, br, cv::Scalar(255), 1);
+    return result.detected;
 }
 
 bool MicroCV2::processCarImg(const cv::Mat &image, cv::Mat1b &mask)
 {
-    mask = cv::Mat::zeros(image.size(), CV_8UC1);
+    TRACE_SCOPE("processCarImg");
 
-    uint16_t carCount = 0;
-    for (uint8_t y = 0; y < image.rows; ++y) {
-        for (uint8_t x = 0; x < image.cols; ++x) {
-            uint16_t pixel = image.at<uint16_t>(y,x);
-
-            uint16_t red, green, blue;
-            RGB565toRGB888(pixel, red, green, blue);
+    const Core::Config& cfg = Core::DEFAULT_CONFIG;
+    mask = cv::Mat::zeros(image.size(), CV_8UC1);
 
-            if (green >= red + Params::CAR_RED_TOLERANCE && green >= blue + Params::CAR_BLUE_TOLERANCE) {
-                if (x >= Params::CARBOX_TL.x && x <= Params::CARBOX_BR.x && y >= Params::CARBOX_TL.y && y <= Params::CARBOX_BR.y) {
-                    carCount++;
-                    mask.at<uint8_t>(y,x) = 255;
-                }
-            }
-        }
-    }
+    uint16_t count = classifyBox(Kernels::active().classifyCar, image, mask, Params::CARBOX_TL, Params::CARBOX_BR, cfg);
+    Core::BoxResult result = Core::boxResult(count, cfg.carBoxArea(), cfg.PERCENT_TO_CAR);
 
     cv::rectangle(mask, Params::CARBOX_TL, Params::CARBOX_BR, cv::Scalar(255), 1);
-
-    uint16_t percentCar = (carCount*10000) / Params::CARBOX_AREA;
-    return percentCar >= (Params::PERCENT_TO_CAR*100);
+    return result.detected;
 }
 
 bool MicroCV2::processWhiteImg(const cv::Mat& image, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist)
 {
-    mask = cv::Mat::zeros(image.size(), CV_8UC1);
-    centerLine = cv::Mat::zeros(image.size(), CV_8UC1);
+    return processWhiteImg(image, mask, centerLine, dist, Core::DEFAULT_CONFIG);
+}
 
-    for (uint8_t y = Params::WHITE_VERTICAL_CROP; y < image.rows; ++y) {
-        for (uint8_t x = 0; x < Params::WHITE_HORIZONTAL_CROP; ++x) {
-            cv::Vec2b vecpixel = image.at<cv::Vec2b>(y, x);
-            uint16_t pixel = (static_cast<uint16_t>(vecpixel[0]) << 8) | vecpixel[1];
+bool MicroCV2::processWhiteImg(const cv::Mat& image, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist, const Core::Config& cfg)
+{
+    Core::WhiteResult result;
+    return processWhiteImg(image, mask, centerLine, dist, cfg, result);
+}
 
-            uint16_t red, green, blue;
-            RGB565toRGB888(pixel, red, green, blue);
+bool MicroCV2::processWhiteImg(const cv::Mat& image, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist, const Core::Config& cfg,
+                               Core::WhiteResult& result, Tap::Sink* tap)
+{
+    TRACE_SCOPE("processWhiteImg");
 
-            if (isWhiteLine(red, green, blue)) {
-                mask.at<uchar>(y,x) = 255;
-            }
-        }
+    if (tap && tap->wants(Tap::Stage::WHITE_CLASSIFIED)) {
+        tapWholeFrame(*tap, Tap::Stage::WHITE_CLASSIFIED, Kernels::active().classifyWhite, image, cfg);
     }
 
-    // cropImage(mask, {0, WHITE_VERTICAL_CROP}, {WHITE_HORIZONTAL_CROP, 95});
-
-    std::vector<contour_t> contours;
-    cv::findContours(mask, contours, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
-    if (contours.size() == 0) {
-        return false;
-    }
+    thread_local Core::Workspace workspace;
 
-    // Sort the contours to put the largest at index 0
-    std::sort(contours.begin(), contours.end(), [](const contour_t& a, const contour_t& b) {
-        return cv::contourArea(a) > cv::contourArea(b);
-    });
-    if (cv::contourArea(contours[0]) < Params::WHITE_MIN_SIZE) return false;
-
-    cv::Point topLeft, topRight, bottomLeft, bottomRight = contours[0][0];
-    cv::Point leftTop, leftBottom, rightTop, rightBottom = contours[0][0];
-
-    // Initialize extreme values
-    int y_min = contours[0][0].y, y_max = contours[0][0].y;
-    int x_min = contours[0][0].x, x_max = contours[0][0].x;
-
-    // First pass to determine min/max x and y
-    for (const auto& pt : contours[0]) {
-        if (pt.y < y_min) y_min = pt.y;
-        if (pt.y > y_max) y_max = pt.y;
-        if (pt.x < x_min) x_min = pt.x;
-        if (pt.x > x_max) x_max = pt.x;
-    }
+    cv::Mat storage;
+    auto pixels = framePixels(image, storage);
+    mask = cv::Mat1b(image.size());
+    centerLine = cv::Mat::zeros(image.size(), CV_8UC1);
 
-    // Second pass to find exact extreme points
-    for (const auto& pt : contours[0]) {
-        // Topmost row (y_min)
-        if (pt.y == y_min) {
-            if (topLeft == cv::Point() || pt.x < topLeft.x) topLeft = pt;
-            if (topRight == cv::Point() || pt.x > topRight.x) topRight = pt;
+    result = {};
+    if (cfg.COARSE_FACTOR > 1 && cfg.WHITE_MORPHOLOGY == 0) {
+        TRACE_SCOPE("processWhiteImg/coarseToFine");
+        result = Core::processWhiteCoarse(pixels, image.cols, image.rows, maskPixels(mask), workspace, cfg);
+    } else {
+        {
+            TRACE_SCOPE("processWhiteImg/classify");
+            mask.setTo(0);
+            classifyBox(Kernels::active().classifyWhite, image, mask, cv::Point(0, cfg.WHITE_VERTICAL_CROP),
+                        cv::Point(cfg.WHITE_HORIZONTAL_CROP - 1, image.rows - 1), cfg);
         }
-        // Bottommost row (y_max)
-        if (pt.y == y_max) {
-            if (bottomLeft == cv::Point() || pt.x < bottomLeft.x) bottomLeft = pt;
-            if (bottomRight == cv::Point() || pt.x > bottomRight.x) bottomRight = pt;
+        if (cfg.WHITE_MORPHOLOGY != 0) {
+            TRACE_SCOPE("processWhiteImg/morphology");
+            Core::cleanWhiteMask(maskPixels(mask), mask.cols, mask.rows, cfg);
         }
-        // Leftmost column (x_min)
-        if (pt.x == x_min) {
-            if (leftTop == cv::Point() || pt.y < leftTop.y) leftTop = pt;
-            if (leftBottom == cv::Point() || pt.y > leftBottom.y) leftBottom = pt;
+        {
+            TRACE_SCOPE("processWhiteImg/findLargestBlob");
+            result.blob = Core::findLargestBlob(maskPixels(mask), mask.cols, mask.rows, workspace);
         }
-        // Rightmost column (x_max)
-        if (pt.x == x_max) {
-            if (rightTop == cv::Point() || pt.y < rightTop.y) rightTop = pt;
-            if (rightBottom == cv::Point() || pt.y > rightBottom.y) rightBottom = pt;
+        if (result.blob.found && result.blob.area2 >= 2 * cfg.WHITE_MIN_SIZE) {
+            TRACE_SCOPE("processWhiteImg/lineFit");
+            result.line = Core::fitLine(result.blob, image.cols, cfg);
+            result.detected = true;
         }
     }
 
-    cv::circle(centerLine, leftTop, 1, cv::Scalar(255));
-    cv::circle(centerLine, topLeft, 1, cv::Scalar(255));
-    cv::circle(centerLine, rightTop, 1, cv::Scalar(255));
-    cv::circle(centerLine, topRight, 1, cv::Scalar(255));
-    cv::circle(centerLine, leftBottom, 1, cv::Scalar(255));
-    cv::circle(centerLine, bottomLeft, 1, cv::Scalar(255));
-    cv::circle(centerLine, rightBottom, 1, cv::Scalar(255));
-    cv::circle(centerLine, bottomRight, 1, cv::Scalar(255));
-
-
-    // cv::Point top = cv::Point((leftmost_topmost.x + topmost_rightmost.x) / 2, (leftmost_topmost.y + topmost_rightmost.y) / 2);
-    // cv::Point bottom = cv::Point((bottommost_leftmost.x + bottommost_rightmost.x) / 2, (bottommost_leftmost.y + bottommost_rightmost.y) / 2);
+    // Blob analysis leaves the mask as it was, so every stage can be handed over once the pass is done. The
+    // coarse pass only masks the tiles it visited.
+    if (tap) {
+        if (tap->wants(Tap::Stage::WHITE_CROPPED)) tap->onMask(Tap::Stage::WHITE_CROPPED, mask);
+        if (result.blob.found && tap->wants(Tap::Stage::WHITE_BLOB)) tap->onBlob(result.blob);
+        if (result.detected && tap->wants(Tap::Stage::WHITE_LINE)) tap->onLine(result.line);
+    }
+    if (!result.detected) return false;
 
-    cv::Point top = leftTop;
-    cv::Point bottom = bottomLeft;
+    const Core::Blob& blob = result.blob;
+    const Core::LineFit& line = result.line;
 
-    float slope = (float)(bottom.y - top.y) / (bottom.x - top.x);
-    float y_intercept = top.y - slope * top.x;
+    cv::circle(centerLine, toCv(blob.leftTop), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.topLeft), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.rightTop), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.topRight), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.leftBottom), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.bottomLeft), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.rightBottom), 1, cv::Scalar(255));
+    cv::circle(centerLine, toCv(blob.bottomRight), 1, cv::Scalar(255));
 
     int16_t p1_x, p1_y, p2_x, p2_y;         // points for drawing slope line
     p1_y = 0;
     p2_y = mask.rows - 1;
-    p1_x = (p1_y - y_intercept) / slope;
-    p2_x = (p2_y - y_intercept) / slope;
+    p1_x = (p1_y - line.yIntercept) / line.slope;
+    p2_x = (p2_y - line.yIntercept) / line.slope;
     cv::line(centerLine, cv::Point(p1_x, p1_y), cv::Point(p2_x, p2_y), cv::Scalar(255), 1);
 
-    cv::Point intersectionPoint;        // Point where the slope line intersects the WHITE_CENTER_POS line
-    intersectionPoint.y = Params::WHITE_VERTICAL_CROP;
-    intersectionPoint.x = (intersectionPoint.y - y_intercept) / slope;
-    cv::circle(centerLine, intersectionPoint, 2, cv::Scalar(255));
+    cv::circle(centerLine, toCv(line.intersection), 2, cv::Scalar(255));
 
-    cv::line(centerLine, cv::Point(Params::WHITE_CENTER_POS, 0), cv::Point(Params::WHITE_CENTER_POS, mask.rows - 1), cv::Scalar(255), 1);
-    // cv::line(centerLine, cv::Point(0, intersectionPoint.y), cv::Point(mask.cols-1, intersectionPoint.y), cv::Scalar(255), 1);
+    cv::line(centerLine, cv::Point(cfg.WHITE_CENTER_POS, 0), cv::Point(cfg.WHITE_CENTER_POS, mask.rows - 1), cv::Scalar(255), 1);
+    cv::putText(centerLine, std::to_string(line.rawDist), cv::Point(0, 10), cv::FONT_HERSHEY_SIMPLEX, 0.25, cv::Scalar(255), 1);
 
-    dist = intersectionPoint.x - Params::WHITE_CENTER_POS;
-    cv::putText(centerLine, std::to_string(dist), cv::Point(0, 10), cv::FONT_HERSHEY_SIMPLEX, 0.25, cv::Scalar(255), 1); 
-
-    cv::line(centerLine, cv::Point(0, Params::WHITE_VERTICAL_CROP), cv::Point(mask.cols - 1, 
-             Params::WHITE_VERTICAL_CROP), cv::Scalar(255), 1);
-    
-    if (dist > Params::MAX_WHITE_DIST) dist = Params::MAX_WHITE_DIST;
-    if (dist < -Params::MAX_WHITE_DIST) dist = -Params::MAX_WHITE_DIST;
+    cv::line(centerLine, cv::Point(0, cfg.WHITE_VERTICAL_CROP), cv::Point(mask.cols - 1,
+             cfg.WHITE_VERTICAL_CROP), cv::Scalar(255), 1);
 
+    dist = line.dist;
     return true;
 }
 
 
 cv::Mat MicroCV2::colorizeMask(const cv::Mat1b& mask, const cv::Vec3b& color) {
+    TRACE_SCOPE("colorizeMask");
+
     cv::Mat3b colorMask(mask.size());
-    cv::Vec3b bgrColor = {color[2], color[1], color[0]}; // Swap from RGB to BGR
+    const uint8_t bgrColor[3] = {color[2], color[1], color[0]}; // Swap from RGB to BGR
 
+    const Kernels::KernelTable& kernels = Kernels::active();
     for (int row = 0; row < mask.rows; ++row) {
-        for (int col = 0; col < mask.cols; ++col) {
-            if (mask(row, col) > 0) {
-                colorMask(row, col) = bgrColor;
-            } else {
-                colorMask(row, col) = cv::Vec3b(0, 0, 0);
-            }
-        }
+        kernels.colorizeMask(mask.ptr<uint8_t>(row), colorMask.ptr<uint8_t>(row), mask.cols, bgrColor);
     }
 
     return colorMask;
@@ -231,22 +257,18 @@ cv::Mat MicroCV2::colorizeMask(const cv::Mat1b& mask, const cv::Vec3b& color) {
 
 bool MicroCV2::layerMask(cv::Mat& dest, const cv::Mat& mask)
 {
+    TRACE_SCOPE("layerMask");
+
     if (dest.size != mask.size) {
         fmt::println("Destination and mask size do not match.");
         return false;
     }
 
+    // Every non-black mask pixel is overlaid onto the combined image
+    const Kernels::KernelTable& kernels = Kernels::active();
     for (int row = 0; row < mask.rows; row++) {
-        for (int col = 0; col < mask.cols; col++) {
-            cv::Vec3b& basePixel = dest.at<cv::Vec3b>(row, col);
-            const cv::Vec3b& maskPixel = mask.at<cv::Vec3b>(row, col);
-
-            // If the mask pixel is not black, overlay it onto the combined image
-            if (maskPixel != cv::Vec3b(0, 0, 0)) {
-                basePixel = maskPixel;
-            }
-        }
+        kernels.layerMask(dest.ptr<uint8_t>(row), mask.ptr<uint8_t>(row), mask.cols);
     }
 
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,213 @@
+#include "playback.hpp"
+#include "image_io.hpp"
+#include "microcv2.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    /**
+     * @brief Split the window of frames around a playhead into the frames ahead of it and behind it
+     *
+     */
+    struct Window {
+        size_t ahead;               ///< Frames from the playhead onwards in the direction of playback
+        size_t behind;              ///< Frames before the playhead
+
+        explicit Window(const size_t capacity) : ahead(capacity - capacity / 4), behind(capacity / 4) {}
+    };
+
+}
+
+bool Playback::capturedBefore(const std::string& a, const std::string& b)
+{
+    const std::string nameA = fs::path(a).filename().string();
+    const std::string nameB = fs::path(b).filename().string();
+
+    size_t i = 0, j = 0;
+    while (i < nameA.size() && j < nameB.size()) {
+        if (std::isdigit(static_cast<unsigned char>(nameA[i])) && std::isdigit(static_cast<unsigned char>(nameB[j]))) {
+            // Compare runs of digits as numbers: skip leading zeros, then the longer run is larger
+            while (i < nameA.size() && nameA[i] == '0') ++i;
+            while (j < nameB.size() && nameB[j] == '0') ++j;
+            size_t endA = i, endB = j;
+            while (endA < nameA.size() && std::isdigit(static_cast<unsigned char>(nameA[endA]))) ++endA;
+            while (endB < nameB.size() && std::isdigit(static_cast<unsigned char>(nameB[endB]))) ++endB;
+
+            if (endA - i != endB - j) return endA - i < endB - j;
+            const int order = nameA.compare(i, endA - i, nameB, j, endB - j);
+            if (order != 0) return order < 0;
+            i = endA;
+            j = endB;
+        } else {
+            if (nameA[i] != nameB[j]) return nameA[i] < nameB[j];
+            ++i;
+            ++j;
+        }
+    }
+    if (nameA.size() - i != nameB.size() - j) return nameA.size() - i < nameB.size() - j;
+
+    // Same name in different directories
+    return a < b;
+}
+
+void Playback::sortByCaptureTime(std::vector<Entry>& entries)
+{
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return capturedBefore(a.filename, b.filename);
+    });
+}
+
+Playback::Frame Playback::renderFrame(const Entry& entry, const size_t index)
+{
+    TRACE_SCOPE("renderFrame");
+
+    Frame frame;
+    frame.index = index;
+
+    const cv::Mat img = entry.compactHex ? load_compact_hex_image(entry.filename) : load_binary_image(entry.filename);
+    if (img.empty()) return frame;
+
+    cv::Mat3b combMat = cv::Mat::zeros(img.size(), CV_8UC3);
+
+    cv::Mat1b center;
+    cv::Mat1b wmask;
+    frame.white = MicroCV2::processWhiteImg(img, wmask, center, frame.dist);
+
+    cv::Mat1b rmask;
+    frame.stop = MicroCV2::processRedImg(img, rmask);
+
+    MicroCV2::layerMask(combMat, MicroCV2::colorizeMask(wmask, {255,255,255}));
+    MicroCV2::layerMask(combMat, MicroCV2::colorizeMask(center, {0,255,0}));
+    MicroCV2::layerMask(combMat, MicroCV2::colorizeMask(rmask, {255,0,0}));
+
+    // Same colors as the image windows, which treat every CV_8UC3 matrix as BGR
+    cv::Mat sideBySide;
+    cv::hconcat(convert_rgb565_to_rgb888(img), combMat, sideBySide);
+    cv::cvtColor(sideBySide, frame.composite, cv::COLOR_BGR2RGB);
+
+    frame.loaded = true;
+    return frame;
+}
+
+Playback::Prefetcher::Prefetcher(std::vector<Entry> entries, const size_t capacity)
+    : m_entries(std::move(entries)), m_slots(std::max<size_t>(capacity, 2))
+{
+    m_thread = std::thread(&Prefetcher::run, this);
+}
+
+Playback::Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void Playback::Prefetcher::seek(const size_t index, const int direction)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_playhead = std::min(index, m_entries.empty() ? 0 : m_entries.size() - 1);
+        m_direction = direction < 0 ? -1 : 1;
+        m_missed = SIZE_MAX;
+    }
+    m_wake.notify_one();
+}
+
+std::shared_ptr<const Playback::Frame> Playback::Prefetcher::get(const size_t index)
+{
+    std::lock_guard lock(m_mutex);
+    const auto& slot = m_slots[index % m_slots.size()];
+    if (slot && slot->index == index) {
+        m_stats.hits++;
+        return slot;
+    }
+
+    if (index != m_missed) {
+        m_stats.misses++;
+        m_missed = index;
+    }
+    return nullptr;
+}
+
+size_t Playback::Prefetcher::ready() const
+{
+    std::lock_guard lock(m_mutex);
+    size_t count = 0;
+    for (const auto& slot : m_slots) {
+        count += slot && inWindow(slot->index);
+    }
+    return count;
+}
+
+Playback::Stats Playback::Prefetcher::stats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+bool Playback::Prefetcher::inWindow(const size_t index) const
+{
+    const Window window(m_slots.size());
+    const size_t before = m_direction > 0 ? window.behind : window.ahead - 1;
+    const size_t after = m_direction > 0 ? window.ahead - 1 : window.behind;
+    return index + before >= m_playhead && index <= m_playhead + after;
+}
+
+bool Playback::Prefetcher::nextMissing(size_t& index) const
+{
+    const Window window(m_slots.size());
+    auto missing = [&](const size_t i) {
+        const auto& slot = m_slots[i % m_slots.size()];
+        return !slot || slot->index != i;
+    };
+
+    // The playhead and the frames ahead of it first, nearest first, then the frames behind it
+    for (size_t k = 0; k < window.ahead; ++k) {
+        const size_t i = m_direction > 0 ? m_playhead + k : m_playhead - k;
+        if (m_direction > 0 ? i >= m_entries.size() : k > m_playhead) break;
+        if (missing(i)) {
+            index = i;
+            return true;
+        }
+    }
+    for (size_t k = 1; k <= window.behind; ++k) {
+        const size_t i = m_direction > 0 ? m_playhead - k : m_playhead + k;
+        if (m_direction > 0 ? k > m_playhead : i >= m_entries.size()) break;
+        if (missing(i)) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Playback::Prefetcher::run()
+{
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        size_t index = 0;
+        m_wake.wait(lock, [&] { return m_stopping || nextMissing(index); });
+        if (m_stopping) return;
+
+        // Decode without the lock, so the viewer can keep reading ready frames and moving the playhead
+        lock.unlock();
+        auto frame = std::make_shared<const Frame>(renderFrame(m_entries[index], index));
+        lock.lock();
+
+        m_stats.decoded++;
+        if (inWindow(index)) {
+            m_slots[index % m_slots.size()] = std::move(frame);
+        } else {
+            m_stats.discarded++;
+        }
+    }
+}
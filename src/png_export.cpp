@@ -0,0 +1,116 @@
+#include "png_export.hpp"
+#include "image_io.hpp"
+#include "trace.hpp"
+
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+Export::PngExporter::PngExporter(unsigned int numThreads)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(numThreads);
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        m_workers.emplace_back(&PngExporter::workerLoop, this);
+    }
+}
+
+Export::PngExporter::~PngExporter()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void Export::PngExporter::enqueue(const std::string& source, const std::string& destination, const cv::Mat& rgb565_image)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back({source, destination, rgb565_image});
+    }
+    m_queued++;
+    m_jobAvailable.notify_one();
+}
+
+void Export::PngExporter::wait()
+{
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_jobs.empty() && m_active == 0; });
+}
+
+Export::ExportStats Export::PngExporter::stats() const
+{
+    return {m_queued.load(), m_written.load(), m_skipped.load(), m_failed.load()};
+}
+
+bool Export::PngExporter::isUpToDate(const std::string& source, const std::string& destination)
+{
+    std::error_code ec;
+    auto destTime = fs::last_write_time(destination, ec);
+    if (ec) return false;
+
+    auto sourceTime = fs::last_write_time(source, ec);
+    if (ec) return false;
+
+    return destTime >= sourceTime;
+}
+
+void Export::PngExporter::workerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+
+            // Drain the queue before stopping so nothing that was enqueued is lost
+            if (m_jobs.empty()) return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_active++;
+        }
+
+        exportImage(job);
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_active--;
+            if (m_jobs.empty() && m_active == 0) {
+                m_idle.notify_all();
+            }
+        }
+    }
+}
+
+void Export::PngExporter::exportImage(const Job& job)
+{
+    TRACE_SCOPE("exportPng");
+
+    if (isUpToDate(job.source, job.destination)) {
+        m_skipped++;
+        return;
+    }
+
+    try {
+        auto rgb888image = convert_rgb565_to_rgb888(job.image);
+        if (cv::imwrite(job.destination, rgb888image)) {
+            m_written++;
+            return;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Could not export " << job.destination << ": " << e.what() << std::endl;
+    }
+
+    m_failed++;
+}
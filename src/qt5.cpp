@@ -1,6 +1,36 @@
 #include "qt5.hpp"
+#include "trace.hpp"
+
+#include <QKeySequence>
+#include <QPushButton>
+#include <QShortcut>
+#include <QSlider>
+#include <QSpinBox>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+QImage QT5::frameToQImage(std::span<const uint16_t> frame, int width, int height) {
+    if (frame.size() < static_cast<size_t>(width) * height) {
+        return QImage();
+    }
+
+    // QImage's RGB16 format is native-endian RGB565, the same layout as the canonical frame
+    return QImage(reinterpret_cast<const uchar*>(frame.data()), width, height, width * sizeof(uint16_t), QImage::Format_RGB16).copy();
+}
+
+QImage QT5::maskToQImage(std::span<const uint8_t> mask, int width, int height) {
+    if (mask.size() < static_cast<size_t>(width) * height) {
+        return QImage();
+    }
+
+    return QImage(mask.data(), width, height, width, QImage::Format_Grayscale8).copy();
+}
 
 std::vector<QImage> QT5::matToQImage(std::span<const cv::Mat1b> mats) {
+    TRACE_SCOPE("matToQImage");
+
     std::vector<QImage> qimages;
     qimages.reserve(mats.size());  // Pre-allocate memory for efficiency
 
@@ -19,6 +49,8 @@ std::vector<QImage> QT5::matToQImage(std::span<const cv::Mat1b> mats) {
 }
 
 std::vector<QImage> QT5::matToQImage(std::span<const cv::Mat> mats) {
+    TRACE_SCOPE("matToQImage");
+
     std::vector<QImage> qimages;
     qimages.reserve(mats.size());  // Preallocate memory for efficiency
 
@@ -46,6 +78,8 @@ std::vector<QImage> QT5::matToQImage(std::span<const cv::Mat> mats) {
 }
 
 QImage QT5::matToQImage(const cv::Mat& mat) {
+    TRACE_SCOPE("matToQImage");
+
     cv::Mat rgbMat;
     
     // Convert BGR to RGB if the image has 3 channels
@@ -100,4 +134,193 @@ void QT5::showImageWindows(int argc, char *argv[], const std::span<cv::Mat>& ori
     }
 
     app.exec();  // Start the event loop
-}
\ No newline at end of file
+}
+
+
+int QT5::showRingWindow(int argc, char *argv[], FrameRing::Consumer& consumer) {
+    QApplication app(argc, argv);
+
+    QWidget window;
+    QVBoxLayout* layout = new QVBoxLayout(&window);
+
+    QLabel* frameLabel = new QLabel();
+    frameLabel->setMinimumSize(IMG_COLS * 4, IMG_ROWS * 4);
+    frameLabel->setScaledContents(true);
+    QLabel* statusLabel = new QLabel("Waiting for frames");
+
+    layout->addWidget(frameLabel);
+    layout->addWidget(statusLabel);
+    window.setWindowTitle("Frame Ring");
+    window.show();
+
+    // Poll at roughly the display rate. The frame is copied out of the ring before it is checked, so a
+    // frame the producer overwrote mid-copy is never shown.
+    QTimer timer;
+    QObject::connect(&timer, &QTimer::timeout, [&]() {
+        auto view = consumer.latest();
+        if (!view) return;
+
+        QImage image = frameToQImage(view->pixels(), IMG_COLS, IMG_ROWS);
+        const FrameRing::Slot& slot = *view->slot;
+        const int64_t handoffUs = (FrameRing::nowNs() - slot.publishNs) / 1000;
+        const uint64_t source = slot.source, frame = slot.frame;
+        const bool hasDetection = slot.hasDetection != 0;
+        const FrameRing::Detection detection = slot.detection;
+        if (!consumer.valid(*view)) return;
+
+        QString status = QString("seq %1, source %2, frame %3, %4 us old").arg(view->seq).arg(source).arg(frame).arg(handoffUs);
+        if (hasDetection) {
+            status += QString(" | stop %1, white %2, dist %3, red %4%")
+                .arg(static_cast<int>(detection.stop)).arg(static_cast<int>(detection.white)).arg(static_cast<int>(detection.dist)).arg(detection.redPercent / 100.0, 0, 'f', 2);
+        }
+        status += QString(" | %1 published, %2 dropped").arg(consumer.published()).arg(consumer.dropped());
+
+        frameLabel->setPixmap(QPixmap::fromImage(image));
+        statusLabel->setText(status);
+    });
+    timer.start(16);
+
+    return app.exec();
+}
+
+
+int QT5::showPlaybackWindow(int argc, char *argv[], Playback::Prefetcher& prefetcher, int fps) {
+    using clock_type = std::chrono::steady_clock;
+
+    QApplication app(argc, argv);
+
+    const size_t frameCount = prefetcher.size();
+    if (frameCount == 0) {
+        std::cerr << "Error: There are no frames to play" << std::endl;
+        return 1;
+    }
+    fps = std::clamp(fps, Playback::MIN_FPS, Playback::MAX_FPS);
+
+    QWidget window;
+    QVBoxLayout* layout = new QVBoxLayout(&window);
+
+    QLabel* frameLabel = new QLabel();
+    frameLabel->setMinimumSize(IMG_COLS * 2 * 4, IMG_ROWS * 4);
+    frameLabel->setScaledContents(true);
+    QLabel* statusLabel = new QLabel("Loading");
+
+    QPushButton* backButton = new QPushButton("<");
+    QPushButton* playButton = new QPushButton("Play");
+    QPushButton* forwardButton = new QPushButton(">");
+    QSlider* slider = new QSlider(Qt::Horizontal);
+    slider->setRange(0, static_cast<int>(frameCount) - 1);
+    QSpinBox* fpsBox = new QSpinBox();
+    fpsBox->setRange(Playback::MIN_FPS, Playback::MAX_FPS);
+    fpsBox->setValue(fps);
+    fpsBox->setSuffix(" fps");
+
+    QHBoxLayout* controls = new QHBoxLayout();
+    controls->addWidget(backButton);
+    controls->addWidget(playButton);
+    controls->addWidget(forwardButton);
+    controls->addWidget(slider, 1);
+    controls->addWidget(fpsBox);
+
+    layout->addWidget(frameLabel);
+    layout->addLayout(controls);
+    layout->addWidget(statusLabel);
+    window.setWindowTitle("Playback");
+    window.show();
+
+    size_t playhead = 0;
+    std::shared_ptr<const Playback::Frame> shown;
+    bool playing = false;
+    uint64_t stalls = 0;
+    auto period = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / fps));
+    auto nextFrameTime = clock_type::now();
+
+    auto show = [&](std::shared_ptr<const Playback::Frame> frame) {
+        shown = std::move(frame);
+        const cv::Mat& composite = shown->composite;
+        if (shown->loaded) {
+            frameLabel->setPixmap(QPixmap::fromImage(QImage(composite.data, composite.cols, composite.rows, composite.step, QImage::Format_RGB888)));
+        }
+
+        slider->blockSignals(true);
+        slider->setValue(static_cast<int>(shown->index));
+        slider->blockSignals(false);
+
+        QString status = QString("%1 / %2  %3").arg(shown->index + 1).arg(frameCount)
+            .arg(QString::fromStdString(prefetcher.entry(shown->index).filename));
+        status += shown->loaded ? QString(" | stop %1, white %2, dist %3").arg(static_cast<int>(shown->stop)).arg(static_cast<int>(shown->white)).arg(static_cast<int>(shown->dist))
+                                : QString(" | could not be read");
+        status += QString(" | %1 / %2 prefetched, %3 stalls").arg(prefetcher.ready()).arg(prefetcher.capacity()).arg(stalls);
+        statusLabel->setText(status);
+    };
+
+    auto seek = [&](const size_t index, const int direction) {
+        playhead = std::min(index, frameCount - 1);
+        prefetcher.seek(playhead, direction);
+    };
+
+    auto setPlaying = [&](const bool play) {
+        playing = play && playhead + 1 < frameCount;
+        playButton->setText(playing ? "Pause" : "Play");
+        nextFrameTime = clock_type::now() + period;
+    };
+
+    // Poll faster than the frame rate and advance on a steady schedule, so the average rate is exact even
+    // though timer intervals are whole milliseconds
+    QTimer timer;
+    timer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&timer, &QTimer::timeout, [&]() {
+        if (!shown || shown->index != playhead) {
+            if (auto frame = prefetcher.get(playhead)) show(std::move(frame));
+            return;
+        }
+        if (!playing) return;
+
+        const auto now = clock_type::now();
+        if (now < nextFrameTime) return;
+
+        if (playhead + 1 >= frameCount) {
+            setPlaying(false);
+            return;
+        }
+
+        auto frame = prefetcher.get(playhead + 1);
+        if (!frame) {
+            stalls++;
+            nextFrameTime = now + period;
+            return;
+        }
+
+        // Fall back to the current time after a stall so playback does not race to catch up
+        nextFrameTime = std::max(nextFrameTime + period, now);
+        seek(playhead + 1, 1);
+        show(std::move(frame));
+    });
+    timer.start(2);
+
+    auto step = [&](const int direction) {
+        setPlaying(false);
+        if (direction < 0 && playhead == 0) return;
+        seek(playhead + direction, direction);
+    };
+
+    QObject::connect(playButton, &QPushButton::clicked, [&]() { setPlaying(!playing); });
+    QObject::connect(backButton, &QPushButton::clicked, [&]() { step(-1); });
+    QObject::connect(forwardButton, &QPushButton::clicked, [&]() { step(1); });
+    QObject::connect(slider, &QSlider::valueChanged, [&](int value) {
+        const size_t index = static_cast<size_t>(value);
+        seek(index, index < playhead ? -1 : 1);
+    });
+    QObject::connect(fpsBox, QOverload<int>::of(&QSpinBox::valueChanged), [&](int value) {
+        period = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / value));
+    });
+
+    QShortcut* playShortcut = new QShortcut(QKeySequence(Qt::Key_Space), &window);
+    QShortcut* backShortcut = new QShortcut(QKeySequence(Qt::Key_Left), &window);
+    QShortcut* forwardShortcut = new QShortcut(QKeySequence(Qt::Key_Right), &window);
+    QObject::connect(playShortcut, &QShortcut::activated, [&]() { setPlaying(!playing); });
+    QObject::connect(backShortcut, &QShortcut::activated, [&]() { step(-1); });
+    QObject::connect(forwardShortcut, &QShortcut::activated, [&]() { step(1); });
+
+    seek(0, 1);
+    return app.exec();
+}
@@ -0,0 +1,357 @@
+#include "results_store.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    constexpr uint32_t STORE_VERSION = 1;
+
+    /**
+     * @brief The file header, padded so the first chunk is 8 byte aligned
+     *
+     */
+    struct FileHeader {
+        char magic[sizeof(Results::STORE_MAGIC)];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    /**
+     * @brief Offsets of every column from the start of a chunk
+     *
+     */
+    struct Layout {
+        size_t frameIds, sources, stops, whites, dists, redPercents, blobAreas, stringOffsets, stringData, size;
+    };
+
+    constexpr size_t align8(const size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    Layout chunkLayout(const uint32_t rows, const uint32_t strings, const uint32_t stringBytes)
+    {
+        Layout layout;
+        size_t offset = sizeof(Results::ChunkHeader);
+        auto column = [&](size_t& field, const size_t bytes) {
+            field = offset;
+            offset = align8(offset + bytes);
+        };
+
+        column(layout.frameIds, rows * sizeof(uint64_t));
+        column(layout.sources, rows * sizeof(uint32_t));
+        column(layout.stops, rows * sizeof(uint8_t));
+        column(layout.whites, rows * sizeof(uint8_t));
+        column(layout.dists, rows * sizeof(int8_t));
+        column(layout.redPercents, rows * sizeof(uint16_t));
+        column(layout.blobAreas, rows * sizeof(float));
+        column(layout.stringOffsets, (size_t(strings) + 1) * sizeof(uint32_t));
+        column(layout.stringData, stringBytes);
+        layout.size = offset;
+        return layout;
+    }
+
+    template <typename T>
+    std::span<const T> columnAt(const uint8_t* chunk, const size_t offset, const size_t count)
+    {
+        return {reinterpret_cast<const T*>(chunk + offset), count};
+    }
+
+    /**
+     * @brief Check that every source names a string and every string lies inside the string data, so
+     * Chunk::source can't read outside the chunk
+     *
+     */
+    bool validChunk(const Results::Chunk& chunk, const Results::ChunkHeader& header)
+    {
+        for (const uint32_t source : chunk.sources) {
+            if (source >= header.strings) return false;
+        }
+        if (chunk.stringOffsets[0] != 0 || chunk.stringOffsets[header.strings] != header.stringBytes) return false;
+        for (uint32_t i = 0; i < header.strings; ++i) {
+            if (chunk.stringOffsets[i] > chunk.stringOffsets[i + 1]) return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void writeColumn(std::vector<uint8_t>& chunk, const size_t offset, const size_t row, const T value)
+    {
+        std::memcpy(chunk.data() + offset + row * sizeof(T), &value, sizeof(T));
+    }
+
+}
+
+Results::MappedFile::~MappedFile()
+{
+    close();
+}
+
+Results::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Results::MappedFile& Results::MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_mapping, other.m_mapping);
+    }
+    return *this;
+}
+
+bool Results::MappedFile::open(const std::string& filename)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        std::cerr << "Error: Could not read the size of " << filename << std::endl;
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return true;
+    }
+
+    // The mapping keeps the file open, so the file handle can be closed straight away
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        std::cerr << "Error: Could not map file " << filename << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        std::cerr << "Error: Could not map file " << filename << std::endl;
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(size.QuadPart);
+    m_mapping = mapping;
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        std::cerr << "Error: Could not read the size of " << filename << std::endl;
+        return false;
+    }
+    if (info.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    // The mapping keeps the file open, so the descriptor can be closed straight away
+    void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Error: Could not map file " << filename << std::endl;
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+void Results::MappedFile::close()
+{
+    if (m_data == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+#else
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+}
+
+bool Results::Reader::open(const std::string& filename)
+{
+    m_chunks.clear();
+    m_rows = 0;
+    m_validBytes = 0;
+
+    if (!m_file.open(filename)) return false;
+
+    FileHeader header;
+    if (m_file.size() < sizeof(header)) {
+        std::cerr << "Error: " << filename << " is not a results store" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 || header.version != STORE_VERSION) {
+        std::cerr << "Error: " << filename << " is not a results store" << std::endl;
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    while (offset < m_file.size()) {
+        const uint8_t* chunk = m_file.data() + offset;
+        const size_t remaining = m_file.size() - offset;
+
+        // An interrupted append leaves a prefix of its chunk, so only the last chunk can be cut short
+        ChunkHeader chunkHeader;
+        bool complete = remaining >= sizeof(chunkHeader);
+        if (complete) {
+            std::memcpy(&chunkHeader, chunk, sizeof(chunkHeader));
+            const Layout layout = chunkLayout(chunkHeader.rows, chunkHeader.strings, chunkHeader.stringBytes);
+            if (chunkHeader.size != layout.size) {
+                std::cerr << "Error: " << filename << " has a corrupt chunk at byte " << offset << std::endl;
+                return false;
+            }
+            complete = layout.size <= remaining;
+
+            if (complete) {
+                Chunk view;
+                view.frameIds = columnAt<uint64_t>(chunk, layout.frameIds, chunkHeader.rows);
+                view.sources = columnAt<uint32_t>(chunk, layout.sources, chunkHeader.rows);
+                view.stops = columnAt<uint8_t>(chunk, layout.stops, chunkHeader.rows);
+                view.whites = columnAt<uint8_t>(chunk, layout.whites, chunkHeader.rows);
+                view.dists = columnAt<int8_t>(chunk, layout.dists, chunkHeader.rows);
+                view.redPercents = columnAt<uint16_t>(chunk, layout.redPercents, chunkHeader.rows);
+                view.blobAreas = columnAt<float>(chunk, layout.blobAreas, chunkHeader.rows);
+                view.stringOffsets = columnAt<uint32_t>(chunk, layout.stringOffsets, chunkHeader.strings + 1);
+                view.stringData = reinterpret_cast<const char*>(chunk + layout.stringData);
+                if (!validChunk(view, chunkHeader)) {
+                    std::cerr << "Error: " << filename << " has a corrupt chunk at byte " << offset << std::endl;
+                    return false;
+                }
+                m_chunks.push_back(view);
+            }
+        }
+
+        if (!complete) {
+            std::cerr << "Warning: Ignoring a truncated chunk at the end of " << filename << std::endl;
+            break;
+        }
+
+        m_rows += chunkHeader.rows;
+        offset += chunkHeader.size;
+    }
+
+    m_validBytes = offset;
+    return true;
+}
+
+bool Results::append(const std::string& filename, std::span<const Record> records)
+{
+    uint64_t firstFrame = 0;
+    const bool exists = fs::exists(filename) && fs::file_size(filename) > 0;
+
+    if (exists) {
+        uint64_t validBytes;
+        {
+            // A corrupt store fails to open here, so only a truncated last chunk is ever cut off below
+            Reader reader;
+            if (!reader.open(filename)) return false;
+            firstFrame = reader.rows();
+            validBytes = reader.validBytes();
+        }
+
+        // Drop a chunk left behind by an interrupted append so the new chunk lines up
+        if (validBytes < fs::file_size(filename)) {
+            fs::resize_file(filename, validBytes);
+        }
+    }
+
+    // Build the string table, storing every source once
+    std::unordered_map<std::string_view, uint32_t> stringIndex;
+    std::vector<std::string_view> strings;
+    std::vector<uint32_t> sources(records.size());
+    uint32_t stringBytes = 0;
+    for (size_t row = 0; row < records.size(); ++row) {
+        auto [it, inserted] = stringIndex.emplace(records[row].source, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.push_back(records[row].source);
+            stringBytes += static_cast<uint32_t>(records[row].source.size());
+        }
+        sources[row] = it->second;
+    }
+
+    const uint32_t rows = static_cast<uint32_t>(records.size());
+    const Layout layout = chunkLayout(rows, static_cast<uint32_t>(strings.size()), stringBytes);
+
+    std::vector<uint8_t> chunk(layout.size, 0);
+    const ChunkHeader header = {rows, static_cast<uint32_t>(strings.size()), stringBytes, 0, firstFrame, layout.size};
+    std::memcpy(chunk.data(), &header, sizeof(header));
+
+    for (size_t row = 0; row < records.size(); ++row) {
+        const Record& record = records[row];
+        writeColumn<uint64_t>(chunk, layout.frameIds, row, firstFrame + row);
+        writeColumn<uint32_t>(chunk, layout.sources, row, sources[row]);
+        writeColumn<uint8_t>(chunk, layout.stops, row, record.stop ? 1 : 0);
+        writeColumn<uint8_t>(chunk, layout.whites, row, record.white ? 1 : 0);
+        writeColumn<int8_t>(chunk, layout.dists, row, record.dist);
+        writeColumn<uint16_t>(chunk, layout.redPercents, row, record.redPercent);
+        writeColumn<float>(chunk, layout.blobAreas, row, record.blobArea);
+    }
+
+    uint32_t stringOffset = 0;
+    for (size_t i = 0; i < strings.size(); ++i) {
+        writeColumn<uint32_t>(chunk, layout.stringOffsets, i, stringOffset);
+        std::memcpy(chunk.data() + layout.stringData + stringOffset, strings[i].data(), strings[i].size());
+        stringOffset += static_cast<uint32_t>(strings[i].size());
+    }
+    writeColumn<uint32_t>(chunk, layout.stringOffsets, strings.size(), stringOffset);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::app);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    if (!exists) {
+        FileHeader fileHeader = {};
+        std::memcpy(fileHeader.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        fileHeader.version = STORE_VERSION;
+        file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    }
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+
+    return static_cast<bool>(file);
+}
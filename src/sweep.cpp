@@ -0,0 +1,553 @@
+#include "sweep.hpp"
+#include "image_io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+    using MicroCV2::Core::Config;
+
+    constexpr size_t PIXELS = IMG_ROWS * IMG_COLS;
+    constexpr size_t CHUNK_FRAMES = 256;            // Frames scored between checks against the top results, whole batches
+    static_assert(CHUNK_FRAMES % Sweep::BATCH_LANES == 0);
+    constexpr uint64_t MAX_COMBINATIONS = 10'000'000;
+
+    /**
+     * @brief A tunable Core::Config field and the detectors that read it
+     *
+     */
+    struct Field {
+        const char* name;
+        int maxValue;
+        bool stop;                  ///< Read by the stop detector
+        bool white;                 ///< Read by the white line detector
+        void (*set)(Config&, int);
+    };
+
+    constexpr Field FIELDS[] = {
+        {"STOPBOX_TL_X", IMG_COLS - 1, true, false, [](Config& c, int v) { c.STOPBOX_TL_X = static_cast<uint8_t>(v); }},
+        {"STOPBOX_TL_Y", IMG_ROWS - 1, true, false, [](Config& c, int v) { c.STOPBOX_TL_Y = static_cast<uint8_t>(v); }},
+        {"STOPBOX_BR_X", IMG_COLS - 1, true, false, [](Config& c, int v) { c.STOPBOX_BR_X = static_cast<uint8_t>(v); }},
+        {"STOPBOX_BR_Y", IMG_ROWS - 1, true, false, [](Config& c, int v) { c.STOPBOX_BR_Y = static_cast<uint8_t>(v); }},
+        {"PERCENT_TO_STOP", 100, true, false, [](Config& c, int v) { c.PERCENT_TO_STOP = static_cast<uint8_t>(v); }},
+        {"STOP_GREEN_TOLERANCE", 255, true, false, [](Config& c, int v) { c.STOP_GREEN_TOLERANCE = static_cast<uint8_t>(v); }},
+        {"STOP_BLUE_TOLERANCE", 255, true, false, [](Config& c, int v) { c.STOP_BLUE_TOLERANCE = static_cast<uint8_t>(v); }},
+        {"STOP_MORPHOLOGY", 4, true, false, [](Config& c, int v) { c.STOP_MORPHOLOGY = static_cast<uint8_t>(v); }},
+
+        // White pixels are never counted as red, so the white thresholds change both detectors
+        {"WHITE_RED_THRESH", 255, true, true, [](Config& c, int v) { c.WHITE_RED_THRESH = static_cast<uint8_t>(v); }},
+        {"WHITE_GREEN_THRESH", 255, true, true, [](Config& c, int v) { c.WHITE_GREEN_THRESH = static_cast<uint8_t>(v); }},
+        {"WHITE_BLUE_THRESH", 255, true, true, [](Config& c, int v) { c.WHITE_BLUE_THRESH = static_cast<uint8_t>(v); }},
+        {"MORPH_SHAPE", 1, true, true, [](Config& c, int v) { c.MORPH_SHAPE = static_cast<uint8_t>(v); }},
+
+        {"WHITE_VERTICAL_CROP", IMG_ROWS - 1, false, true, [](Config& c, int v) { c.WHITE_VERTICAL_CROP = static_cast<uint8_t>(v); }},
+        {"WHITE_HORIZONTAL_CROP", IMG_COLS, false, true, [](Config& c, int v) { c.WHITE_HORIZONTAL_CROP = static_cast<uint8_t>(v); }},
+        {"WHITE_MIN_SIZE", IMG_ROWS * IMG_COLS, false, true, [](Config& c, int v) { c.WHITE_MIN_SIZE = static_cast<uint16_t>(v); }},
+        {"WHITE_CENTER_POS", IMG_COLS - 1, false, true, [](Config& c, int v) { c.WHITE_CENTER_POS = static_cast<uint8_t>(v); }},
+        {"WHITE_MORPHOLOGY", 4, false, true, [](Config& c, int v) { c.WHITE_MORPHOLOGY = static_cast<uint8_t>(v); }},
+    };
+
+    const Field* findField(const std::string& name)
+    {
+        for (const Field& field : FIELDS) {
+            if (name == field.name) return &field;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief SplitMix64, so random sweeps draw the same combinations on every platform
+     *
+     */
+    uint64_t splitMix(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * @brief Parse one value of a parameter, a number or the name of a morphology operation or shape
+     *
+     */
+    bool parseValue(const std::string& name, const std::string& text, int& value)
+    {
+        MicroCV2::Morph::Op op;
+        MicroCV2::Morph::Shape shape;
+        if (name == "MORPH_SHAPE" && MicroCV2::Morph::parseShape(text, shape)) {
+            value = static_cast<int>(shape);
+            return true;
+        }
+        if ((name == "STOP_MORPHOLOGY" || name == "WHITE_MORPHOLOGY") && MicroCV2::Morph::parseOp(text, op)) {
+            value = static_cast<int>(op);
+            return true;
+        }
+
+        try {
+            size_t end;
+            value = std::stoi(text, &end);
+            return end == text.size();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parse the values of a parameter: a comma separated list of single values and START:END[:STEP] ranges
+     *
+     */
+    bool parseValues(const std::string& name, const std::string& text, std::vector<int>& values)
+    {
+        std::stringstream items(text);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            const size_t colon = item.find(':');
+            if (colon == std::string::npos) {
+                int value;
+                if (!parseValue(name, item, value)) return false;
+                values.push_back(value);
+                continue;
+            }
+
+            const size_t second = item.find(':', colon + 1);
+            int start, end, step = 1;
+            if (!parseValue(name, item.substr(0, colon), start)
+                || !parseValue(name, item.substr(colon + 1, second == std::string::npos ? std::string::npos : second - colon - 1), end)
+                || (second != std::string::npos && !parseValue(name, item.substr(second + 1), step))
+                || step <= 0 || end < start) {
+                return false;
+            }
+            for (int value = start; value <= end; value += step) {
+                values.push_back(value);
+            }
+        }
+        return !values.empty();
+    }
+
+    /**
+     * @brief A detector's score over the whole dataset for one combination of the parameters it reads
+     *
+     */
+    struct DetectorScore {
+        uint64_t errors = 0;
+        uint64_t absError = 0;      ///< Sum of the dist errors, white line detector only
+        uint64_t ns = 0;            ///< Time spent in the detector over the whole dataset
+        bool pruned = false;        ///< Abandoned once errors alone exceeded the top results, so errors is only a lower bound
+    };
+
+    using ScoreCache = std::map<std::vector<int>, DetectorScore>;
+
+    /**
+     * @brief One detector's score for the combination being evaluated, taken from the cache or being computed
+     *
+     */
+    struct Progress {
+        const std::vector<int> key;
+        ScoreCache& cache;
+        std::mutex& mutex;
+        DetectorScore score;
+        bool running = true;        ///< Still scoring frames
+        bool shared = false;        ///< Other combinations read the same parameters, so the score is worth finishing
+        size_t frames = 0;          ///< Frames scored
+
+        Progress(std::vector<int> key, const std::map<std::vector<int>, uint32_t>& uses, ScoreCache& cache, std::mutex& mutex,
+                 const size_t total)
+            : key(std::move(key)), cache(cache), mutex(mutex)
+        {
+            std::lock_guard lock(mutex);
+            if (auto it = cache.find(this->key); it != cache.end()) {
+                score = it->second;
+                running = false;
+                frames = total;
+            }
+            shared = uses.at(this->key) > 1;
+        }
+
+        void pruneAbove(const uint64_t threshold)
+        {
+            if (running && score.errors > threshold) {
+                score.pruned = true;
+                running = false;
+                remember();
+            }
+        }
+
+        /**
+         * @brief Remember the score if it covers the whole dataset
+         *
+         */
+        void finish(const size_t total)
+        {
+            if (running && frames == total) {
+                running = false;
+                remember();
+            }
+        }
+
+    private:
+        void remember()
+        {
+            std::lock_guard lock(mutex);
+            cache.emplace(key, score);
+        }
+    };
+
+    /**
+     * @brief The state the worker threads of a sweep share
+     *
+     */
+    class Sweeper {
+    public:
+        Sweeper(const Sweep::Dataset& dataset, const Sweep::Space& space, const Sweep::Options& options, const uint64_t count)
+            : m_dataset(dataset), m_space(space), m_options(options)
+        {
+            for (size_t i = 0; i < space.parameters.size(); ++i) {
+                const Field* field = findField(space.parameters[i].name);
+                if (field->stop) m_stopParams.push_back(i);
+                if (field->white) m_whiteParams.push_back(i);
+            }
+            for (uint64_t i = 0; i < count; ++i) {
+                const std::vector<int> values = combination(i);
+                m_stopUses[project(values, m_stopParams)]++;
+                m_whiteUses[project(values, m_whiteParams)]++;
+            }
+        }
+
+        /**
+         * @brief The values of a combination, one per parameter
+         *
+         */
+        std::vector<int> combination(uint64_t index) const
+        {
+            std::vector<int> values(m_space.parameters.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                const std::vector<int>& choices = m_space.parameters[i].values;
+                if (m_options.random > 0) {
+                    values[i] = choices[splitMix(m_options.seed ^ splitMix(index * values.size() + i)) % choices.size()];
+                } else {
+                    values[i] = choices[index % choices.size()];
+                    index /= choices.size();
+                }
+            }
+            return values;
+        }
+
+        Sweep::Score evaluate(const std::vector<int>& values, std::span<uint8_t> masks, MicroCV2::Core::Workspace& ws)
+        {
+            using namespace MicroCV2;
+
+            Sweep::Score score;
+            score.values = values;
+
+            Config cfg = m_options.base;
+            for (size_t i = 0; i < values.size(); ++i) {
+                findField(m_space.parameters[i].name)->set(cfg, values[i]);
+            }
+            if (cfg.stopBoxArea() == 0 || cfg.WHITE_HORIZONTAL_CROP == 0) {
+                score.valid = false;
+                return score;
+            }
+
+            const size_t frames = m_dataset.size();
+            Progress stop(project(values, m_stopParams), m_stopUses, m_stopCache, m_mutex, frames);
+            Progress white(project(values, m_whiteParams), m_whiteUses, m_whiteCache, m_mutex, frames);
+
+            auto prune = [&]() {
+                score.pruned = true;
+                // Still finish a detector score other combinations will reuse
+                stop.running = stop.running && stop.shared;
+                white.running = white.running && white.shared;
+            };
+            if (stop.score.pruned || white.score.pruned) prune();
+
+            for (size_t begin = 0; begin < frames && (stop.running || white.running); begin += CHUNK_FRAMES) {
+                const size_t end = std::min(begin + CHUNK_FRAMES, frames);
+
+                // Chunks are whole batches, so frame i is lane i - first of the batch starting at first
+                if (stop.running) {
+                    const auto start = clock_type::now();
+                    for (size_t first = begin; first < end; first += Sweep::BATCH_LANES) {
+                        const auto red = Core::processRed(m_dataset.batches[first / Sweep::BATCH_LANES], cfg);
+                        for (size_t i = first; i < std::min(first + Sweep::BATCH_LANES, end); ++i) {
+                            stop.score.errors += red[i - first].detected != m_dataset.labels[i].stop;
+                        }
+                    }
+                    stop.score.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+                    stop.frames = end;
+                }
+                if (white.running) {
+                    const auto start = clock_type::now();
+                    for (size_t first = begin; first < end; first += Sweep::BATCH_LANES) {
+                        const auto lines = Core::processWhite(m_dataset.batches[first / Sweep::BATCH_LANES], masks, ws, cfg);
+                        for (size_t i = first; i < std::min(first + Sweep::BATCH_LANES, end); ++i) {
+                            const Core::WhiteResult& line = lines[i - first];
+                            const int error = std::abs((line.detected ? line.line.dist : 0) - m_dataset.labels[i].dist);
+                            white.score.errors += error != 0;
+                            white.score.absError += error;
+                        }
+                    }
+                    white.score.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+                    white.frames = end;
+                }
+
+                // Errors only grow and the threshold only falls, so a combination already behind the top results
+                // can never reach them. A detector score that is behind on its own rules out every combination using it.
+                const uint64_t threshold = m_threshold.load(std::memory_order_relaxed);
+                stop.pruneAbove(threshold);
+                white.pruneAbove(threshold);
+                if (!score.pruned && stop.score.errors + white.score.errors > threshold) prune();
+            }
+
+            stop.finish(frames);
+            white.finish(frames);
+
+            score.pruned = score.pruned || stop.score.pruned || white.score.pruned;
+            score.stopErrors = stop.score.errors;
+            score.distErrors = white.score.errors;
+            if (score.pruned) {
+                score.frames = std::min(stop.frames, white.frames);
+                return score;
+            }
+
+            score.frames = frames;
+            score.distAbsError = white.score.absError;
+            score.detectNs = frames > 0 ? static_cast<double>(stop.score.ns + white.score.ns) / frames : 0;
+
+            std::lock_guard lock(m_mutex);
+            m_best.insert(score.errors());
+            if (m_best.size() > std::max<size_t>(m_options.top, 1)) m_best.erase(std::prev(m_best.end()));
+            if (m_best.size() >= std::max<size_t>(m_options.top, 1)) m_threshold.store(*m_best.rbegin(), std::memory_order_relaxed);
+            return score;
+        }
+
+    private:
+        static std::vector<int> project(const std::vector<int>& values, const std::vector<size_t>& params)
+        {
+            std::vector<int> key;
+            key.reserve(params.size());
+            for (size_t i : params) key.push_back(values[i]);
+            return key;
+        }
+
+        const Sweep::Dataset& m_dataset;
+        const Sweep::Space& m_space;
+        const Sweep::Options& m_options;
+        std::vector<size_t> m_stopParams;       ///< Parameters the stop detector reads
+        std::vector<size_t> m_whiteParams;      ///< Parameters the white line detector reads
+
+        std::mutex m_mutex;
+        std::map<std::vector<int>, uint32_t> m_stopUses;        ///< Combinations reading each set of stop parameters
+        std::map<std::vector<int>, uint32_t> m_whiteUses;
+        ScoreCache m_stopCache;
+        ScoreCache m_whiteCache;
+        std::multiset<uint64_t> m_best;         ///< Errors of the top complete combinations
+        std::atomic<uint64_t> m_threshold = UINT64_MAX;
+    };
+
+}
+
+uint64_t Sweep::Space::gridSize() const
+{
+    uint64_t size = 1;
+    for (const Parameter& parameter : parameters) {
+        if (parameter.values.size() > 0 && size > UINT64_MAX / parameter.values.size()) return UINT64_MAX;
+        size *= parameter.values.size();
+    }
+    return size;
+}
+
+bool Sweep::isParameter(const std::string& name, int& maxValue)
+{
+    const Field* field = findField(name);
+    if (field) maxValue = field->maxValue;
+    return field != nullptr;
+}
+
+bool Sweep::loadSpace(const std::string& path, Space& space)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream words(line);
+        std::string name, word, values;
+        if (!(words >> name)) continue;
+        while (words >> word) values += word;
+
+        int maxValue;
+        if (!isParameter(name, maxValue)) {
+            std::cerr << "Error: " << path << ":" << number << ": " << name << " is not a tunable parameter" << std::endl;
+            return false;
+        }
+        if (std::any_of(space.parameters.begin(), space.parameters.end(), [&](const Parameter& p) { return p.name == name; })) {
+            std::cerr << "Error: " << path << ":" << number << ": " << name << " is listed twice" << std::endl;
+            return false;
+        }
+
+        Parameter parameter{name, {}};
+        if (!parseValues(name, values, parameter.values)) {
+            std::cerr << "Error: " << path << ":" << number << ": Could not parse the values of " << name << std::endl;
+            return false;
+        }
+        if (std::any_of(parameter.values.begin(), parameter.values.end(), [&](int v) { return v < 0 || v > maxValue; })) {
+            std::cerr << "Error: " << path << ":" << number << ": " << name << " must be between 0 and " << maxValue << std::endl;
+            return false;
+        }
+        space.parameters.push_back(std::move(parameter));
+    }
+
+    return true;
+}
+
+bool Sweep::loadLabels(const std::string& path, std::vector<Label>& labels)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::getline(in, line);
+    std::vector<std::string> columns;
+    std::stringstream header(line);
+    for (std::string column; std::getline(header, column, ',');) {
+        columns.push_back(column);
+    }
+
+    auto column = [&](const char* name) { return std::find(columns.begin(), columns.end(), name) - columns.begin(); };
+    const size_t stopColumn = column("stop"), distColumn = column("dist");
+    if (stopColumn >= columns.size() || distColumn >= columns.size() || columns.empty() || columns.back() != "file") {
+        std::cerr << "Error: " << path << " needs a header with stop, dist, and file columns, file last" << std::endl;
+        return false;
+    }
+
+    const fs::path labelsDir = fs::path(path).parent_path();
+    for (int number = 2; std::getline(in, line); ++number) {
+        if (line.empty()) continue;
+
+        // The file name is last and takes the rest of the line, so it may contain commas
+        std::vector<std::string> fields;
+        size_t pos = 0;
+        while (fields.size() + 1 < columns.size()) {
+            const size_t comma = line.find(',', pos);
+            if (comma == std::string::npos) break;
+            fields.push_back(line.substr(pos, comma - pos));
+            pos = comma + 1;
+        }
+        if (fields.size() + 1 != columns.size()) {
+            std::cerr << "Error: " << path << ":" << number << ": Expected " << columns.size() << " columns" << std::endl;
+            return false;
+        }
+
+        Label label;
+        label.file = line.substr(pos);
+        try {
+            label.stop = std::stoi(fields[stopColumn]) != 0;
+            label.dist = static_cast<int8_t>(std::stoi(fields[distColumn]));
+        } catch (const std::exception&) {
+            std::cerr << "Error: " << path << ":" << number << ": Malformed stop or dist" << std::endl;
+            return false;
+        }
+
+        if (!fs::exists(label.file) && fs::exists(labelsDir / fs::path(label.file).filename())) {
+            label.file = (labelsDir / fs::path(label.file).filename()).string();
+        }
+        labels.push_back(std::move(label));
+    }
+
+    return true;
+}
+
+Sweep::Dataset Sweep::loadDataset(std::vector<Label> labels, unsigned threads)
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<uint16_t> pixels(labels.size() * PIXELS);
+    std::vector<char> loaded(labels.size(), 0);
+
+    // Raw binary files are exactly one frame long. Anything else is read as compact hex.
+    std::atomic<size_t> next = 0;
+    auto work = [&]() {
+        for (size_t i = next++; i < labels.size(); i = next++) {
+            std::error_code error;
+            const bool binary = fs::file_size(labels[i].file, error) == IMG_SIZE && !error;
+            const cv::Mat image = binary ? load_binary_image(labels[i].file) : load_compact_hex_image(labels[i].file);
+            if (image.empty()) continue;
+
+            std::memcpy(pixels.data() + i * PIXELS, image.ptr<uint16_t>(0), PIXELS * sizeof(uint16_t));
+            loaded[i] = 1;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) workers.emplace_back(work);
+    for (auto& worker : workers) worker.join();
+
+    // Interleave the frames into batches, leaving out the unreadable ones
+    Dataset dataset;
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (!loaded[i]) {
+            std::cerr << "Error: Skipping unreadable file " << labels[i].file << std::endl;
+            continue;
+        }
+        dataset.add(std::move(labels[i]), {pixels.data() + i * PIXELS, PIXELS});
+    }
+
+    return dataset;
+}
+
+std::vector<Sweep::Score> Sweep::run(const Dataset& dataset, const Space& space, const Options& options)
+{
+    const uint64_t count = options.random > 0 ? options.random : space.gridSize();
+    if (count > MAX_COMBINATIONS) {
+        std::cerr << "Error: " << count << " combinations is more than " << MAX_COMBINATIONS << ", narrow the grid or draw --random combinations" << std::endl;
+        return {};
+    }
+
+    const unsigned threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    Sweeper sweeper(dataset, space, options, count);
+    std::vector<Score> scores(count);
+
+    std::atomic<uint64_t> next = 0;
+    auto work = [&]() {
+        std::vector<uint8_t> masks(BATCH_LANES * PIXELS);
+        MicroCV2::Core::Workspace workspace;
+        for (uint64_t i = next++; i < count; i = next++) {
+            scores[i] = sweeper.evaluate(sweeper.combination(i), masks, workspace);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) workers.emplace_back(work);
+    for (auto& worker : workers) worker.join();
+
+    auto group = [](const Score& score) { return !score.valid ? 2 : score.pruned ? 1 : 0; };
+    std::stable_sort(scores.begin(), scores.end(), [&](const Score& a, const Score& b) {
+        if (group(a) != group(b)) return group(a) < group(b);
+        if (a.errors() != b.errors()) return a.errors() < b.errors();
+        return a.detectNs < b.detectNs;
+    });
+    return scores;
+}
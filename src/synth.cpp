@@ -0,0 +1,180 @@
+#include "synth.hpp"
+#include "image_io.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+    /**
+     * @brief SplitMix64. Small, fast, and gives the same sequence on every platform.
+     *
+     */
+    class Rng {
+    public:
+        explicit Rng(uint64_t seed) : m_state(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        /**
+         * @brief Uniform float in [min, max]
+         *
+         */
+        float uniform(const float min, const float max)
+        {
+            return min + (max - min) * static_cast<float>(next() >> 40) / static_cast<float>(1ULL << 24);
+        }
+
+        /**
+         * @brief Uniform integer in [min, max]
+         *
+         */
+        int uniformInt(const int min, const int max)
+        {
+            if (max <= min) return min;
+            return min + static_cast<int>(next() % static_cast<uint64_t>(max - min + 1));
+        }
+
+        bool chance(const float probability)
+        {
+            return uniform(0, 1) < probability;
+        }
+
+    private:
+        uint64_t m_state;
+    };
+
+    struct Color {
+        float red, green, blue;
+    };
+
+    /**
+     * @brief A colour in 16.16 fixed point, so the pixel loop needs no float math
+     *
+     */
+    struct FixedColor {
+        int32_t red, green, blue;
+
+        FixedColor(const Color& color, const float gain)
+            : red(static_cast<int32_t>(color.red * gain * 65536)),
+              green(static_cast<int32_t>(color.green * gain * 65536)),
+              blue(static_cast<int32_t>(color.blue * gain * 65536)) {}
+    };
+
+    /**
+     * @brief Round a 16.16 channel to a byte and scale it to the RGB565 channel range
+     *
+     */
+    inline uint16_t toChannel(const int32_t value, const int max)
+    {
+        const int byte = std::clamp((value + 0x8000) >> 16, 0, 255);
+        return static_cast<uint16_t>(byte * max / 255);
+    }
+
+}
+
+Synth::GroundTruth Synth::Generator::render(const uint64_t index, std::span<uint16_t> frame) const
+{
+    const SceneConfig& cfg = m_config;
+
+    // Seed every frame on its own so frames can be generated in any order
+    Rng rng(Rng(cfg.seed ^ (index * 0xD1B54A32D192ED03ULL)).next());
+
+    // Draw the scene
+    const float grey = rng.uniform(50, 130);
+    const Color road = {grey + rng.uniform(-8, 8), grey + rng.uniform(-8, 8), grey + rng.uniform(-8, 8)};
+    const Color red = {rng.uniform(190, 235), rng.uniform(20, 60), rng.uniform(20, 60)};
+    const float whiteLevel = rng.uniform(248, 255);
+    const Color white = {whiteLevel, whiteLevel, whiteLevel};
+
+    const bool hasWhite = rng.chance(cfg.whiteProbability);
+    const float whiteX = rng.uniform(cfg.whiteXMin, cfg.whiteXMax);
+    const float whiteSlope = rng.uniform(cfg.whiteSlopeMin, cfg.whiteSlopeMax);
+    const float whiteWidth = rng.uniform(cfg.whiteWidthMin, cfg.whiteWidthMax);
+
+    const bool hasStop = rng.chance(cfg.stopProbability);
+    const int stopY = rng.uniformInt(cfg.stopYMin, cfg.stopYMax);
+    const int stopHeight = rng.uniformInt(cfg.stopHeightMin, cfg.stopHeightMax);
+
+    const float light = rng.uniform(cfg.lightMin, cfg.lightMax);
+
+    // Paint the frame and count the ground truth pixels before lighting and noise
+    const int32_t noiseScale = static_cast<int32_t>(cfg.noise * 65536 / 0x3FF);
+    uint16_t redPixels = 0, whitePixels = 0;
+    for (int y = 0; y < IMG_ROWS; ++y) {
+        const float gain = light * (1 - cfg.gradient * (1 - static_cast<float>(y) / (IMG_ROWS - 1)));
+        const FixedColor roadRow(road, gain), redRow(red, gain), whiteRow(white, gain);
+
+        const bool stopRow = hasStop && y >= stopY && y < stopY + stopHeight;
+        const float lineLeft = whiteX + whiteSlope * (y - Params::WHITE_VERTICAL_CROP);
+        const float lineRight = lineLeft + whiteWidth;
+
+        for (int x = 0; x < IMG_COLS; ++x) {
+            const bool isWhite = hasWhite && x >= lineLeft && x < lineRight;
+            const bool isRed = stopRow && !isWhite;
+            const FixedColor& color = isWhite ? whiteRow : isRed ? redRow : roadRow;
+
+            if (isRed && x >= Params::STOPBOX_TL_X && x <= Params::STOPBOX_BR_X && y >= Params::STOPBOX_TL_Y && y <= Params::STOPBOX_BR_Y) {
+                redPixels++;
+            }
+            if (isWhite && y >= Params::WHITE_VERTICAL_CROP && x < Params::WHITE_HORIZONTAL_CROP) {
+                whitePixels++;
+            }
+
+            // Triangular noise from two 10 bit draws per channel, one 64 bit draw per pixel
+            const uint64_t bits = rng.next();
+            auto noise = [&](const int channel) {
+                const int32_t a = (bits >> (20 * channel)) & 0x3FF;
+                const int32_t b = (bits >> (20 * channel + 10)) & 0x3FF;
+                return noiseScale * (a + b - 0x3FF);
+            };
+
+            frame[y * IMG_COLS + x] = (toChannel(color.red + noise(0), 31) << 11) | (toChannel(color.green + noise(1), 63) << 5)
+                                    | toChannel(color.blue + noise(2), 31);
+        }
+    }
+
+    GroundTruth truth;
+    truth.redPercent = static_cast<uint16_t>(redPixels * 10000 / Params::STOPBOX_AREA);
+    truth.stop = truth.redPercent >= Params::PERCENT_TO_STOP * 100;
+    truth.whitePixels = whitePixels;
+    truth.white = whitePixels >= Params::WHITE_MIN_SIZE;
+    if (truth.white) {
+        // The first painted column of the crop row, clamped like the detector clamps dist
+        const int dist = static_cast<int>(std::ceil(whiteX)) - Params::WHITE_CENTER_POS;
+        truth.dist = static_cast<int8_t>(std::clamp<int>(dist, -Params::MAX_WHITE_DIST, Params::MAX_WHITE_DIST));
+    }
+    return truth;
+}
+
+bool Synth::writeBinary(const std::string& filename, std::span<const uint16_t> frame)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    file << encode_binary_image(frame);
+    return static_cast<bool>(file);
+}
+
+bool Synth::writeCompactHex(const std::string& filename, std::span<const uint16_t> frame)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    file << encode_compact_hex_image(frame);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,192 @@
+#include "trace.hpp"
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+        int32_t frame;
+    };
+
+    /**
+     * @brief Span storage owned by a single thread. The mutex is only ever contended while exporting.
+     *
+     */
+    struct ThreadBuffer {
+        uint32_t tid;
+        std::mutex mutex;
+        std::vector<Event> events;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    };
+
+    Registry& registry()
+    {
+        static Registry reg;
+        return reg;
+    }
+
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+            auto buf = std::make_shared<ThreadBuffer>();
+            buf->events.reserve(4096);
+
+            Registry& reg = registry();
+            std::lock_guard lock(reg.mutex);
+            buf->tid = static_cast<uint32_t>(reg.buffers.size());
+            reg.buffers.push_back(buf);
+            return buf;
+        }();
+        return *buffer;
+    }
+
+    thread_local int32_t t_frame = -1;
+
+    /**
+     * @brief Copy every recorded event out of the thread buffers
+     *
+     */
+    std::vector<std::pair<uint32_t, Event>> snapshot()
+    {
+        std::vector<std::pair<uint32_t, Event>> events;
+
+        Registry& reg = registry();
+        std::lock_guard lock(reg.mutex);
+        for (const auto& buf : reg.buffers) {
+            std::lock_guard bufLock(buf->mutex);
+            for (const auto& ev : buf->events) {
+                events.emplace_back(buf->tid, ev);
+            }
+        }
+
+        return events;
+    }
+
+    /**
+     * @brief Nearest-rank percentile of an already sorted list of durations
+     *
+     */
+    uint64_t percentile(const std::vector<uint64_t>& sorted, const uint32_t pct)
+    {
+        size_t rank = (sorted.size() * pct + 99) / 100;
+        if (rank == 0) rank = 1;
+        return sorted[rank - 1];
+    }
+
+    void writeJsonString(std::ofstream& out, std::string_view str)
+    {
+        out << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+
+}
+
+uint64_t Trace::nowNs()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadBuffer& buf = threadBuffer();
+    std::lock_guard lock(buf.mutex);
+    buf.events.push_back({name, startNs, endNs, t_frame});
+}
+
+void Trace::setFrame(int32_t frame)
+{
+    t_frame = frame;
+}
+
+int32_t Trace::currentFrame()
+{
+    return t_frame;
+}
+
+void Trace::clear()
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+    for (const auto& buf : reg.buffers) {
+        std::lock_guard bufLock(buf->mutex);
+        buf->events.clear();
+    }
+}
+
+bool Trace::writeChromeTrace(const std::string& filename)
+{
+    std::ofstream out(filename);
+    if (!out) {
+        fmt::println("Error: Could not open trace file {}", filename);
+        return false;
+    }
+
+    auto events = snapshot();
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& [tid, ev] : events) {
+        if (!first) out << ",";
+        first = false;
+
+        out << "\n{\"name\":";
+        writeJsonString(out, ev.name);
+        // Chrome trace timestamps are in microseconds, keep the nanoseconds as a fraction
+        out << fmt::format(",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+                           tid, ev.startNs / 1000.0, (ev.endNs - ev.startNs) / 1000.0);
+        if (ev.frame >= 0) {
+            out << ",\"args\":{\"frame\":" << ev.frame << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+
+    return static_cast<bool>(out);
+}
+
+void Trace::printSummary()
+{
+    std::map<std::string_view, std::vector<uint64_t>> durations;
+    for (const auto& [tid, ev] : snapshot()) {
+        durations[ev.name].push_back(ev.endNs - ev.startNs);
+    }
+
+    if (durations.empty()) {
+        fmt::println("No trace spans were recorded.");
+        return;
+    }
+
+    fmt::println("{:<28} {:>8} {:>12} {:>12} {:>12} {:>12}", "stage", "count", "mean (us)", "p50 (us)", "p95 (us)", "p99 (us)");
+    for (auto& [name, durs] : durations) {
+        std::sort(durs.begin(), durs.end());
+
+        uint64_t total = 0;
+        for (uint64_t d : durs) total += d;
+
+        fmt::println("{:<28} {:>8} {:>12.2f} {:>12.2f} {:>12.2f} {:>12.2f}", name, durs.size(),
+                     total / 1000.0 / durs.size(), percentile(durs, 50) / 1000.0,
+                     percentile(durs, 95) / 1000.0, percentile(durs, 99) / 1000.0);
+    }
+}
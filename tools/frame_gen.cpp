@@ -0,0 +1,210 @@
+#include "cli.hpp"
+#include "microcv2_core.hpp"
+#include "synth.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Generate synthetic frames with ground truth for load, throughput, and accuracy testing.
+ *
+ * The bin and hex formats write one file per frame into DIR, named so the viewer and the batch mode pick
+ * them up from --bin-dir and --hex-dir, plus a truth.csv with the expected detector output of every frame.
+ * The memory format only renders the frames, for timing the generator and the detectors without disk I/O.
+ * --check 1 runs the core detectors on every frame and reports how often they agree with the ground truth,
+ * with the mask morphology given by --stop-morph, --white-morph, and --morph-shape.
+ *
+ * Usage:
+ *   FrameGen [--count N] [--start I] [--format bin|hex|memory] [--out DIR] [--seed S] [--check 1]
+ *            [--white-prob P] [--white-slope-min S] [--white-slope-max S] [--white-width-min W] [--white-width-max W]
+ *            [--stop-prob P] [--noise A] [--light-min G] [--light-max G] [--gradient G]
+ *            [--stop-morph OP] [--white-morph OP] [--morph-shape cross|square]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  FrameGen [--count N] [--start I] [--format bin|hex|memory] [--out DIR] [--seed S] [--check 1]");
+        fmt::println("           [--white-prob P] [--white-slope-min S] [--white-slope-max S]");
+        fmt::println("           [--white-width-min W] [--white-width-max W]");
+        fmt::println("           [--stop-prob P] [--noise A] [--light-min G] [--light-max G] [--gradient G]");
+        fmt::println("           [--stop-morph OP] [--white-morph OP] [--morph-shape cross|square]");
+    }
+
+    double elapsedSeconds(const clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    /**
+     * @brief Agreement between the core detectors and the ground truth
+     *
+     */
+    struct Accuracy {
+        uint64_t frames = 0;
+        uint64_t stopCorrect = 0;
+        uint64_t whiteCorrect = 0;
+        uint64_t distFrames = 0;        ///< Frames where both the truth and the detector have a line
+        uint64_t distExact = 0;
+        uint64_t distAbsError = 0;
+        uint64_t detectNs = 0;
+
+        void add(const Synth::GroundTruth& truth, std::span<const uint16_t> frame, std::span<uint8_t> mask,
+                 MicroCV2::Core::Workspace& ws, const MicroCV2::Core::Config& cfg)
+        {
+            using namespace MicroCV2;
+
+            auto start = clock_type::now();
+            const Core::BoxResult red = Core::processRed(frame, IMG_COLS, IMG_ROWS, mask, cfg);
+            const Core::WhiteResult white = Core::processWhite(frame, IMG_COLS, IMG_ROWS, mask, ws, cfg);
+            detectNs += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+
+            frames++;
+            stopCorrect += red.detected == truth.stop;
+            whiteCorrect += white.detected == truth.white;
+            if (white.detected && truth.white) {
+                const int error = std::abs(white.line.dist - truth.dist);
+                distFrames++;
+                distExact += error == 0;
+                distAbsError += error;
+            }
+        }
+
+        void print() const
+        {
+            if (frames == 0) return;
+
+            auto percent = [](const uint64_t count, const uint64_t total) { return total > 0 ? 100.0 * count / total : 0.0; };
+            fmt::println("Accuracy against ground truth:");
+            fmt::println("  stop: {:.2f}%, white line: {:.2f}%", percent(stopCorrect, frames), percent(whiteCorrect, frames));
+            if (distFrames > 0) {
+                fmt::println("  dist: {:.2f}% exact, mean absolute error {:.3f} over {} frames", percent(distExact, distFrames),
+                             static_cast<double>(distAbsError) / distFrames, distFrames);
+            }
+            fmt::println("  detectors: {:.2f} us/frame", detectNs / 1000.0 / frames);
+        }
+    };
+
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc - 1) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    auto text = [&](const char* name, const char* fallback) {
+        return options.contains(name) ? options.at(name) : std::string(fallback);
+    };
+
+    Synth::SceneConfig scene;
+    uint64_t count = 1000;
+    uint64_t first = 0;
+    if (!Cli::parseOption(options, "--seed", scene.seed) || !Cli::parseOption(options, "--white-prob", scene.whiteProbability)
+        || !Cli::parseOption(options, "--white-slope-min", scene.whiteSlopeMin) || !Cli::parseOption(options, "--white-slope-max", scene.whiteSlopeMax)
+        || !Cli::parseOption(options, "--white-width-min", scene.whiteWidthMin) || !Cli::parseOption(options, "--white-width-max", scene.whiteWidthMax)
+        || !Cli::parseOption(options, "--stop-prob", scene.stopProbability) || !Cli::parseOption(options, "--noise", scene.noise)
+        || !Cli::parseOption(options, "--light-min", scene.lightMin) || !Cli::parseOption(options, "--light-max", scene.lightMax)
+        || !Cli::parseOption(options, "--gradient", scene.gradient) || !Cli::parseOption(options, "--count", count)
+        || !Cli::parseOption(options, "--start", first)) {
+        printUsage();
+        return 2;
+    }
+    const std::string format = text("--format", "bin");
+    const std::string outDir = text("--out", "synthetic_images");
+    const bool check = options.contains("--check") && options.at("--check") != "0";
+
+    MicroCV2::Core::Config config;
+    MicroCV2::Morph::Op stopMorph = MicroCV2::Morph::Op::NONE, whiteMorph = MicroCV2::Morph::Op::NONE;
+    MicroCV2::Morph::Shape shape = MicroCV2::Morph::Shape::CROSS;
+    if (!MicroCV2::Morph::parseOp(text("--stop-morph", "none"), stopMorph) || !MicroCV2::Morph::parseOp(text("--white-morph", "none"), whiteMorph)
+        || !MicroCV2::Morph::parseShape(text("--morph-shape", "cross"), shape)) {
+        printUsage();
+        return 2;
+    }
+    config.STOP_MORPHOLOGY = static_cast<uint8_t>(stopMorph);
+    config.WHITE_MORPHOLOGY = static_cast<uint8_t>(whiteMorph);
+    config.MORPH_SHAPE = static_cast<uint8_t>(shape);
+
+    if (format != "bin" && format != "hex" && format != "memory") {
+        printUsage();
+        return 2;
+    }
+    const bool toDisk = format != "memory";
+
+    std::ofstream truthFile;
+    if (toDisk) {
+        std::filesystem::create_directories(outDir);
+        const std::string truthPath = (std::filesystem::path(outDir) / "truth.csv").string();
+        truthFile.open(truthPath);
+        if (!truthFile) {
+            std::cerr << "Error: Could not open file " << truthPath << std::endl;
+            return 1;
+        }
+        truthFile << "stop,white,dist,red_percent,white_pixels,file\n";
+    }
+
+    Synth::Generator generator(scene);
+    std::vector<uint16_t> frame(IMG_ROWS * IMG_COLS);
+    std::vector<uint8_t> mask(IMG_ROWS * IMG_COLS);
+    MicroCV2::Core::Workspace workspace;
+    Accuracy accuracy;
+
+    uint64_t renderNs = 0, checksum = 0;
+    auto start = clock_type::now();
+    for (uint64_t index = first; index < first + count; ++index) {
+        auto renderStart = clock_type::now();
+        const Synth::GroundTruth truth = generator.render(index, frame);
+        renderNs += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - renderStart).count();
+        checksum += frame[index % frame.size()];    // Keeps the memory format from being optimized away
+
+        if (toDisk) {
+            std::string filename;
+            bool written;
+            if (format == "bin") {
+                filename = (std::filesystem::path(outDir) / fmt::format("SYNTH{:08}.BIN", index)).string();
+                written = Synth::writeBinary(filename, frame);
+            } else {
+                filename = (std::filesystem::path(outDir) / fmt::format("compact_hex_synth_{:08}.bin", index)).string();
+                written = Synth::writeCompactHex(filename, frame);
+            }
+            if (!written) return 1;
+
+            truthFile << fmt::format("{},{},{},{},{},{}\n", truth.stop ? 1 : 0, truth.white ? 1 : 0, truth.dist,
+                                     truth.redPercent, truth.whitePixels, filename);
+        }
+
+        if (check) {
+            accuracy.add(truth, frame, mask, workspace, config);
+        }
+    }
+    const double seconds = elapsedSeconds(start);
+
+    fmt::println("Generated {} frames (seed {}) in {:.3f} s, {:.0f} frames/s, {:.2f} us/frame rendering", count, scene.seed,
+                 seconds, count / seconds, count > 0 ? renderNs / 1000.0 / count : 0.0);
+    if (toDisk) {
+        fmt::println("  wrote {} files and truth.csv to {}", format, outDir);
+    } else {
+        fmt::println("  {:.1f} MB of frames rendered in memory (checksum {})", count * IMG_SIZE / 1e6, checksum);
+    }
+    accuracy.print();
+
+    return 0;
+}
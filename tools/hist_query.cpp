@@ -0,0 +1,152 @@
+#include "cli.hpp"
+#include "hist_index.hpp"
+#include "image_io.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Build and query the per-frame RGB565 histogram index.
+ *
+ * Usage:
+ *   HistQuery build INDEX [--hex-dir DIR] [--bin-dir DIR]
+ *   HistQuery stop INDEX [--green-tol N] [--blue-tol N] [--percent N] [--list 1]
+ *   HistQuery car INDEX [--red-tol N] [--blue-tol N] [--percent N] [--list 1]
+ *   HistQuery white INDEX [--red N] [--green N] [--blue N] [--min-count N] [--list 1]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  HistQuery build INDEX [--hex-dir DIR] [--bin-dir DIR]");
+        fmt::println("  HistQuery stop INDEX [--green-tol N] [--blue-tol N] [--percent N] [--list 1]");
+        fmt::println("  HistQuery car INDEX [--red-tol N] [--blue-tol N] [--percent N] [--list 1]");
+        fmt::println("  HistQuery white INDEX [--red N] [--green N] [--blue N] [--min-count N] [--list 1]");
+    }
+
+    double elapsedMs(const clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    int buildIndex(const std::string& indexFile, const std::map<std::string, std::string>& options)
+    {
+        auto start = clock_type::now();
+
+        std::vector<std::string> extensions = {".bin", ".BIN"};
+        auto hexDir = options.contains("--hex-dir") ? options.at("--hex-dir") : std::string("../hex_images/");
+        auto binDir = options.contains("--bin-dir") ? options.at("--bin-dir") : std::string("../binary_images/");
+
+        // A file that cannot be read would otherwise be indexed as a frame with no pixels in any region
+        HistIndex::Index index;
+        auto add = [&](const std::string& filename, const cv::Mat& image) {
+            if (image.empty()) {
+                std::cerr << "Error: Skipping unreadable file " << filename << std::endl;
+                return;
+            }
+            index.add(filename, image);
+        };
+        for (const auto& filename : get_filenames_in_dir(hexDir, extensions)) {
+            add(filename, load_compact_hex_image(filename));
+        }
+        for (const auto& filename : get_filenames_in_dir(binDir, extensions)) {
+            add(filename, load_binary_image(filename));
+        }
+
+        if (!index.save(indexFile)) return 1;
+
+        fmt::println("Indexed {} frames into {} in {:.1f} ms", index.size(), indexFile, elapsedMs(start));
+        return 0;
+    }
+
+    template <typename T>
+    void printMatches(const HistIndex::Index& index, const std::vector<T>& matches, const double ms, const bool list)
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < matches.size(); ++i) {
+            if (!matches[i]) continue;
+            total++;
+            if (list) fmt::println("  {}", index.frame(i).source);
+        }
+        fmt::println("{} of {} frames match ({:.3f} ms)", total, index.size(), ms);
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || (argc - 3) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    const std::string command = argv[1];
+    const std::string indexFile = argv[2];
+
+    std::map<std::string, std::string> options;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    bool valid = true;
+    auto option = [&](const char* name, uint8_t value) {
+        valid = Cli::parseOption(options, name, value) && valid;
+        return value;
+    };
+    const bool list = options.contains("--list") && options.at("--list") != "0";
+
+    if (command == "build") {
+        return buildIndex(indexFile, options);
+    }
+
+    HistIndex::Index index;
+    if (!index.load(indexFile)) return 1;
+
+    auto start = clock_type::now();
+    if (command == "stop") {
+        HistIndex::StopThresholds thresholds;
+        thresholds.greenTolerance = option("--green-tol", thresholds.greenTolerance);
+        thresholds.blueTolerance = option("--blue-tol", thresholds.blueTolerance);
+        thresholds.percentToStop = option("--percent", thresholds.percentToStop);
+        if (!valid) return 2;
+
+        auto flags = index.stopFlags(thresholds);
+        printMatches(index, flags, elapsedMs(start), list);
+    } else if (command == "car") {
+        HistIndex::CarThresholds thresholds;
+        thresholds.redTolerance = option("--red-tol", thresholds.redTolerance);
+        thresholds.blueTolerance = option("--blue-tol", thresholds.blueTolerance);
+        thresholds.percentToCar = option("--percent", thresholds.percentToCar);
+        if (!valid) return 2;
+
+        auto flags = index.carFlags(thresholds);
+        printMatches(index, flags, elapsedMs(start), list);
+    } else if (command == "white") {
+        HistIndex::WhiteThresholds thresholds;
+        thresholds.red = option("--red", thresholds.red);
+        thresholds.green = option("--green", thresholds.green);
+        thresholds.blue = option("--blue", thresholds.blue);
+        uint16_t minCount = Params::WHITE_MIN_SIZE;
+        if (!valid || !Cli::parseOption(options, "--min-count", minCount)) return 2;
+
+        auto counts = index.whiteCounts(thresholds);
+        std::vector<uint8_t> matches(counts.size());
+        for (size_t i = 0; i < counts.size(); ++i) {
+            matches[i] = counts[i] >= minCount;
+        }
+        printMatches(index, matches, elapsedMs(start), list);
+    } else {
+        printUsage();
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+#include "cli.hpp"
+#include "image_io.hpp"
+#include "ingest.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Replay the bundled captures to an IngestServer over several concurrent connections.
+ *
+ * Every stream sends all the captures --loops times at --rate frames per second (0 sends as fast as the
+ * server accepts them), checks that the results come back in order and match the detectors run locally,
+ * and records the time from sending each frame to receiving its result.
+ *
+ * Usage:
+ *   IngestReplay [--host ADDR] [--port P] [--streams K] [--rate FPS] [--loops N] [--encoding raw|hex]
+ *                [--hex-dir DIR] [--bin-dir DIR]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  IngestReplay [--host ADDR] [--port P] [--streams K] [--rate FPS] [--loops N] [--encoding raw|hex]");
+        fmt::println("               [--hex-dir DIR] [--bin-dir DIR]");
+    }
+
+    /**
+     * @brief What one stream saw
+     *
+     */
+    struct StreamReport {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        uint64_t outOfOrder = 0;
+        uint64_t mismatches = 0;
+        std::vector<int64_t> latencyNs;
+        bool failed = false;
+    };
+
+    int connectTo(const std::string& host, const uint16_t port)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            std::cerr << "Error: Invalid server address " << host << std::endl;
+            return -1;
+        }
+
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "Error: Could not connect to " << host << ":" << port << ": " << std::strerror(errno) << std::endl;
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+
+        const int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        return fd;
+    }
+
+    bool sendAll(const int fd, std::string_view data)
+    {
+        while (!data.empty()) {
+            const ssize_t bytes = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data.remove_prefix(bytes);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Send every frame on one connection while a second thread reads and checks the results
+     *
+     */
+    StreamReport runStream(const std::string& host, const uint16_t port, const std::string& handshake,
+                           const std::vector<std::string>& payloads, const std::vector<Ingest::FrameResult>& expected,
+                           const uint64_t loops, const double rate)
+    {
+        StreamReport report;
+        const uint64_t total = payloads.size() * loops;
+
+        const int fd = connectTo(host, port);
+        if (fd < 0) {
+            report.failed = true;
+            return report;
+        }
+
+        std::vector<clock_type::time_point> sendTimes(total);
+        std::mutex sendTimesMutex;
+        bool replyFailed = false;   // Set by the reader only, merged into the report once it has joined
+
+        std::thread reader([&] {
+            std::string buffer;
+            char chunk[4096];
+            uint64_t nextSeq = 0;
+
+            while (true) {
+                const ssize_t bytes = recv(fd, chunk, sizeof(chunk), 0);
+                if (bytes < 0 && errno == EINTR) continue;
+                if (bytes <= 0) break;
+                const auto now = clock_type::now();
+                buffer.append(chunk, bytes);
+
+                size_t pos = 0, newline;
+                while ((newline = buffer.find('\n', pos)) != std::string::npos) {
+                    std::string_view line(buffer.data() + pos, newline - pos);
+                    pos = newline + 1;
+
+                    Ingest::FrameResult result;
+                    if (!Ingest::parseResult(line, result) || result.seq >= total) {
+                        std::cerr << "Error: Unexpected reply from the server: " << line << std::endl;
+                        replyFailed = true;
+                        continue;
+                    }
+
+                    report.received++;
+                    report.outOfOrder += result.seq != nextSeq;
+                    nextSeq = result.seq + 1;
+
+                    const Ingest::FrameResult& truth = expected[result.seq % expected.size()];
+                    report.mismatches += result.stop != truth.stop || result.white != truth.white || result.dist != truth.dist
+                                         || result.redPercent != truth.redPercent;
+
+                    std::lock_guard lock(sendTimesMutex);
+                    report.latencyNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sendTimes[result.seq]).count());
+                }
+                buffer.erase(0, pos);
+            }
+        });
+
+        bool sent = sendAll(fd, handshake + "\n");
+        const auto start = clock_type::now();
+        for (uint64_t seq = 0; sent && seq < total; ++seq) {
+            if (rate > 0) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seq / rate)));
+            }
+            {
+                std::lock_guard lock(sendTimesMutex);
+                sendTimes[seq] = clock_type::now();
+            }
+            sent = sendAll(fd, payloads[seq % payloads.size()]);
+            report.sent += sent;
+        }
+        if (!sent) {
+            std::cerr << "Error: Sending to the server failed: " << std::strerror(errno) << std::endl;
+            report.failed = true;
+        }
+
+        // The server answers the frames it still has and then closes the connection
+        shutdown(fd, SHUT_WR);
+        reader.join();
+        ::close(fd);
+        report.failed |= replyFailed;
+        return report;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc - 1) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    auto text = [&](const char* name, const char* fallback) {
+        return options.contains(name) ? options.at(name) : std::string(fallback);
+    };
+
+    const std::string host = text("--host", "127.0.0.1");
+    uint16_t port = Ingest::DEFAULT_PORT;
+    unsigned int streams = 4;
+    double rate = 0;
+    uint64_t loops = 10;
+    const std::string encoding = text("--encoding", "raw");
+
+    if (!Cli::parseOption(options, "--port", port) || !Cli::parseOption(options, "--streams", streams)
+        || !Cli::parseOption(options, "--rate", rate) || !Cli::parseOption(options, "--loops", loops)
+        || (encoding != "raw" && encoding != "hex")) {
+        printUsage();
+        return 2;
+    }
+    streams = std::max(1u, streams);
+    loops = std::max<uint64_t>(1, loops);
+
+    // Load the captures and encode every frame once, so the streams only have to send them
+    std::vector<std::string> extensions = {".bin", ".BIN"};
+    auto hexFiles = get_filenames_in_dir(text("--hex-dir", "../hex_images/"), extensions);
+    auto binFiles = get_filenames_in_dir(text("--bin-dir", "../binary_images/"), extensions);
+    std::vector<cv::Mat> images = load_compact_hex_images(hexFiles);
+    auto binImages = load_binary_images(binFiles);
+    images.insert(images.end(), binImages.begin(), binImages.end());
+    std::erase_if(images, [](const cv::Mat& image) { return image.empty(); });
+
+    if (images.empty()) {
+        std::cerr << "Error: No frames to replay" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> payloads;
+    std::vector<Ingest::FrameResult> expected;
+    for (const cv::Mat& image : images) {
+        std::span<const uint16_t> pixels(image.ptr<uint16_t>(), image.total());
+        payloads.push_back(encoding == "raw" ? encode_binary_image(pixels) : encode_compact_hex_image(pixels));
+        expected.push_back(Ingest::detect(pixels));
+    }
+    const std::string handshake(encoding == "raw" ? Ingest::HANDSHAKE_RAW : Ingest::HANDSHAKE_HEX);
+
+    fmt::println("Replaying {} frames {} times on each of {} streams to {}:{}", images.size(), loops, streams, host, port);
+
+    std::vector<StreamReport> reports(streams);
+    std::vector<std::thread> threads;
+    auto start = clock_type::now();
+    for (unsigned int s = 0; s < streams; ++s) {
+        threads.emplace_back([&, s] { reports[s] = runStream(host, port, handshake, payloads, expected, loops, rate); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    StreamReport total;
+    for (const StreamReport& report : reports) {
+        total.sent += report.sent;
+        total.received += report.received;
+        total.outOfOrder += report.outOfOrder;
+        total.mismatches += report.mismatches;
+        total.failed |= report.failed;
+        total.latencyNs.insert(total.latencyNs.end(), report.latencyNs.begin(), report.latencyNs.end());
+    }
+    std::sort(total.latencyNs.begin(), total.latencyNs.end());
+
+    auto percentileMs = [&](const double p) {
+        if (total.latencyNs.empty()) return 0.0;
+        const size_t index = std::min(total.latencyNs.size() - 1, static_cast<size_t>(p * total.latencyNs.size()));
+        return total.latencyNs[index] / 1e6;
+    };
+
+    fmt::println("Sent {} frames, received {} results in {:.3f} s, {:.0f} frames/s", total.sent, total.received, seconds,
+                 seconds > 0 ? total.received / seconds : 0.0);
+    fmt::println("  latency p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms", percentileMs(0.5), percentileMs(0.99),
+                 total.latencyNs.empty() ? 0.0 : total.latencyNs.back() / 1e6);
+    fmt::println("  {} out of order, {} mismatching the local detectors", total.outOfOrder, total.mismatches);
+
+    const bool ok = !total.failed && total.received == total.sent && total.outOfOrder == 0 && total.mismatches == 0;
+    return ok ? 0 : 1;
+}
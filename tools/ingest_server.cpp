@@ -0,0 +1,86 @@
+#include "cli.hpp"
+#include "ingest.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <map>
+#include <string>
+
+/**
+ * @brief Accept frames from any number of robots over TCP and answer each frame with its detection result.
+ *
+ * See include/ingest.hpp for the protocol. Use --host 0.0.0.0 to accept robots on the LAN. Ctrl+C stops
+ * the server and prints what it has done. --ring NAME also publishes every answered frame to a shared
+ * memory frame ring that RingDetect and ESPViewer --ring NAME can read. --coarse N runs the detectors
+ * coarse-to-fine, sampling every Nth row and column first (2 to 8).
+ *
+ * Usage:
+ *   IngestServer [--host ADDR] [--port P] [--workers N] [--max-in-flight N] [--ring NAME] [--ring-slots N] [--coarse N]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    Ingest::Server* runningServer = nullptr;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  IngestServer [--host ADDR] [--port P] [--workers N] [--max-in-flight N] [--ring NAME] [--ring-slots N] [--coarse N]");
+    }
+
+    void handleSignal(int)
+    {
+        if (runningServer) runningServer->stop();
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc - 1) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+
+    Ingest::ServerOptions serverOptions;
+    if (options.contains("--host")) serverOptions.host = options.at("--host");
+    if (options.contains("--ring")) serverOptions.ring = options.at("--ring");
+    if (!Cli::parseOption(options, "--port", serverOptions.port) || !Cli::parseOption(options, "--workers", serverOptions.workers)
+        || !Cli::parseOption(options, "--max-in-flight", serverOptions.maxInFlight)
+        || !Cli::parseOption(options, "--ring-slots", serverOptions.ringSlots)
+        || !Cli::parseOption(options, "--coarse", serverOptions.config.COARSE_FACTOR, uint8_t{2}, uint8_t{8})) {
+        printUsage();
+        return 2;
+    }
+    serverOptions.maxInFlight = std::max<size_t>(1, serverOptions.maxInFlight);
+
+    Ingest::Server server(serverOptions);
+    if (!server.listen()) return 1;
+
+    runningServer = &server;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    fmt::println("Listening on {}:{}", serverOptions.host, server.port());
+    auto start = clock_type::now();
+    server.run();
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    runningServer = nullptr;
+
+    const Ingest::ServerStats stats = server.stats();
+    fmt::println("Answered {} frames from {} connections in {:.1f} s, {:.0f} frames/s, {:.1f} MB received",
+                 stats.frames, stats.connections, seconds, seconds > 0 ? stats.frames / seconds : 0.0, stats.bytesIn / 1e6);
+    fmt::println("  connections throttled {} times", stats.throttled);
+
+    return 0;
+}
@@ -0,0 +1,864 @@
+#include "cli.hpp"
+#include "frame_batch.hpp"
+#include "image_io.hpp"
+#include "kernels.hpp"
+#include "microcv2.hpp"
+#include "microcv2_core.hpp"
+#include "microcv2_reference.hpp"
+#include "opencv2.hpp"
+
+#include <fmt/core.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Differential harness that checks every optimized variant of the MicroCV2 detectors against the
+ * frozen reference implementations in MicroCV2::Reference.
+ *
+ * Every bundled capture, an exhaustive sweep of all RGB565 values, a set of adversarial frames, and any
+ * number of randomly generated frames are run through the reference and each registered variant. The
+ * flags, distances, and masks must match exactly. The speedup of every variant over the reference is
+ * reported at the end.
+ *
+ * Usage: MicroCV2Diff [--random N] [--seed S] [--variant NAME] [--hex-dir DIR] [--bin-dir DIR] [--dump DIR]
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * @brief An optimized implementation of the MicroCV2 detectors. Any entry may be left null if the
+     * variant does not provide that detector.
+     *
+     */
+    struct Variant {
+        const char* name;
+        bool (*processRedImg)(const cv::Mat&, cv::Mat1b&);
+        bool (*processCarImg)(const cv::Mat&, cv::Mat1b&);
+        bool (*processWhiteImg)(const cv::Mat&, cv::Mat1b&, cv::Mat1b&, int8_t&);
+        void (*RGB565toRGB888)(const uint16_t, uint16_t&, uint16_t&, uint16_t&);
+        bool exactMasks = true;     ///< False for variants that only visit part of the frame, so only flags and distances are compared
+    };
+
+    /**
+     * @brief Coarse-to-fine detectors at a given decimation
+     *
+     */
+    template <uint8_t FACTOR>
+    struct Coarse {
+        static constexpr MicroCV2::Core::Config CONFIG = [] {
+            MicroCV2::Core::Config cfg;
+            cfg.COARSE_FACTOR = FACTOR;
+            return cfg;
+        }();
+
+        static bool processRedImg(const cv::Mat& image, cv::Mat1b& mask)
+        {
+            return MicroCV2::processRedImg(image, mask, CONFIG);
+        }
+
+        static bool processWhiteImg(const cv::Mat& image, cv::Mat1b& mask, cv::Mat1b& centerLine, int8_t& dist)
+        {
+            return MicroCV2::processWhiteImg(image, mask, centerLine, dist, CONFIG);
+        }
+    };
+
+    /**
+     * @brief Every variant checked by the harness. Register new fast paths here. The MicroCV2 detectors are
+     * adapters over MicroCV2::Core, so the first entry checks the OpenCV-free core end to end.
+     *
+     */
+    const std::vector<Variant> VARIANTS = {
+        {"MicroCV2", &MicroCV2::processRedImg, &MicroCV2::processCarImg, &MicroCV2::processWhiteImg, &MicroCV2::RGB565toRGB888},
+        {"MicroCV2::Core", nullptr, nullptr, nullptr, &MicroCV2::Core::RGB565toRGB888},
+        {"CoarseToFine2", &Coarse<2>::processRedImg, nullptr, &Coarse<2>::processWhiteImg, nullptr, false},
+        {"CoarseToFine4", &Coarse<4>::processRedImg, nullptr, &Coarse<4>::processWhiteImg, nullptr, false},
+        {"CoarseToFine8", &Coarse<8>::processRedImg, nullptr, &Coarse<8>::processWhiteImg, nullptr, false},
+    };
+
+    enum Detector { RED, CAR, WHITE, NUM_DETECTORS };
+    constexpr const char* DETECTOR_NAMES[NUM_DETECTORS] = {"processRedImg", "processCarImg", "processWhiteImg"};
+
+    struct Output {
+        bool flag = false;
+        int8_t dist = 0;
+        cv::Mat1b mask;
+        cv::Mat1b centerLine;
+    };
+
+    struct Timing {
+        uint64_t ns[NUM_DETECTORS] = {};
+        uint64_t calls[NUM_DETECTORS] = {};
+    };
+
+    struct Options {
+        uint64_t randomFrames = 100000;
+        uint64_t seed = 0x5AFE7047;
+        std::string variant;
+        std::string hexDir = "../hex_images/";
+        std::string binDir = "../binary_images/";
+        std::string dumpDir;
+    };
+
+    constexpr size_t MAX_REPORTED_MISMATCHES = 20;
+
+    void setPixel(cv::Mat& image, const int y, const int x, const uint16_t pixel)
+    {
+        image.ptr<uint16_t>(y)[x] = pixel;
+    }
+
+    cv::Mat filledFrame(const uint16_t pixel)
+    {
+        return cv::Mat(IMG_ROWS, IMG_COLS, FRAME_TYPE, cv::Scalar(pixel));
+    }
+
+    /**
+     * @brief Convert a canonical frame into the high byte first CV_8UC2 layout the reference red and
+     * white detectors read, which is also the layout of the raw binary files
+     *
+     */
+    cv::Mat toReferenceLayout(const cv::Mat& frame)
+    {
+        cv::Mat image(frame.rows, frame.cols, CV_8UC2);
+        for (int y = 0; y < frame.rows; ++y) {
+            const uint16_t* src = frame.ptr<uint16_t>(y);
+            uint8_t* dst = image.ptr<uint8_t>(y);
+            for (int x = 0; x < frame.cols; ++x) {
+                dst[2 * x] = static_cast<uint8_t>(src[x] >> 8);
+                dst[2 * x + 1] = static_cast<uint8_t>(src[x] & 0xFF);
+            }
+        }
+        return image;
+    }
+
+    /**
+     * @brief View a canonical frame as CV_8UC2 for the reference car detector. It reads each pixel as a
+     * native uint16_t, so handing it the canonical buffer makes it see the same pixel values as the others.
+     *
+     */
+    cv::Mat toReferenceCarLayout(const cv::Mat& frame)
+    {
+        return cv::Mat(frame.rows, frame.cols, CV_8UC2, const_cast<uint8_t*>(frame.ptr<uint8_t>()), frame.step);
+    }
+
+    bool sameMask(const cv::Mat1b& a, const cv::Mat1b& b)
+    {
+        if (a.empty() || b.empty()) return a.empty() == b.empty();
+        if (a.rows != b.rows || a.cols != b.cols) return false;
+
+        for (int row = 0; row < a.rows; ++row) {
+            if (std::memcmp(a.ptr<uint8_t>(row), b.ptr<uint8_t>(row), a.cols) != 0) return false;
+        }
+        return true;
+    }
+
+    int countMask(const cv::Mat1b& mask)
+    {
+        return mask.empty() ? 0 : cv::countNonZero(mask);
+    }
+
+    /**
+     * @brief Pools of RGB565 values grouped by how the reference classifiers see them
+     *
+     */
+    struct PixelPools {
+        std::vector<uint16_t> white;
+        std::vector<uint16_t> red;
+        std::vector<uint16_t> car;
+        std::vector<uint16_t> other;
+    };
+
+    PixelPools buildPixelPools()
+    {
+        PixelPools pools;
+        for (uint32_t value = 0; value <= 0xFFFF; ++value) {
+            uint16_t red, green, blue;
+            MicroCV2::Reference::RGB565toRGB888(value, red, green, blue);
+
+            if (MicroCV2::Reference::isWhiteLine(red, green, blue)) {
+                pools.white.push_back(value);
+            } else if (MicroCV2::Reference::isStopLine(red, green, blue)) {
+                pools.red.push_back(value);
+            } else if (green >= red + Params::CAR_RED_TOLERANCE && green >= blue + Params::CAR_BLUE_TOLERANCE) {
+                pools.car.push_back(value);
+            } else {
+                pools.other.push_back(value);
+            }
+        }
+        return pools;
+    }
+
+    class Harness {
+    public:
+        Harness(const Options& options) : m_options(options)
+        {
+            for (const auto& variant : VARIANTS) {
+                if (m_options.variant.empty() || m_options.variant == variant.name) {
+                    m_variants.push_back(&variant);
+                }
+            }
+            m_variantTimings.resize(m_variants.size());
+            m_variantMismatches.resize(m_variants.size(), 0);
+
+            m_checkBatch = m_options.variant.empty() || m_options.variant == BATCH_NAME;
+            m_batchMasks.resize(BATCH_LANES * IMG_ROWS * IMG_COLS);
+        }
+
+        bool hasVariants() const { return !m_variants.empty() || m_checkBatch; }
+
+        /**
+         * @brief Run one frame through the reference and every variant and compare the outputs
+         *
+         * @param image - The canonical CV_16UC1 frame
+         * @param source - Description of where the frame came from for mismatch reports
+         */
+        void checkFrame(const cv::Mat& image, const std::string& source)
+        {
+            const cv::Mat referenceImage = toReferenceLayout(image);
+            const cv::Mat referenceCarImage = toReferenceCarLayout(image);
+
+            Output ref[NUM_DETECTORS];
+            runDetectors(referenceImage, referenceCarImage, ref, m_referenceTiming, &MicroCV2::Reference::processRedImg,
+                         &MicroCV2::Reference::processCarImg, &MicroCV2::Reference::processWhiteImg);
+
+            for (size_t v = 0; v < m_variants.size(); ++v) {
+                const Variant& variant = *m_variants[v];
+
+                Output out[NUM_DETECTORS];
+                runDetectors(image, image, out, m_variantTimings[v], variant.processRedImg, variant.processCarImg, variant.processWhiteImg);
+
+                bool frameOk = true;
+                for (int d = 0; d < NUM_DETECTORS; ++d) {
+                    if (!hasDetector(variant, static_cast<Detector>(d))) continue;
+
+                    bool ok = out[d].flag == ref[d].flag
+                           && out[d].dist == ref[d].dist
+                           && (!variant.exactMasks || (sameMask(out[d].mask, ref[d].mask)
+                                                       && sameMask(out[d].centerLine, ref[d].centerLine)));
+                    if (!ok) {
+                        frameOk = false;
+                        reportMismatch(variant.name, DETECTOR_NAMES[d], source, ref[d], out[d]);
+                    }
+                }
+
+                if (!frameOk) {
+                    m_variantMismatches[v]++;
+                    dumpFrame(referenceImage, variant.name, source);
+                }
+            }
+
+            if (m_checkBatch) {
+                queueBatchFrame(image, referenceImage, source, ref);
+            }
+
+            m_frames++;
+        }
+
+        /**
+         * @brief Run the frame-batched kernels over the frames queued so far and compare them with the
+         * reference results recorded when they were queued
+         *
+         */
+        void flushBatch()
+        {
+            if (m_pending.empty()) return;
+
+            Output out[NUM_DETECTORS][BATCH_LANES];
+
+            auto start = clock_type::now();
+            auto red = MicroCV2::Core::processRed(m_batch);
+            m_batchTiming.ns[RED] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+
+            start = clock_type::now();
+            auto car = MicroCV2::Core::processCar(m_batch);
+            m_batchTiming.ns[CAR] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+
+            start = clock_type::now();
+            auto white = MicroCV2::Core::processWhite(m_batch, m_batchMasks, m_workspace);
+            m_batchTiming.ns[WHITE] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+
+            for (size_t lane = 0; lane < m_pending.size(); ++lane) {
+                out[RED][lane].flag = red[lane].detected;
+                out[CAR][lane].flag = car[lane].detected;
+                out[WHITE][lane].flag = white[lane].detected;
+                out[WHITE][lane].dist = white[lane].detected ? white[lane].line.dist : 0;
+
+                const PendingFrame& frame = m_pending[lane];
+                bool frameOk = true;
+                for (int d = 0; d < NUM_DETECTORS; ++d) {
+                    m_batchTiming.calls[d]++;
+
+                    if (out[d][lane].flag != frame.ref[d].flag || out[d][lane].dist != frame.ref[d].dist) {
+                        frameOk = false;
+                        reportMismatch(BATCH_NAME, DETECTOR_NAMES[d], frame.source, frame.ref[d], out[d][lane]);
+                    }
+                }
+
+                if (!frameOk) {
+                    m_batchMismatches++;
+                    dumpFrame(frame.referenceImage, BATCH_NAME, frame.source);
+                }
+            }
+
+            m_batch.clear();
+            m_pending.clear();
+        }
+
+        /**
+         * @brief Exhaustively compare RGB565toRGB888 over every possible pixel value
+         *
+         */
+        void checkColorConversion()
+        {
+            for (size_t v = 0; v < m_variants.size(); ++v) {
+                const Variant& variant = *m_variants[v];
+                if (variant.RGB565toRGB888 == nullptr) continue;
+
+                for (uint32_t value = 0; value <= 0xFFFF; ++value) {
+                    uint16_t rr, rg, rb, vr, vg, vb;
+                    MicroCV2::Reference::RGB565toRGB888(value, rr, rg, rb);
+                    variant.RGB565toRGB888(value, vr, vg, vb);
+
+                    if (rr != vr || rg != vg || rb != vb) {
+                        m_variantMismatches[v]++;
+                        if (m_reported++ < MAX_REPORTED_MISMATCHES) {
+                            fmt::println("MISMATCH {} RGB565toRGB888(0x{:04X}): reference ({},{},{}) variant ({},{},{})",
+                                         variant.name, value, rr, rg, rb, vr, vg, vb);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Exhaustively compare every kernel table this CPU supports against the reference over every
+         * pixel value, whatever ESPVIEWER_KERNELS selected
+         *
+         */
+        void checkKernels()
+        {
+            constexpr size_t VALUES = 0x10000;
+
+            std::vector<uint16_t> values(VALUES);
+            std::vector<char> hex(VALUES * 4);
+            for (size_t i = 0; i < VALUES; ++i) {
+                values[i] = static_cast<uint16_t>(i);
+                // The firmware prints the byte swapped word
+                std::string word = fmt::format("{:04X}", static_cast<uint16_t>((i << 8) | (i >> 8)));
+                std::memcpy(hex.data() + 4 * i, word.data(), 4);
+            }
+
+            const uint8_t color[3] = {10, 20, 30};
+            std::vector<uint8_t> mask(VALUES), bgr(VALUES * 3), layered(VALUES * 3);
+            std::vector<uint16_t> decoded(VALUES);
+
+            for (const Kernels::KernelTable* table : Kernels::supportedTables()) {
+                uint64_t mismatches = 0;
+                auto check = [&](const char* kernel, size_t value, bool ok) {
+                    if (ok) return;
+                    mismatches++;
+                    if (m_reported++ < MAX_REPORTED_MISMATCHES) {
+                        fmt::println("MISMATCH kernels/{} {}(0x{:04X})", table->name, kernel, value);
+                    }
+                };
+                const MicroCV2::Core::Config& cfg = MicroCV2::Core::DEFAULT_CONFIG;
+
+                table->classifyStop(values.data(), mask.data(), VALUES, cfg);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    uint16_t red, green, blue;
+                    MicroCV2::Reference::RGB565toRGB888(values[i], red, green, blue);
+                    bool stop = MicroCV2::Reference::isStopLine(red, green, blue) && !MicroCV2::Reference::isWhiteLine(red, green, blue);
+                    check("classifyStop", i, (mask[i] == 255) == stop && (mask[i] == 0 || mask[i] == 255));
+                }
+
+                table->classifyWhite(values.data(), mask.data(), VALUES, cfg);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    uint16_t red, green, blue;
+                    MicroCV2::Reference::RGB565toRGB888(values[i], red, green, blue);
+                    check("classifyWhite", i, (mask[i] == 255) == MicroCV2::Reference::isWhiteLine(red, green, blue));
+                }
+
+                table->classifyCar(values.data(), mask.data(), VALUES, cfg);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    uint16_t red, green, blue;
+                    MicroCV2::Reference::RGB565toRGB888(values[i], red, green, blue);
+                    bool car = green >= red + Params::CAR_RED_TOLERANCE && green >= blue + Params::CAR_BLUE_TOLERANCE;
+                    check("classifyCar", i, (mask[i] == 255) == car);
+                }
+
+                table->rgb565ToBgr888(values.data(), bgr.data(), VALUES);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    uint16_t red, green, blue;
+                    MicroCV2::Reference::RGB565toRGB888(values[i], red, green, blue);
+                    check("rgb565ToBgr888", i, bgr[3 * i] == blue && bgr[3 * i + 1] == green && bgr[3 * i + 2] == red);
+                }
+
+                // Low byte as the mask and the converted pixels as the layer exercise every combination
+                for (size_t i = 0; i < VALUES; ++i) mask[i] = static_cast<uint8_t>(i);
+                table->colorizeMask(mask.data(), layered.data(), VALUES, color);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    bool set = mask[i] != 0;
+                    check("colorizeMask", i, layered[3 * i] == (set ? color[0] : 0) && layered[3 * i + 1] == (set ? color[1] : 0)
+                                             && layered[3 * i + 2] == (set ? color[2] : 0));
+                }
+
+                table->layerMask(layered.data(), bgr.data(), VALUES);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    bool black = bgr[3 * i] == 0 && bgr[3 * i + 1] == 0 && bgr[3 * i + 2] == 0;
+                    bool set = mask[i] != 0;
+                    for (int c = 0; c < 3; ++c) {
+                        uint8_t expected = black ? (set ? color[c] : 0) : bgr[3 * i + c];
+                        check("layerMask", i, layered[3 * i + c] == expected);
+                    }
+                }
+
+                bool valid = table->decodeHex(hex.data(), VALUES, decoded.data());
+                check("decodeHex", 0, valid);
+                for (size_t i = 0; i < VALUES; ++i) {
+                    check("decodeHex", i, decoded[i] == values[i]);
+                }
+                for (char invalid : {'g', 'G', 'x', ' ', '-', '+', '/', ':', '@', '`'}) {
+                    char word[4] = {'1', invalid, '2', '3'};
+                    uint16_t pixel;
+                    check("decodeHex rejects", static_cast<uint8_t>(invalid), !table->decodeHex(word, 1, &pixel));
+                }
+
+                m_kernelMismatches.emplace_back(table->name, mismatches);
+            }
+        }
+
+        /**
+         * @brief Print the mismatch counts and speedups of every variant
+         *
+         * @return true - If every variant matched the reference on every frame
+         */
+        bool printReport() const
+        {
+            fmt::println("");
+            fmt::println("Checked {} frames against the reference.", m_frames);
+            fmt::println("{:<20} {:<18} {:>14} {:>14} {:>10}", "variant", "detector", "ref (us/frame)", "var (us/frame)", "speedup");
+
+            bool allOk = true;
+            for (size_t v = 0; v < m_variants.size(); ++v) {
+                for (int d = 0; d < NUM_DETECTORS; ++d) {
+                    const auto& vt = m_variantTimings[v];
+                    if (vt.calls[d] == 0 || m_referenceTiming.calls[d] == 0) continue;
+
+                    double refUs = m_referenceTiming.ns[d] / 1000.0 / m_referenceTiming.calls[d];
+                    double varUs = vt.ns[d] / 1000.0 / vt.calls[d];
+                    fmt::println("{:<20} {:<18} {:>14.3f} {:>14.3f} {:>9.2f}x", m_variants[v]->name, DETECTOR_NAMES[d],
+                                 refUs, varUs, varUs > 0 ? refUs / varUs : 0.0);
+                }
+
+                if (m_variantMismatches[v] != 0) allOk = false;
+                fmt::println("{:<20} {} mismatching frames", m_variants[v]->name, m_variantMismatches[v]);
+            }
+
+            for (const auto& [name, mismatches] : m_kernelMismatches) {
+                if (mismatches != 0) allOk = false;
+                fmt::println("kernels/{:<12} {} mismatching values{}", name, mismatches,
+                             name == std::string(Kernels::active().name) ? " (active)" : "");
+            }
+
+            if (m_checkBatch) {
+                for (int d = 0; d < NUM_DETECTORS; ++d) {
+                    if (m_batchTiming.calls[d] == 0 || m_referenceTiming.calls[d] == 0) continue;
+
+                    double refUs = m_referenceTiming.ns[d] / 1000.0 / m_referenceTiming.calls[d];
+                    double varUs = m_batchTiming.ns[d] / 1000.0 / m_batchTiming.calls[d];
+                    fmt::println("{:<20} {:<18} {:>14.3f} {:>14.3f} {:>9.2f}x", BATCH_NAME, DETECTOR_NAMES[d],
+                                 refUs, varUs, varUs > 0 ? refUs / varUs : 0.0);
+                }
+
+                if (m_batchMismatches != 0) allOk = false;
+                fmt::println("{:<20} {} mismatching frames", BATCH_NAME, m_batchMismatches);
+            }
+
+            return allOk;
+        }
+
+    private:
+        static constexpr size_t BATCH_LANES = 16;
+        static constexpr const char* BATCH_NAME = "FrameBatch16";
+
+        /**
+         * @brief A frame waiting in the batch along with what the reference reported for it
+         *
+         */
+        struct PendingFrame {
+            std::string source;
+            cv::Mat referenceImage;
+            Output ref[NUM_DETECTORS];
+        };
+
+        void queueBatchFrame(const cv::Mat& image, const cv::Mat& referenceImage, const std::string& source,
+                             const Output ref[NUM_DETECTORS])
+        {
+            const cv::Mat continuous = image.isContinuous() ? image : image.clone();
+            m_batch.push({continuous.ptr<uint16_t>(), continuous.total()});
+
+            PendingFrame frame;
+            frame.source = source;
+            frame.referenceImage = referenceImage;
+            for (int d = 0; d < NUM_DETECTORS; ++d) {
+                frame.ref[d].flag = ref[d].flag;
+                frame.ref[d].dist = ref[d].dist;
+            }
+            m_pending.push_back(std::move(frame));
+
+            if (m_batch.full()) flushBatch();
+        }
+
+        template <typename RedFn, typename CarFn, typename WhiteFn>
+        static void runDetectors(const cv::Mat& image, const cv::Mat& carImage, Output out[NUM_DETECTORS], Timing& timing,
+                                 RedFn red, CarFn car, WhiteFn white)
+        {
+            if (red != nullptr) {
+                auto start = clock_type::now();
+                out[RED].flag = red(image, out[RED].mask);
+                timing.ns[RED] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+                timing.calls[RED]++;
+            }
+            if (car != nullptr) {
+                auto start = clock_type::now();
+                out[CAR].flag = car(carImage, out[CAR].mask);
+                timing.ns[CAR] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+                timing.calls[CAR]++;
+            }
+            if (white != nullptr) {
+                auto start = clock_type::now();
+                out[WHITE].flag = white(image, out[WHITE].mask, out[WHITE].centerLine, out[WHITE].dist);
+                timing.ns[WHITE] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+                timing.calls[WHITE]++;
+            }
+        }
+
+        static bool hasDetector(const Variant& variant, const Detector detector)
+        {
+            switch (detector) {
+                case RED: return variant.processRedImg != nullptr;
+                case CAR: return variant.processCarImg != nullptr;
+                case WHITE: return variant.processWhiteImg != nullptr;
+                default: return false;
+            }
+        }
+
+        void reportMismatch(const char* variant, const char* detector, const std::string& source,
+                            const Output& ref, const Output& out)
+        {
+            if (m_reported++ >= MAX_REPORTED_MISMATCHES) return;
+
+            fmt::println("MISMATCH {} {} on {}: flag {}/{} dist {}/{} mask count {}/{} centerLine count {}/{}",
+                         variant, detector, source, ref.flag, out.flag, ref.dist, out.dist,
+                         countMask(ref.mask), countMask(out.mask), countMask(ref.centerLine), countMask(out.centerLine));
+        }
+
+        /**
+         * @brief Save a mismatching frame in the raw binary format so it can be replayed in the viewer
+         *
+         * @param image - The frame in the reference CV_8UC2 layout
+         */
+        void dumpFrame(const cv::Mat& image, const char* variant, const std::string& source)
+        {
+            if (m_options.dumpDir.empty()) return;
+
+            std::string name = fmt::format("{}_{}", variant, source);
+            for (char& c : name) {
+                if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+            }
+
+            fs::create_directories(m_options.dumpDir);
+            std::ofstream file(fs::path(m_options.dumpDir) / (name + ".BIN"), std::ios::binary);
+            cv::Mat continuous = image.isContinuous() ? image : image.clone();
+            file.write(reinterpret_cast<const char*>(continuous.ptr<uint8_t>()), IMG_SIZE);
+        }
+
+        const Options& m_options;
+        std::vector<const Variant*> m_variants;
+
+        Timing m_referenceTiming;
+        std::vector<Timing> m_variantTimings;
+        std::vector<uint64_t> m_variantMismatches;
+
+        bool m_checkBatch = false;
+        MicroCV2::Core::FrameBatch<BATCH_LANES> m_batch;
+        std::vector<PendingFrame> m_pending;
+        std::vector<uint8_t> m_batchMasks;
+        MicroCV2::Core::Workspace m_workspace;
+        Timing m_batchTiming;
+        uint64_t m_batchMismatches = 0;
+
+        std::vector<std::pair<std::string, uint64_t>> m_kernelMismatches;
+
+        uint64_t m_frames = 0;
+        size_t m_reported = 0;
+    };
+
+    void checkBundledCaptures(Harness& harness, const Options& options)
+    {
+        std::vector<std::string> extensions = {".bin", ".BIN"};
+
+        auto hexFiles = get_filenames_in_dir(options.hexDir, extensions);
+        for (const auto& filename : hexFiles) {
+            harness.checkFrame(load_compact_hex_image(filename), filename);
+        }
+
+        auto binFiles = get_filenames_in_dir(options.binDir, extensions);
+        for (const auto& filename : binFiles) {
+            harness.checkFrame(load_binary_image(filename), filename);
+        }
+
+        fmt::println("Checked {} bundled captures.", hexFiles.size() + binFiles.size());
+    }
+
+    /**
+     * @brief Pack every RGB565 value into as few frames as possible so the classifiers see all of them
+     *
+     */
+    void checkAllPixelValues(Harness& harness)
+    {
+        constexpr uint32_t PIXELS = IMG_ROWS * IMG_COLS;
+
+        for (uint32_t base = 0; base <= 0xFFFF; base += PIXELS) {
+            cv::Mat image(IMG_ROWS, IMG_COLS, FRAME_TYPE);
+            for (uint32_t i = 0; i < PIXELS; ++i) {
+                setPixel(image, i / IMG_COLS, i % IMG_COLS, static_cast<uint16_t>((base + i) & 0xFFFF));
+            }
+            harness.checkFrame(image, fmt::format("all_values_from_{:04X}", base));
+        }
+    }
+
+    /**
+     * @brief Frames built to sit on the edges of the detectors' decisions
+     *
+     */
+    void checkAdversarialFrames(Harness& harness, const PixelPools& pools)
+    {
+        const uint16_t white = pools.white.front();
+        const uint16_t red = pools.red.front();
+        const uint16_t car = pools.car.front();
+        const uint16_t other = pools.other.front();
+
+        // Uniform frames of every class
+        harness.checkFrame(filledFrame(white), "uniform_white");
+        harness.checkFrame(filledFrame(red), "uniform_red");
+        harness.checkFrame(filledFrame(car), "uniform_car");
+        harness.checkFrame(filledFrame(other), "uniform_other");
+
+        // Stop box filled with exactly the number of pixels around the stop threshold
+        const int stopThreshold = (Params::PERCENT_TO_STOP * Params::STOPBOX_AREA + 99) / 100;
+        for (int count = stopThreshold - 3; count <= stopThreshold + 3; ++count) {
+            cv::Mat image = filledFrame(other);
+            int placed = 0;
+            for (int y = Params::STOPBOX_TL_Y; y <= Params::STOPBOX_BR_Y && placed < count; ++y) {
+                for (int x = Params::STOPBOX_TL_X; x <= Params::STOPBOX_BR_X && placed < count; ++x, ++placed) {
+                    setPixel(image, y, x, red);
+                }
+            }
+            harness.checkFrame(image, fmt::format("stop_threshold_{}", count));
+        }
+
+        // Car box filled with exactly the number of pixels around the car threshold
+        const int carThreshold = (Params::PERCENT_TO_CAR * Params::CARBOX_AREA + 99) / 100;
+        for (int count = carThreshold - 3; count <= carThreshold + 3; ++count) {
+            cv::Mat image = filledFrame(other);
+            int placed = 0;
+            for (int y = Params::CARBOX_TL_Y; y <= Params::CARBOX_BR_Y && placed < count; ++y) {
+                for (int x = Params::CARBOX_TL_X; x <= Params::CARBOX_BR_X && placed < count; ++x, ++placed) {
+                    setPixel(image, y, x, car);
+                }
+            }
+            harness.checkFrame(image, fmt::format("car_threshold_{}", count));
+        }
+
+        // White checkerboards produce the largest possible number of contours
+        for (int cell = 1; cell <= 4; ++cell) {
+            cv::Mat image = filledFrame(other);
+            for (int y = 0; y < IMG_ROWS; ++y) {
+                for (int x = 0; x < IMG_COLS; ++x) {
+                    if (((y / cell) + (x / cell)) % 2 == 0) setPixel(image, y, x, white);
+                }
+            }
+            harness.checkFrame(image, fmt::format("checkerboard_{}", cell));
+        }
+
+        // Thin lines at every angle, including vertical lines that make the fitted slope infinite
+        for (int x0 = -IMG_COLS; x0 < 2 * IMG_COLS; x0 += 3) {
+            for (int x1 : {0, 10, 28, 50, 74, 75, 95}) {
+                for (int thickness : {1, 2, 6}) {
+                    cv::Mat image = filledFrame(other);
+                    for (int y = 0; y < IMG_ROWS; ++y) {
+                        int xc = x0 + (x1 - x0) * y / (IMG_ROWS - 1);
+                        for (int x = xc; x < xc + thickness; ++x) {
+                            if (x >= 0 && x < IMG_COLS) setPixel(image, y, x, white);
+                        }
+                    }
+                    harness.checkFrame(image, fmt::format("line_{}_{}_{}", x0, x1, thickness));
+                }
+            }
+        }
+
+        // Rectangles around the minimum blob size and touching the crop edges
+        for (int w = 1; w <= 12; ++w) {
+            for (int h = 1; h <= 12; ++h) {
+                const std::pair<int, int> origins[] = {{0, Params::WHITE_VERTICAL_CROP}, {Params::WHITE_HORIZONTAL_CROP - w, IMG_ROWS - h},
+                                                       {30, 70}, {0, IMG_ROWS - h}};
+                for (auto [x0, y0] : origins) {
+                    cv::Mat image = filledFrame(other);
+                    for (int y = y0; y < y0 + h; ++y) {
+                        for (int x = x0; x < x0 + w; ++x) {
+                            setPixel(image, y, x, white);
+                        }
+                    }
+                    harness.checkFrame(image, fmt::format("rect_{}x{}_at_{}_{}", w, h, x0, y0));
+                }
+            }
+        }
+
+        // Thin strips between the rows or columns of a decimated grid, with a speck on the grid elsewhere so a
+        // coarse pass does not simply fall back for finding nothing
+        for (int offset = 0; offset < 16; ++offset) {
+            for (int thickness : {1, 2, 3, 7}) {
+                for (bool vertical : {false, true}) {
+                    cv::Mat image = filledFrame(other);
+                    setPixel(image, Params::WHITE_VERTICAL_CROP, 0, white);
+                    for (int i = 0; i < thickness; ++i) {
+                        for (int j = 20; j < 60; ++j) {
+                            const int y = vertical ? Params::WHITE_VERTICAL_CROP + 2 + j / 2 : Params::WHITE_VERTICAL_CROP + 4 + offset + i;
+                            const int x = vertical ? 30 + offset + i : j;
+                            if (y < IMG_ROWS && x < Params::WHITE_HORIZONTAL_CROP) setPixel(image, y, x, white);
+                        }
+                    }
+                    harness.checkFrame(image, fmt::format("strip_{}_{}_{}", vertical ? "v" : "h", offset, thickness));
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Randomly generated frames. Most are blobs, lines, and speckle drawn from the classifier pools
+     * so the detectors actually fire; the rest are uniformly random pixels.
+     *
+     */
+    void checkRandomFrames(Harness& harness, const PixelPools& pools, const Options& options)
+    {
+        std::mt19937_64 rng(options.seed);
+        auto pick = [&](const std::vector<uint16_t>& pool) {
+            return pool[std::uniform_int_distribution<size_t>(0, pool.size() - 1)(rng)];
+        };
+        std::uniform_int_distribution<int> coord(0, IMG_COLS - 1);
+
+        for (uint64_t i = 0; i < options.randomFrames; ++i) {
+            cv::Mat image(IMG_ROWS, IMG_COLS, FRAME_TYPE);
+            const int kind = static_cast<int>(i % 4);
+
+            if (kind == 0) {
+                // Uniform random pixels
+                for (int y = 0; y < IMG_ROWS; ++y) {
+                    for (int x = 0; x < IMG_COLS; ++x) {
+                        setPixel(image, y, x, static_cast<uint16_t>(rng()));
+                    }
+                }
+            } else {
+                // Speckle at a random density over a random background
+                const double whiteDensity = std::uniform_real_distribution<double>(0.0, kind == 1 ? 0.6 : 0.05)(rng);
+                const double redDensity = std::uniform_real_distribution<double>(0.0, 0.5)(rng);
+                std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+                for (int y = 0; y < IMG_ROWS; ++y) {
+                    for (int x = 0; x < IMG_COLS; ++x) {
+                        double r = unit(rng);
+                        uint16_t pixel = r < whiteDensity ? pick(pools.white)
+                                       : r < whiteDensity + redDensity ? pick(pools.red)
+                                       : r < whiteDensity + redDensity + 0.05 ? pick(pools.car)
+                                       : pick(pools.other);
+                        setPixel(image, y, x, pixel);
+                    }
+                }
+
+                // Random solid white blobs
+                if (kind >= 2) {
+                    const int blobs = std::uniform_int_distribution<int>(1, 4)(rng);
+                    for (int b = 0; b < blobs; ++b) {
+                        int x0 = coord(rng), y0 = coord(rng), x1 = coord(rng), y1 = coord(rng);
+                        int thickness = std::uniform_int_distribution<int>(1, 12)(rng);
+                        for (int y = std::min(y0, y1); y <= std::max(y0, y1); ++y) {
+                            int xc = y1 == y0 ? x0 : x0 + (x1 - x0) * (y - y0) / (y1 - y0);
+                            for (int x = xc; x < xc + thickness && x < IMG_COLS; ++x) {
+                                if (x >= 0) setPixel(image, y, x, pick(pools.white));
+                            }
+                        }
+                    }
+                }
+            }
+
+            harness.checkFrame(image, fmt::format("random_seed{}_frame{}", options.seed, i));
+        }
+
+        fmt::println("Checked {} random frames with seed {}.", options.randomFrames, options.seed);
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                fmt::println("Missing value for {}", arg);
+                return false;
+            }
+
+            std::string value = argv[++i];
+            if (arg == "--random") {
+                if (!Cli::parseValue(arg, value, options.randomFrames)) return false;
+            } else if (arg == "--seed") {
+                if (!Cli::parseValue(arg, value, options.seed)) return false;
+            } else if (arg == "--variant") options.variant = value;
+            else if (arg == "--hex-dir") options.hexDir = value;
+            else if (arg == "--bin-dir") options.binDir = value;
+            else if (arg == "--dump") options.dumpDir = value;
+            else {
+                fmt::println("Unknown option {}", arg);
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fmt::println("Usage: MicroCV2Diff [--random N] [--seed S] [--variant NAME] [--hex-dir DIR] [--bin-dir DIR] [--dump DIR]");
+        return 2;
+    }
+
+    Harness harness(options);
+    if (!harness.hasVariants()) {
+        fmt::println("No variant named {}", options.variant);
+        return 2;
+    }
+
+    const PixelPools pools = buildPixelPools();
+
+    harness.checkColorConversion();
+    harness.checkKernels();
+    checkBundledCaptures(harness, options);
+    checkAllPixelValues(harness);
+    checkAdversarialFrames(harness, pools);
+    checkRandomFrames(harness, pools, options);
+    harness.flushBatch();
+
+    return harness.printReport() ? 0 : 1;
+}
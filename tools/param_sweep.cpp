@@ -0,0 +1,151 @@
+#include "cli.hpp"
+#include "sweep.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Tune detector parameters by scoring a grid or random draws of them against labeled frames.
+ *
+ * LABELS is a CSV with stop, dist, and file columns, such as the truth.csv FrameGen writes. SPACE lists the
+ * parameters to tune and their candidate values, see include/sweep.hpp. Prints the score of the current
+ * parameters and the --top best combinations by frames with a wrong stop flag or dist, with ties broken
+ * by detector time. --out writes every combination to a CSV, best first.
+ *
+ * Usage:
+ *   ParamSweep --labels LABELS --space SPACE [--random N] [--seed S] [--top K] [--threads T] [--out FILE]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  ParamSweep --labels LABELS --space SPACE [--random N] [--seed S] [--top K] [--threads T] [--out FILE]");
+        fmt::println("--random 0 runs every combination of the grid.");
+    }
+
+    double elapsedSeconds(const clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    std::string status(const Sweep::Score& score)
+    {
+        return !score.valid ? "invalid" : score.pruned ? "pruned" : "complete";
+    }
+
+    void printScore(const std::string& rank, const Sweep::Score& score, const uint64_t frames, const std::string& values)
+    {
+        auto percent = [&](const uint64_t errors) { return frames > 0 ? 100.0 * (frames - errors) / frames : 0.0; };
+        fmt::println("{:>6}  {:>7}  {:>7.2f}%  {:>7.2f}%  {:>8.3f}  {:>8.2f}  {}", rank, score.errors(), percent(score.stopErrors),
+                     percent(score.distErrors), frames > 0 ? static_cast<double>(score.distAbsError) / frames : 0.0,
+                     score.detectNs / 1000.0, values);
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc - 1) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    if (!options.contains("--labels") || !options.contains("--space")) {
+        printUsage();
+        return 2;
+    }
+
+    Sweep::Options sweepOptions;
+    if (!Cli::parseOption(options, "--random", sweepOptions.random) || !Cli::parseOption(options, "--seed", sweepOptions.seed)
+        || !Cli::parseOption(options, "--top", sweepOptions.top) || !Cli::parseOption(options, "--threads", sweepOptions.threads)) {
+        printUsage();
+        return 2;
+    }
+
+    Sweep::Space space;
+    if (!Sweep::loadSpace(options.at("--space"), space)) return 1;
+
+    std::vector<Sweep::Label> labels;
+    if (!Sweep::loadLabels(options.at("--labels"), labels)) return 1;
+
+    auto start = clock_type::now();
+    const Sweep::Dataset dataset = Sweep::loadDataset(std::move(labels), sweepOptions.threads);
+    fmt::println("Decoded {} labeled frames in {:.2f} s ({:.1f} MB)", dataset.size(), elapsedSeconds(start),
+                 dataset.bytes() / 1e6);
+    if (dataset.size() == 0) {
+        std::cerr << "Error: No labeled frames could be read" << std::endl;
+        return 1;
+    }
+
+    // The current parameters, for reference. A single combination, however many random draws the sweep makes.
+    Sweep::Options baselineOptions = sweepOptions;
+    baselineOptions.random = 0;
+    baselineOptions.top = 1;
+    const std::vector<Sweep::Score> baseline = Sweep::run(dataset, Sweep::Space{}, baselineOptions);
+
+    const uint64_t count = sweepOptions.random > 0 ? sweepOptions.random : space.gridSize();
+    fmt::println("Scoring {} {} combinations of {} parameters", count, sweepOptions.random > 0 ? "random" : "grid",
+                 space.parameters.size());
+
+    start = clock_type::now();
+    const std::vector<Sweep::Score> scores = Sweep::run(dataset, space, sweepOptions);
+    const double seconds = elapsedSeconds(start);
+    if (scores.empty()) return 1;
+
+    const auto complete = std::count_if(scores.begin(), scores.end(), [](const Sweep::Score& s) { return s.valid && !s.pruned; });
+    const auto pruned = std::count_if(scores.begin(), scores.end(), [](const Sweep::Score& s) { return s.pruned; });
+    fmt::println("Swept in {:.2f} s, {:.1f} ms per combination: {} complete, {} pruned early, {} invalid", seconds,
+                 1000.0 * seconds / scores.size(), complete, pruned, scores.size() - complete - pruned);
+
+    fmt::println("");
+    fmt::println("{:>6}  {:>7}  {:>8}  {:>8}  {:>8}  {:>8}  {}", "rank", "errors", "stop", "dist", "dist MAE", "us/frame", "parameters");
+    printScore("base", baseline.front(), dataset.size(), "params.hpp");
+
+    auto describe = [&](const Sweep::Score& score) {
+        std::string text;
+        for (size_t i = 0; i < space.parameters.size(); ++i) {
+            text += fmt::format("{}{}={}", i > 0 ? " " : "", space.parameters[i].name, score.values[i]);
+        }
+        return text;
+    };
+    for (size_t i = 0; i < std::min<size_t>(sweepOptions.top, complete); ++i) {
+        printScore(std::to_string(i + 1), scores[i], dataset.size(), describe(scores[i]));
+    }
+
+    if (options.contains("--out")) {
+        std::ofstream out(options.at("--out"));
+        if (!out) {
+            std::cerr << "Error: Could not open file " << options.at("--out") << std::endl;
+            return 1;
+        }
+
+        out << "rank,status,frames,errors,stop_errors,dist_errors,dist_abs_error,detect_ns";
+        for (const auto& parameter : space.parameters) out << "," << parameter.name;
+        out << "\n";
+        for (size_t i = 0; i < scores.size(); ++i) {
+            const Sweep::Score& score = scores[i];
+            out << fmt::format("{},{},{},{},{},{},{},{:.0f}", i + 1, status(score), score.frames, score.errors(), score.stopErrors,
+                               score.distErrors, score.distAbsError, score.detectNs);
+            for (int value : score.values) out << "," << value;
+            out << "\n";
+        }
+        fmt::println("Wrote {} combinations to {}", scores.size(), options.at("--out"));
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "cli.hpp"
+#include "params.hpp"
+#include "results_store.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Filter the columnar results store written by the batch merge.
+ *
+ * Every filter is optional and they are combined with AND. Each one is applied to a whole column of a
+ * chunk at a time, so a scan only touches the columns the query uses.
+ *
+ * Usage:
+ *   ResultsQuery STORE [--stop 0|1] [--white 0|1] [--dist-min N] [--dist-max N] [--saturated 1]
+ *                      [--red-min P] [--red-max P] [--area-min A] [--area-max A] [--list 1]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  ResultsQuery STORE [--stop 0|1] [--white 0|1] [--dist-min N] [--dist-max N] [--saturated 1]");
+        fmt::println("                     [--red-min P] [--red-max P] [--area-min A] [--area-max A] [--list 1]");
+        fmt::println("Red percentages are times 100, so --red-min 2000 matches frames with at least 20% red.");
+    }
+
+    double elapsedMs(const clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    /**
+     * @brief Clear the selection of every row where the predicate fails on the column value
+     *
+     */
+    template <typename T, typename Predicate>
+    void filter(std::vector<uint8_t>& selected, std::span<const T> column, Predicate&& predicate)
+    {
+        for (size_t row = 0; row < column.size(); ++row) {
+            selected[row] &= predicate(column[row]) ? 1 : 0;
+        }
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || (argc - 2) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    const std::string storeFile = argv[1];
+
+    std::map<std::string, std::string> options;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    // Every option is a number, so read them all before scanning
+    std::map<std::string, double> values;
+    for (const auto& [name, text] : options) {
+        if (!Cli::parseValue(name, text, values[name])) {
+            printUsage();
+            return 2;
+        }
+    }
+    auto has = [&](const char* name) { return values.contains(name); };
+    auto value = [&](const char* name) { return values.at(name); };
+    const bool list = has("--list") && value("--list") != 0;
+
+    Results::Reader reader;
+    if (!reader.open(storeFile)) return 1;
+
+    auto start = clock_type::now();
+
+    uint64_t total = 0;
+    std::vector<std::vector<uint8_t>> selections(reader.chunks().size());
+    for (size_t c = 0; c < reader.chunks().size(); ++c) {
+        const Results::Chunk& chunk = reader.chunks()[c];
+        std::vector<uint8_t>& selected = selections[c];
+        selected.assign(chunk.size(), 1);
+
+        if (has("--stop")) {
+            const uint8_t want = value("--stop") != 0;
+            filter(selected, chunk.stops, [&](uint8_t stop) { return stop == want; });
+        }
+        if (has("--white")) {
+            const uint8_t want = value("--white") != 0;
+            filter(selected, chunk.whites, [&](uint8_t white) { return white == want; });
+        }
+        if (has("--saturated") && value("--saturated") != 0) {
+            // Only frames with a line report a distance, and the clamp is symmetric around the center
+            filter(selected, chunk.whites, [](uint8_t white) { return white != 0; });
+            filter(selected, chunk.dists, [](int8_t dist) { return dist == Params::MAX_WHITE_DIST || dist == -Params::MAX_WHITE_DIST; });
+        }
+        if (has("--dist-min")) {
+            const int min = static_cast<int>(value("--dist-min"));
+            filter(selected, chunk.dists, [&](int8_t dist) { return dist >= min; });
+        }
+        if (has("--dist-max")) {
+            const int max = static_cast<int>(value("--dist-max"));
+            filter(selected, chunk.dists, [&](int8_t dist) { return dist <= max; });
+        }
+        if (has("--red-min")) {
+            const double min = value("--red-min");
+            filter(selected, chunk.redPercents, [&](uint16_t percent) { return percent >= min; });
+        }
+        if (has("--red-max")) {
+            const double max = value("--red-max");
+            filter(selected, chunk.redPercents, [&](uint16_t percent) { return percent <= max; });
+        }
+        if (has("--area-min")) {
+            const float min = static_cast<float>(value("--area-min"));
+            filter(selected, chunk.blobAreas, [&](float area) { return area >= min; });
+        }
+        if (has("--area-max")) {
+            const float max = static_cast<float>(value("--area-max"));
+            filter(selected, chunk.blobAreas, [&](float area) { return area <= max; });
+        }
+
+        for (size_t row = 0; row < chunk.size(); ++row) {
+            total += selected[row];
+        }
+    }
+    const double ms = elapsedMs(start);
+
+    if (list) {
+        for (size_t c = 0; c < reader.chunks().size(); ++c) {
+            const Results::Chunk& chunk = reader.chunks()[c];
+            for (size_t row = 0; row < chunk.size(); ++row) {
+                if (!selections[c][row]) continue;
+                fmt::println("  {} {} stop={} white={} dist={} red={:.2f}% area={}", chunk.frameIds[row], chunk.source(row),
+                             chunk.stops[row], chunk.whites[row], chunk.dists[row], chunk.redPercents[row] / 100.0,
+                             chunk.blobAreas[row]);
+            }
+        }
+    }
+
+    fmt::println("{} of {} frames match ({:.3f} ms)", total, reader.rows(), ms);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "cli.hpp"
+#include "frame_ring.hpp"
+#include "microcv2_core.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Run the detectors on every frame of a shared memory frame ring, reading the frames in place.
+ *
+ * Reports the frame rate, the frames it dropped by falling behind the producer, and the hand-off latency
+ * from the producer publishing a frame to this process starting on it, once per --report interval. Frames
+ * the producer already attached results to are checked against the detectors run here.
+ *
+ * Usage:
+ *   RingDetect NAME [--seconds S] [--report S]
+ */
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    void printUsage()
+    {
+        fmt::println("Usage:");
+        fmt::println("  RingDetect NAME [--seconds S] [--report S]");
+        fmt::println("--seconds 0 runs until the process is stopped.");
+    }
+
+    /**
+     * @brief Counts for one report interval
+     *
+     */
+    struct Interval {
+        uint64_t frames = 0;
+        uint64_t torn = 0;              ///< Frames overwritten while they were being processed
+        uint64_t mismatches = 0;
+        uint64_t detectNs = 0;
+        std::vector<int64_t> handoffNs;
+
+        void print(const double seconds, const uint64_t dropped)
+        {
+            std::sort(handoffNs.begin(), handoffNs.end());
+            auto percentileUs = [&](const double p) {
+                if (handoffNs.empty()) return 0.0;
+                return handoffNs[std::min(handoffNs.size() - 1, static_cast<size_t>(p * handoffNs.size()))] / 1000.0;
+            };
+
+            fmt::println("{:.0f} frames/s, {} dropped in total, {} torn while detecting, {} mismatches | hand-off p50 {:.1f} us, p99 {:.1f} us | detect {:.1f} us/frame",
+                         frames / seconds, dropped, torn, mismatches, percentileUs(0.5), percentileUs(0.99),
+                         frames > 0 ? detectNs / 1000.0 / frames : 0.0);
+        }
+    };
+
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace MicroCV2;
+
+    if (argc < 2 || (argc - 2) % 2 != 0) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> options;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        options[argv[i]] = argv[i + 1];
+    }
+    double runSeconds = 0;
+    double reportSeconds = 1;
+    if (!Cli::parseOption(options, "--seconds", runSeconds) || !Cli::parseOption(options, "--report", reportSeconds)) {
+        printUsage();
+        return 2;
+    }
+
+    FrameRing::Consumer consumer;
+    if (!consumer.open(argv[1])) return 1;
+    fmt::println("Reading frame ring {}", argv[1]);
+
+    std::vector<uint8_t> mask(FrameRing::PIXELS);
+    Core::Workspace workspace;
+
+    Interval interval;
+    const auto start = clock_type::now();
+    auto reportStart = start;
+
+    while (runSeconds <= 0 || std::chrono::duration<double>(clock_type::now() - start).count() < runSeconds) {
+        if (consumer.wait(std::chrono::milliseconds(100))) {
+            while (auto view = consumer.next()) {
+                const int64_t handoff = FrameRing::nowNs() - view->slot->publishNs;
+
+                auto detectStart = clock_type::now();
+                const Core::BoxResult red = Core::processRed(view->pixels(), IMG_COLS, IMG_ROWS, mask);
+                const Core::WhiteResult white = Core::processWhite(view->pixels(), IMG_COLS, IMG_ROWS, mask, workspace, Core::DEFAULT_CONFIG);
+                interval.detectNs += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - detectStart).count();
+
+                const bool hasDetection = view->slot->hasDetection != 0;
+                const FrameRing::Detection detection = view->slot->detection;
+                if (!consumer.valid(*view)) {
+                    interval.torn++;
+                    continue;
+                }
+
+                interval.frames++;
+                interval.handoffNs.push_back(handoff);
+                if (hasDetection) {
+                    const int8_t dist = white.detected ? white.line.dist : 0;
+                    interval.mismatches += (detection.stop != 0) != red.detected || (detection.white != 0) != white.detected
+                                           || detection.dist != dist || detection.redPercent != red.percent;
+                }
+            }
+        }
+
+        const double elapsed = std::chrono::duration<double>(clock_type::now() - reportStart).count();
+        if (elapsed >= reportSeconds) {
+            interval.print(elapsed, consumer.dropped());
+            interval = Interval();
+            reportStart = clock_type::now();
+        }
+    }
+
+    return 0;
+}